@@ -271,12 +271,8 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, Accumulat
 		}
 
 		//grab mints from this block
-		CBlock block;
-		if (!ReadBlockFromDisk(block, pindex))
-			return error("%s: failed to read block from disk", __func__);
-
 		std::list<PublicCoin> listPubcoins;
-		if (!BlockToPubcoinList(block, listPubcoins, fFilterInvalid))
+		if (!GetBlockPubcoinList(pindex, listPubcoins, fFilterInvalid))
 			return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
 
 		nTotalMintsFound += listPubcoins.size();
@@ -360,20 +356,16 @@ int ComputeAccumulatedCoins(int nHeightEnd, libzerocoin::CoinDenomination denom)
 	return n;
 }
 
-int AddBlockMintsToAccumulator(const libzerocoin::PublicCoin& coin, const int nHeightMintAdded, const CBlockIndex* pindex,
-	libzerocoin::Accumulator* accumulator, bool isWitness)
+//Add the mints of this block to the accumulator, nMintsAdded is increased by the number added
+bool AddBlockMintsToAccumulator(const libzerocoin::PublicCoin& coin, const int nHeightMintAdded, const CBlockIndex* pindex,
+	libzerocoin::Accumulator* accumulator, bool isWitness, int& nMintsAdded)
 {
 	// if this block contains mints of the denomination that is being spent, then add them to the witness
-	int nMintsAdded = 0;
 	if (pindex->MintedDenomination(coin.getDenomination())) {
 		//grab mints from this block
-		CBlock block;
-		if (!ReadBlockFromDisk(block, pindex))
-			return error("%s: failed to read block from disk while adding pubcoins to witness", __func__);
-
 		list<PublicCoin> listPubcoins;
-		if (!BlockToPubcoinList(block, listPubcoins, true))
-			return error("%s: failed to get zerocoin mintlist from block %n\n", __func__, pindex->nHeight);
+		if (!GetBlockPubcoinList(pindex, listPubcoins, true))
+			return error("%s: failed to get zerocoin mintlist from block %d\n", __func__, pindex->nHeight);
 
 		//add the mints to the witness
 		for (const PublicCoin& pubcoin : listPubcoins) {
@@ -388,7 +380,7 @@ int AddBlockMintsToAccumulator(const libzerocoin::PublicCoin& coin, const int nH
 		}
 	}
 
-	return nMintsAdded;
+	return true;
 }
 
 bool GetAccumulatorValue(int& nHeight, const libzerocoin::CoinDenomination denom, CBigNum& bnAccValue)
@@ -417,22 +409,55 @@ bool GetAccumulatorValue(int& nHeight, const libzerocoin::CoinDenomination denom
 	return true;
 }
 
-bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator, AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, string& strError, CBlockIndex* pindexCheckpoint)
+namespace {
+
+//! Witness states by pubcoin hash, then by the height they are accumulated to
+CCriticalSection cs_witnesscache;
+std::map<uint256, std::map<int, CAccumulatorWitnessState> > mapWitnessCache;
+
+boost::filesystem::path GetWitnessCachePath()
 {
-	LogPrint("zero", "%s: generating\n", __func__);
-	int nLockAttempts = 0;
-	while (nLockAttempts < 100) {
-		TRY_LOCK(cs_main, lockMain);
-		if (!lockMain) {
-			MilliSleep(50);
-			nLockAttempts++;
+	return GetDataDir() / "witnesscache.dat";
+}
+
+} // anon namespace
+
+//Get the latest cached state for this mint accumulated to at most nHeightMax, dropping states no longer in the active chain
+static bool GetCachedWitness(const uint256& hashPubcoin, int nHeightStart, int nHeightMax, CAccumulatorWitnessState& state)
+{
+	LOCK(cs_witnesscache);
+	std::map<uint256, std::map<int, CAccumulatorWitnessState> >::iterator mi = mapWitnessCache.find(hashPubcoin);
+	if (mi == mapWitnessCache.end())
+		return false;
+
+	std::map<int, CAccumulatorWitnessState>& mapStates = mi->second;
+	std::map<int, CAccumulatorWitnessState>::iterator it = mapStates.upper_bound(nHeightMax);
+	while (it != mapStates.begin()) {
+		--it;
+		const CAccumulatorWitnessState& stateCached = it->second;
+		CBlockIndex* pindex = chainActive[stateCached.nHeight - 1];
+		if (!pindex || pindex->GetBlockHash() != stateCached.hashBlock || stateCached.nHeightStart != nHeightStart) {
+			it = mapStates.erase(it);
 			continue;
 		}
-		break;
+		state = stateCached;
+		return true;
 	}
-	if (nLockAttempts == 100)
-		return error("%s: could not get lock on cs_main", __func__);
-	LogPrint("zero", "%s: after lock\n", __func__);
+	return false;
+}
+
+static void CacheWitness(const uint256& hashPubcoin, const CAccumulatorWitnessState& state)
+{
+	LOCK(cs_witnesscache);
+	std::map<int, CAccumulatorWitnessState>& mapStates = mapWitnessCache[hashPubcoin];
+	mapStates[state.nHeight] = state;
+	while (mapStates.size() > MAX_WITNESS_CACHE_STATES)
+		mapStates.erase(mapStates.begin());
+}
+
+//Find where the witness for this mint starts and the accumulator value it starts from
+static bool InitializeWitnessState(const PublicCoin& coin, CAccumulatorWitnessState& state)
+{
 	uint256 txid;
 	if (!zerocoinDB->ReadCoinMint(coin.getValue(), txid))
 		return error("%s failed to read mint from db", __func__);
@@ -446,71 +471,133 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
 	if (!IsTransactionInChain(txid, nHeightTest))
 		return error("%s: mint tx %s is not in chain", __func__, txid.GetHex());
 
-	int nHeightMintAdded = mapBlockIndex[hashBlock]->nHeight;
+	state.bnPubcoin = coin.getValue();
+	state.denom = coin.getDenomination();
+	state.nHeightMintAdded = mapBlockIndex[hashBlock]->nHeight;
 
 	//get the checkpoint added at the next multiple of 10
-	int nHeightCheckpoint = nHeightMintAdded + (10 - (nHeightMintAdded % 10));
+	int nHeightCheckpoint = state.nHeightMintAdded + (10 - (state.nHeightMintAdded % 10));
 
 	//the height to start accumulating coins to add to witness
-	int nAccStartHeight = nHeightMintAdded - (nHeightMintAdded % 10);
+	state.nAccStartHeight = state.nHeightMintAdded - (state.nHeightMintAdded % 10);
 
 	//Get the accumulator that is right before the cluster of blocks containing our mint was added to the accumulator
 	CBigNum bnAccValue = 0;
-	if (GetAccumulatorValue(nHeightCheckpoint, coin.getDenomination(), bnAccValue)) {
-		accumulator.setValue(bnAccValue);
-		witness.resetValue(accumulator, coin);
-	}
+	if (GetAccumulatorValue(nHeightCheckpoint, coin.getDenomination(), bnAccValue))
+		state.bnValue = bnAccValue;
+	else
+		state.bnValue = Accumulator(Params().Zerocoin_Params(false), coin.getDenomination()).getValue();
 
 	//add the pubcoins from the blockchain up to the next checksum starting from the block
 	if (nHeightCheckpoint < 10)
 		nHeightCheckpoint = 10;
 
-	CBlockIndex* pindex = chainActive[nHeightCheckpoint - 10];
-	int nChainHeight = chainActive.Height();
-	int nHeightStop = nChainHeight % 10;
-	nHeightStop = nChainHeight - nHeightStop - 20; // at least two checkpoints deep
+	state.nHeightStart = nHeightCheckpoint - 10;
+	state.nHeight = state.nHeightStart;
+	state.nMintsAdded = 0;
+	return true;
+}
+
+//Add the mints of vBlocks to a witness state that stops right before the first of them, ending at block hashBlock
+static bool AccumulateWitness(const PublicCoin& coin, const std::vector<const CBlockIndex*>& vBlocks, const uint256& hashBlock, CAccumulatorWitnessState& state)
+{
+	Accumulator witnessAccumulator(Params().Zerocoin_Params(false), coin.getDenomination(), state.bnValue);
+	for (const CBlockIndex* pindex : vBlocks) {
+		//a block that cannot be read leaves the witness incomplete, so nothing is cached
+		if (!AddBlockMintsToAccumulator(coin, state.nHeightMintAdded, pindex, &witnessAccumulator, true, state.nMintsAdded))
+			return false;
+		state.nHeight = pindex->nHeight + 1;
+	}
 
-												   //If looking for a specific checkpoint
-	if (pindexCheckpoint)
-		nHeightStop = pindexCheckpoint->nHeight - 10;
+	state.hashBlock = hashBlock;
+	state.bnValue = witnessAccumulator.getValue();
+	CacheWitness(GetPubCoinHash(coin.getValue()), state);
+	return true;
+}
 
-	//Iterate through the chain and calculate the witness
-	int nCheckpointsAdded = 0;
-	nMintsAdded = 0;
-	RandomizeSecurityLevel(nSecurityLevel); //make security level not always the same and predictable
-	libzerocoin::Accumulator witnessAccumulator = accumulator;
+bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator, AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, string& strError, CBlockIndex* pindexCheckpoint)
+{
+	LogPrint("zero", "%s: generating\n", __func__);
 
-	bool fDoubleCounted = false;
-	while (pindex) {
-		if (pindex->nHeight != nAccStartHeight && pindex->pprev->nAccumulatorCheckpoint != pindex->nAccumulatorCheckpoint)
-			++nCheckpointsAdded;
+	//Only the walk over the block index needs cs_main, the blocks it selects are read and accumulated without it
+	CAccumulatorWitnessState stateInit;
+	CAccumulatorWitnessState state;
+	std::vector<const CBlockIndex*> vBlocks;
+	uint256 hashBlockLast;
+	uint256 nCheckpointSpend;
+	bool fCheckpointSpend = false;
+	int nAccumulatedCoins;
+	{
+		LOCK(cs_main);
+		if (!InitializeWitnessState(coin, stateInit))
+			return false;
+
+		CBlockIndex* pindex = chainActive[stateInit.nHeightStart];
+		int nChainHeight = chainActive.Height();
+		int nHeightStop = nChainHeight % 10;
+		nHeightStop = nChainHeight - nHeightStop - 20; // at least two checkpoints deep
 
-		//If the security level is satisfied, or the stop height is reached, then initialize the accumulator from here
-		bool fSecurityLevelSatisfied = (nSecurityLevel != 100 && nCheckpointsAdded >= nSecurityLevel);
-		if (pindex->nHeight >= nHeightStop || fSecurityLevelSatisfied) {
+		//If looking for a specific checkpoint
+		if (pindexCheckpoint)
+			nHeightStop = pindexCheckpoint->nHeight - 10;
+
+		//Find the block to stop at, only the block index is needed for this
+		int nCheckpointsAdded = 0;
+		RandomizeSecurityLevel(nSecurityLevel); //make security level not always the same and predictable
+		while (pindex) {
+			if (pindex->nHeight != stateInit.nAccStartHeight && pindex->pprev->nAccumulatorCheckpoint != pindex->nAccumulatorCheckpoint)
+				++nCheckpointsAdded;
+
+			//If the security level is satisfied, or the stop height is reached, then initialize the accumulator from here
 			//If this height is within the invalid range (when fraudulent coins were being minted), then continue past this range
-			if (InvalidCheckpointRange(pindex->nHeight))
-				continue;
+			bool fSecurityLevelSatisfied = (nSecurityLevel != 100 && nCheckpointsAdded >= nSecurityLevel);
+			if ((pindex->nHeight >= nHeightStop || fSecurityLevelSatisfied) && !InvalidCheckpointRange(pindex->nHeight))
+				break;
 
-			bnAccValue = 0;
-			uint256 nCheckpointSpend = chainActive[pindex->nHeight + 10]->nAccumulatorCheckpoint;
-			if (!GetAccumulatorValueFromDB(nCheckpointSpend, coin.getDenomination(), bnAccValue) || bnAccValue == 0)
-				return error("%s : failed to find checksum in database for accumulator", __func__);
+			pindex = chainActive.Next(pindex);
+		}
 
-			accumulator.setValue(bnAccValue);
-			break;
+		//The witness covers the blocks below nHeight, continuing from the cache where possible
+		int nHeight = pindex ? pindex->nHeight : nChainHeight + 1;
+		if (!GetCachedWitness(GetPubCoinHash(coin.getValue()), stateInit.nHeightStart, nHeight, state))
+			state = stateInit;
+		for (CBlockIndex* pindexWalk = chainActive[state.nHeight]; pindexWalk && pindexWalk->nHeight < nHeight; pindexWalk = chainActive.Next(pindexWalk))
+			vBlocks.push_back(pindexWalk);
+
+		CBlockIndex* pindexLast = chainActive[nHeight - 1];
+		if (!pindexLast)
+			return error("%s: height %d is beyond the active chain", __func__, nHeight);
+		hashBlockLast = pindexLast->GetBlockHash();
+
+		if (pindex) {
+			CBlockIndex* pindexSpend = chainActive[pindex->nHeight + 10];
+			if (!pindexSpend)
+				return error("%s: checkpoint at height %d is beyond the active chain", __func__, pindex->nHeight + 10);
+			nCheckpointSpend = pindexSpend->nAccumulatorCheckpoint;
+			fCheckpointSpend = true;
 		}
 
-		nMintsAdded += AddBlockMintsToAccumulator(coin, nHeightMintAdded, pindex, &witnessAccumulator, true);
+		// how many mints of this denomination existed in the accumulator we initialized
+		nAccumulatedCoins = ComputeAccumulatedCoins(stateInit.nAccStartHeight, coin.getDenomination());
+	}
+	LogPrint("zero", "%s: %d blocks to accumulate\n", __func__, vBlocks.size());
 
-		/*// 10 blocks were accumulated twice when zleno v2 was activated
-		if (pindex->nHeight == 1050010 && !fDoubleCounted) {
-		pindex = chainActive[1050000];
-		fDoubleCounted = true;
-		continue;
-		}*/
+	accumulator.setValue(stateInit.bnValue);
+	witness.resetValue(accumulator, coin);
 
-		pindex = chainActive.Next(pindex);
+	//Iterate through the chain and calculate the witness
+	if (!AccumulateWitness(coin, vBlocks, hashBlockLast, state))
+		return error("%s: failed to accumulate witness", __func__);
+	nMintsAdded = state.nMintsAdded;
+	libzerocoin::Accumulator witnessAccumulator = accumulator;
+	witnessAccumulator.setValue(state.bnValue);
+
+	if (fCheckpointSpend) {
+		CBigNum bnAccValue = 0;
+		if (!GetAccumulatorValueFromDB(nCheckpointSpend, coin.getDenomination(), bnAccValue) || bnAccValue == 0)
+			return error("%s : failed to find checksum in database for accumulator", __func__);
+
+		accumulator.setValue(bnAccValue);
 	}
 
 	witness.resetValue(witnessAccumulator, coin);
@@ -523,15 +610,163 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
 		return error("%s : %s", __func__, strError);
 	}
 
-	// calculate how many mints of this denomination existed in the accumulator we initialized
-	nMintsAdded += ComputeAccumulatedCoins(nAccStartHeight, coin.getDenomination());
+	nMintsAdded += nAccumulatedCoins;
 	LogPrint("zero", "%s : %d mints added to witness\n", __func__, nMintsAdded);
 
 	return true;
 }
 
+void AdvanceAccumulatorWitnesses(const std::set<uint256>& setHashPubcoin, int nHeight)
+{
+	std::vector<std::pair<uint256, CAccumulatorWitnessState> > vLatest;
+	{
+		LOCK(cs_witnesscache);
+		std::map<uint256, std::map<int, CAccumulatorWitnessState> >::iterator it = mapWitnessCache.begin();
+		while (it != mapWitnessCache.end()) {
+			if (!setHashPubcoin.count(it->first) || it->second.empty()) {
+				mapWitnessCache.erase(it++);
+				continue;
+			}
+			vLatest.push_back(make_pair(it->first, it->second.rbegin()->second));
+			++it;
+		}
+	}
+
+	for (std::pair<uint256, CAccumulatorWitnessState>& entry : vLatest) {
+		if (ShutdownRequested())
+			return;
+
+		//Collect the pubcoins to add under cs_main, the accumulation itself does not need it
+		CAccumulatorWitnessState& state = entry.second;
+		std::list<CBigNum> listValues;
+		bool fComplete = true;
+		{
+			LOCK(cs_main);
+			if (nHeight > chainActive.Height() + 1 || !GetCachedWitness(entry.first, state.nHeightStart, nHeight, state) || state.nHeight >= nHeight)
+				continue;
+
+			for (CBlockIndex* pindex = chainActive[state.nHeight]; pindex && pindex->nHeight < nHeight; pindex = chainActive.Next(pindex)) {
+				if (!pindex->MintedDenomination(state.denom))
+					continue;
+				std::list<PublicCoin> listPubcoins;
+				if (!GetBlockPubcoinList(pindex, listPubcoins, true)) {
+					fComplete = false;
+					break;
+				}
+				for (const PublicCoin& pubcoin : listPubcoins) {
+					if (pubcoin.getDenomination() != state.denom)
+						continue;
+					if (pindex->nHeight == state.nHeightMintAdded && pubcoin.getValue() == state.bnPubcoin)
+						continue;
+					listValues.push_back(pubcoin.getValue());
+				}
+			}
+			state.hashBlock = chainActive[nHeight - 1]->GetBlockHash();
+		}
+		if (!fComplete)
+			continue;
+
+		Accumulator witnessAccumulator(Params().Zerocoin_Params(false), state.denom, state.bnValue);
+		for (const CBigNum& bnValue : listValues)
+			witnessAccumulator.increment(bnValue);
+		state.nHeight = nHeight;
+		state.bnValue = witnessAccumulator.getValue();
+		state.nMintsAdded += listValues.size();
+		CacheWitness(entry.first, state);
+	}
+}
+
+//Checks that a state read from the witness cache file is consistent with the mint it is stored for
+static bool IsValidWitnessState(const uint256& hashPubcoin, const CAccumulatorWitnessState& state)
+{
+	return GetPubCoinHash(state.bnPubcoin) == hashPubcoin &&
+		std::find(zerocoinDenomList.begin(), zerocoinDenomList.end(), state.denom) != zerocoinDenomList.end() &&
+		state.nHeightStart <= state.nHeight &&
+		state.nMintsAdded >= 0 &&
+		state.bnValue > 0;
+}
+
+bool LoadAccumulatorWitnessCache()
+{
+	CAutoFile filein(fopen(GetWitnessCachePath().string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+	if (filein.IsNull())
+		return false;
+
+	std::vector<std::pair<uint256, CAccumulatorWitnessState> > vStates;
+	uint256 hashChecksum;
+	try {
+		filein >> vStates;
+		filein >> hashChecksum;
+	} catch (const std::exception& e) {
+		return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+	}
+
+	CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+	hasher << vStates;
+	if (hashChecksum != hasher.GetHash())
+		return error("%s : Checksum mismatch, witness cache ignored", __func__);
+
+	//States that are no longer in the active chain are dropped when they are looked up
+	unsigned int nDropped = 0;
+	for (const std::pair<uint256, CAccumulatorWitnessState>& entry : vStates) {
+		if (!IsValidWitnessState(entry.first, entry.second)) {
+			nDropped++;
+			continue;
+		}
+		CacheWitness(entry.first, entry.second);
+	}
+	LogPrint("zero", "%s: loaded %u witness states, dropped %u invalid\n", __func__, vStates.size() - nDropped, nDropped);
+	return true;
+}
+
+bool FlushAccumulatorWitnessCache()
+{
+	std::vector<std::pair<uint256, CAccumulatorWitnessState> > vStates;
+	{
+		LOCK(cs_witnesscache);
+		for (const std::pair<const uint256, std::map<int, CAccumulatorWitnessState> >& entry : mapWitnessCache) {
+			for (const std::pair<const int, CAccumulatorWitnessState>& state : entry.second)
+				vStates.push_back(make_pair(entry.first, state.second));
+		}
+	}
+
+	//Write to a temporary file first, so an interrupted flush leaves the previous cache in place
+	boost::filesystem::path pathCache = GetWitnessCachePath();
+	boost::filesystem::path pathTmp = pathCache;
+	pathTmp += ".new";
+	CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+	if (fileout.IsNull())
+		return error("%s : failed to open %s", __func__, pathTmp.string());
+	try {
+		CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+		hasher << vStates;
+		fileout << vStates;
+		fileout << hasher.GetHash();
+	} catch (const std::exception& e) {
+		return error("%s : I/O error - %s", __func__, e.what());
+	}
+	FileCommit(fileout.Get());
+	fileout.fclose();
+
+	if (!RenameOver(pathTmp, pathCache))
+		return error("%s : failed to rename %s", __func__, pathTmp.string());
+	return true;
+}
+
+/** Maturity heights at the tip they were computed for, they only change when the tip does */
+CCriticalSection cs_mintmaturity;
+uint256 hashMintMaturityTip = 0;
+map<CoinDenomination, int> mapMintMaturityHeight;
+
 map<CoinDenomination, int> GetMintMaturityHeight()
 {
+	uint256 hashTip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256(0);
+	{
+		LOCK(cs_mintmaturity);
+		if (hashTip != 0 && hashTip == hashMintMaturityTip)
+			return mapMintMaturityHeight;
+	}
+
 	map<CoinDenomination, pair<int, int > > mapDenomMaturity;
 	for (auto denom : libzerocoin::zerocoinDenomList)
 		mapDenomMaturity.insert(make_pair(denom, make_pair(0, 0)));
@@ -569,5 +804,8 @@ map<CoinDenomination, int> GetMintMaturityHeight()
 	for (auto denom : libzerocoin::zerocoinDenomList)
 		mapRet.insert(make_pair(denom, mapDenomMaturity.at(denom).second));
 
+	LOCK(cs_mintmaturity);
+	hashMintMaturityTip = hashTip;
+	mapMintMaturityHeight = mapRet;
 	return mapRet;
 }
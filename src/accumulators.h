@@ -14,10 +14,58 @@
 #include "chain.h"
 #include "uint256.h"
 
+#include <set>
+
 class CBlockIndex;
 
+/** Number of witness states kept per mint in the witness cache */
+static const unsigned int MAX_WITNESS_CACHE_STATES = 30;
+
+/**
+ * Witness of a mint with the mints of the blocks from nHeightStart up to,
+ * but not including, nHeight added. A later witness for the same mint can
+ * continue from here instead of accumulating from the mint again.
+ */
+class CAccumulatorWitnessState
+{
+public:
+    CBigNum bnPubcoin;
+    libzerocoin::CoinDenomination denom;
+    int nHeightMintAdded;
+    //! Start of the 10 block group the mint was accumulated in
+    int nAccStartHeight;
+    int nHeightStart;
+    int nHeight;
+    //! Block at nHeight - 1, the state is only used while it is in the active chain
+    uint256 hashBlock;
+    CBigNum bnValue;
+    int nMintsAdded;
+
+    CAccumulatorWitnessState() : denom(libzerocoin::ZQ_ERROR), nHeightMintAdded(0), nAccStartHeight(0), nHeightStart(0), nHeight(0), hashBlock(0), nMintsAdded(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(bnPubcoin);
+        READWRITE(denom);
+        READWRITE(nHeightMintAdded);
+        READWRITE(nAccStartHeight);
+        READWRITE(nHeightStart);
+        READWRITE(nHeight);
+        READWRITE(hashBlock);
+        READWRITE(bnValue);
+        READWRITE(nMintsAdded);
+    }
+};
+
 std::map<libzerocoin::CoinDenomination, int> GetMintMaturityHeight();
 bool GenerateAccumulatorWitness(const libzerocoin::PublicCoin &coin, libzerocoin::Accumulator& accumulator, libzerocoin::AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, std::string& strError, CBlockIndex* pindexCheckpoint = nullptr);
+/** Advance the cached witnesses of the given mints to nHeight and drop those of any other mint */
+void AdvanceAccumulatorWitnesses(const std::set<uint256>& setHashPubcoin, int nHeight);
+bool LoadAccumulatorWitnessCache();
+bool FlushAccumulatorWitnessCache();
 bool GetAccumulatorValueFromDB(uint256 nCheckpoint, libzerocoin::CoinDenomination denom, CBigNum& bnAccValue);
 bool GetAccumulatorValueFromChecksum(uint32_t nChecksum, bool fMemoryOnly, CBigNum& bnAccValue);
 void AddAccumulatorChecksum(const uint32_t nChecksum, const CBigNum &bnValue, bool fMemoryOnly);
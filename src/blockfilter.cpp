@@ -0,0 +1,300 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) 2021-2022 The LenoCore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "hash.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "primitives/zerocoin.h"
+#include "script/script.h"
+#include "streams.h"
+#include "zlenochain.h"
+
+#include <algorithm>
+
+namespace {
+
+/** Writes values of up to 64 bits to the end of a byte vector, most significant bit first */
+class CBitWriter
+{
+private:
+    std::vector<unsigned char>& vch;
+    uint8_t nBuffer;
+    int nOffset;
+
+public:
+    explicit CBitWriter(std::vector<unsigned char>& vchIn) : vch(vchIn), nBuffer(0), nOffset(0) {}
+
+    void Write(uint64_t nData, int nBits)
+    {
+        while (nBits > 0) {
+            int nTake = std::min(8 - nOffset, nBits);
+            nBuffer |= (nData << (64 - nBits)) >> (64 - 8 + nOffset);
+            nOffset += nTake;
+            nBits -= nTake;
+            if (nOffset == 8)
+                Flush();
+        }
+    }
+
+    void Flush()
+    {
+        if (nOffset == 0)
+            return;
+        vch.push_back(nBuffer);
+        nBuffer = 0;
+        nOffset = 0;
+    }
+};
+
+/** Reads values written by CBitWriter */
+class CBitReader
+{
+private:
+    const unsigned char* pCur;
+    const unsigned char* pEnd;
+    uint8_t nBuffer;
+    int nOffset;
+
+public:
+    CBitReader(const unsigned char* pBegin, const unsigned char* pEndIn) : pCur(pBegin), pEnd(pEndIn), nBuffer(0), nOffset(8) {}
+
+    uint64_t Read(int nBits)
+    {
+        uint64_t nData = 0;
+        while (nBits > 0) {
+            if (nOffset == 8) {
+                if (pCur == pEnd)
+                    throw std::ios_base::failure("CBitReader::Read : end of data");
+                nBuffer = *pCur++;
+                nOffset = 0;
+            }
+            int nTake = std::min(8 - nOffset, nBits);
+            nData <<= nTake;
+            nData |= static_cast<uint8_t>(nBuffer << nOffset) >> (8 - nTake);
+            nOffset += nTake;
+            nBits -= nTake;
+        }
+        return nData;
+    }
+
+    bool AtEnd() const { return pCur == pEnd; }
+};
+
+void GolombRiceEncode(CBitWriter& writer, uint8_t nP, uint64_t x)
+{
+    // Quotient in unary, as q ones followed by a zero
+    uint64_t q = x >> nP;
+    while (q > 0) {
+        int nBits = q <= 64 ? static_cast<int>(q) : 64;
+        writer.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    writer.Write(0, 1);
+
+    // Remainder in binary, as its P low bits
+    writer.Write(x, nP);
+}
+
+uint64_t GolombRiceDecode(CBitReader& reader, uint8_t nP)
+{
+    uint64_t q = 0;
+    while (reader.Read(1) == 1)
+        ++q;
+    uint64_t r = reader.Read(nP);
+    return (q << nP) + r;
+}
+
+/** (x * n) >> 64, mapping a uniform 64-bit x into [0, n) without a division */
+uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return (static_cast<unsigned __int128>(x) * static_cast<unsigned __int128>(n)) >> 64;
+#else
+    uint64_t x_hi = x >> 32, x_lo = x & 0xFFFFFFFF;
+    uint64_t n_hi = n >> 32, n_lo = n & 0xFFFFFFFF;
+
+    uint64_t ac = x_hi * n_hi;
+    uint64_t ad = x_hi * n_lo;
+    uint64_t bc = x_lo * n_hi;
+    uint64_t bd = x_lo * n_lo;
+
+    uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    return ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+#endif
+}
+
+GCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockundo)
+{
+    GCSFilter::ElementSet elements;
+
+    for (const CTransaction& tx : block.vtx) {
+        for (const CTxOut& txout : tx.vout) {
+            const CScript& script = txout.scriptPubKey;
+            if (script.empty() || script[0] == OP_RETURN)
+                continue;
+            elements.insert(GCSFilter::Element(script.begin(), script.end()));
+        }
+
+        if (tx.IsZerocoinSpend()) {
+            for (const CTxIn& txin : tx.vin) {
+                if (!txin.scriptSig.IsZerocoinSpend())
+                    continue;
+                uint256 hashSerial = GetSerialHash(TxInToZerocoinSpend(txin).getCoinSerialNumber());
+                elements.insert(GCSFilter::Element(hashSerial.begin(), hashSerial.end()));
+            }
+        }
+    }
+
+    for (const CTxUndo& txundo : blockundo.vtxundo) {
+        for (const CTxInUndo& txinundo : txundo.vprevout) {
+            const CScript& script = txinundo.txout.scriptPubKey;
+            if (script.empty())
+                continue;
+            elements.insert(GCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+
+    return elements;
+}
+
+} // anonymous namespace
+
+GCSFilter::GCSFilter(uint64_t nSipHashK0In, uint64_t nSipHashK1In, uint8_t nPIn, uint32_t nMIn) : nSipHashK0(nSipHashK0In), nSipHashK1(nSipHashK1In), nP(nPIn), nM(nMIn), nN(0), nF(0)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, nN);
+    vchEncoded.assign(ss.begin(), ss.end());
+}
+
+GCSFilter::GCSFilter(uint64_t nSipHashK0In, uint64_t nSipHashK1In, uint8_t nPIn, uint32_t nMIn, const std::vector<unsigned char>& vchEncodedIn) : nSipHashK0(nSipHashK0In), nSipHashK1(nSipHashK1In), nP(nPIn), nM(nMIn), vchEncoded(vchEncodedIn)
+{
+    CDataStream ss(vchEncoded, SER_NETWORK, PROTOCOL_VERSION);
+    uint64_t nElements = ReadCompactSize(ss);
+    if (nElements > std::numeric_limits<uint32_t>::max())
+        throw std::ios_base::failure("GCSFilter : N must be < 2^32");
+    nN = static_cast<uint32_t>(nElements);
+    nF = static_cast<uint64_t>(nN) * nM;
+
+    // Decode all the deltas to check the encoding
+    const unsigned char* pBegin = vchEncoded.data() + (vchEncoded.size() - ss.size());
+    CBitReader reader(pBegin, vchEncoded.data() + vchEncoded.size());
+    for (uint32_t i = 0; i < nN; ++i)
+        GolombRiceDecode(reader, nP);
+    if (!reader.AtEnd())
+        throw std::ios_base::failure("GCSFilter : encoded filter has trailing data");
+}
+
+GCSFilter::GCSFilter(uint64_t nSipHashK0In, uint64_t nSipHashK1In, uint8_t nPIn, uint32_t nMIn, const ElementSet& elements) : nSipHashK0(nSipHashK0In), nSipHashK1(nSipHashK1In), nP(nPIn), nM(nMIn)
+{
+    if (elements.size() > std::numeric_limits<uint32_t>::max())
+        throw std::invalid_argument("GCSFilter : N must be < 2^32");
+    nN = static_cast<uint32_t>(elements.size());
+    nF = static_cast<uint64_t>(nN) * nM;
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, nN);
+    vchEncoded.assign(ss.begin(), ss.end());
+    if (elements.empty())
+        return;
+
+    CBitWriter writer(vchEncoded);
+    uint64_t nLast = 0;
+    for (uint64_t nValue : BuildHashedSet(elements)) {
+        GolombRiceEncode(writer, nP, nValue - nLast);
+        nLast = nValue;
+    }
+    writer.Flush();
+}
+
+uint64_t GCSFilter::HashToRange(const Element& element) const
+{
+    uint64_t nHash = CSipHasher(nSipHashK0, nSipHashK1).Write(element.data(), element.size()).Finalize();
+    return MapIntoRange(nHash, nF);
+}
+
+std::vector<uint64_t> GCSFilter::BuildHashedSet(const ElementSet& elements) const
+{
+    std::vector<uint64_t> vHashes;
+    vHashes.reserve(elements.size());
+    for (const Element& element : elements)
+        vHashes.push_back(HashToRange(element));
+    std::sort(vHashes.begin(), vHashes.end());
+    return vHashes;
+}
+
+bool GCSFilter::MatchInternal(const uint64_t* pElementHashes, size_t nSize) const
+{
+    CDataStream ss(vchEncoded, SER_NETWORK, PROTOCOL_VERSION);
+    ReadCompactSize(ss);
+    const unsigned char* pBegin = vchEncoded.data() + (vchEncoded.size() - ss.size());
+    CBitReader reader(pBegin, vchEncoded.data() + vchEncoded.size());
+
+    // Walk the filter and the sorted query hashes side by side
+    uint64_t nValue = 0;
+    size_t nIndex = 0;
+    for (uint32_t i = 0; i < nN; ++i) {
+        nValue += GolombRiceDecode(reader, nP);
+        while (true) {
+            if (nIndex == nSize)
+                return false;
+            if (pElementHashes[nIndex] == nValue)
+                return true;
+            if (pElementHashes[nIndex] > nValue)
+                break;
+            nIndex++;
+        }
+    }
+    return false;
+}
+
+bool GCSFilter::Match(const Element& element) const
+{
+    if (nN == 0)
+        return false;
+    uint64_t nQuery = HashToRange(element);
+    return MatchInternal(&nQuery, 1);
+}
+
+bool GCSFilter::MatchAny(const ElementSet& elements) const
+{
+    if (nN == 0 || elements.empty())
+        return false;
+    const std::vector<uint64_t> vQueries = BuildHashedSet(elements);
+    return MatchInternal(vQueries.data(), vQueries.size());
+}
+
+CBlockFilter::CBlockFilter() : hashBlock(0)
+{
+}
+
+CBlockFilter::CBlockFilter(const uint256& hashBlockIn, const std::vector<unsigned char>& vchEncoded) : hashBlock(hashBlockIn)
+{
+    InitFilter(vchEncoded);
+}
+
+CBlockFilter::CBlockFilter(const CBlock& block, const CBlockUndo& blockundo) : hashBlock(block.GetHash())
+{
+    filter = GCSFilter(ReadLE64(hashBlock.begin()), ReadLE64(hashBlock.begin() + 8), BASIC_FILTER_P, BASIC_FILTER_M, BasicFilterElements(block, blockundo));
+}
+
+void CBlockFilter::InitFilter(const std::vector<unsigned char>& vchEncoded)
+{
+    filter = GCSFilter(ReadLE64(hashBlock.begin()), ReadLE64(hashBlock.begin() + 8), BASIC_FILTER_P, BASIC_FILTER_M, vchEncoded);
+}
+
+uint256 CBlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& vchEncoded = filter.GetEncoded();
+    return Hash(vchEncoded.begin(), vchEncoded.end());
+}
+
+uint256 CBlockFilter::ComputeHeader(const uint256& hashPrevHeader) const
+{
+    const uint256 hashFilter = GetHash();
+    return Hash(hashFilter.begin(), hashFilter.end(), hashPrevHeader.begin(), hashPrevHeader.end());
+}
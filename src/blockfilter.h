@@ -0,0 +1,124 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) 2021-2022 The LenoCore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+
+/** Filter type of the basic block filter, the only one we build (BIP 158) */
+static const uint8_t BASIC_BLOCK_FILTER_TYPE = 0;
+//! Golomb-Rice coding parameter of the basic block filter
+static const uint8_t BASIC_FILTER_P = 19;
+//! Inverse false positive rate of the basic block filter
+static const uint32_t BASIC_FILTER_M = 784931;
+
+/**
+ * Golomb-coded set of byte vector elements, as described in BIP 158. An
+ * element is hashed with SipHash under the filter key into [0, N * M), and the
+ * sorted hashes are stored as Golomb-Rice coded deltas. Lookups have a false
+ * positive rate of 1 / M.
+ */
+class GCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+private:
+    uint64_t nSipHashK0;
+    uint64_t nSipHashK1;
+    uint8_t nP;
+    uint32_t nM;
+    uint32_t nN;
+    uint64_t nF; //!< Range of element hashes, N * M
+    std::vector<unsigned char> vchEncoded;
+
+    uint64_t HashToRange(const Element& element) const;
+    std::vector<uint64_t> BuildHashedSet(const ElementSet& elements) const;
+    bool MatchInternal(const uint64_t* pElementHashes, size_t nSize) const;
+
+public:
+    /** Construct an empty filter */
+    GCSFilter(uint64_t nSipHashK0In = 0, uint64_t nSipHashK1In = 0, uint8_t nPIn = 0, uint32_t nMIn = 0);
+
+    /** Reconstruct a filter from its encoding, throws std::ios_base::failure if it is malformed */
+    GCSFilter(uint64_t nSipHashK0In, uint64_t nSipHashK1In, uint8_t nPIn, uint32_t nMIn, const std::vector<unsigned char>& vchEncodedIn);
+
+    /** Build a filter of elements */
+    GCSFilter(uint64_t nSipHashK0In, uint64_t nSipHashK1In, uint8_t nPIn, uint32_t nMIn, const ElementSet& elements);
+
+    uint32_t GetN() const { return nN; }
+    const std::vector<unsigned char>& GetEncoded() const { return vchEncoded; }
+
+    /** Whether element may be in the set (false positives at a rate of 1 / M) */
+    bool Match(const Element& element) const;
+
+    /** Whether any of elements may be in the set, faster than calling Match on each of them */
+    bool MatchAny(const ElementSet& elements) const;
+};
+
+/**
+ * Basic compact filter of a block: the scriptPubKeys of its outputs, the
+ * scriptPubKeys spent by its inputs and the serial hash of each zerocoin
+ * spend. Zerocoin mints are covered by their output scripts.
+ */
+class CBlockFilter
+{
+private:
+    uint256 hashBlock;
+    GCSFilter filter;
+
+    void InitFilter(const std::vector<unsigned char>& vchEncoded);
+
+public:
+    CBlockFilter();
+
+    /** Reconstruct a filter of block hashBlockIn from its encoding */
+    CBlockFilter(const uint256& hashBlockIn, const std::vector<unsigned char>& vchEncoded);
+
+    /** Build the filter of block, blockundo being its undo data */
+    CBlockFilter(const CBlock& block, const CBlockUndo& blockundo);
+
+    const uint256& GetBlockHash() const { return hashBlock; }
+    const GCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    /** Double SHA256 of the encoded filter */
+    uint256 GetHash() const;
+
+    /** Filter header committing to this filter and the header of the previous block's filter */
+    uint256 ComputeHeader(const uint256& hashPrevHeader) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        uint8_t nFilterType = BASIC_BLOCK_FILTER_TYPE;
+        READWRITE(nFilterType);
+        READWRITE(hashBlock);
+        if (ser_action.ForRead()) {
+            if (nFilterType != BASIC_BLOCK_FILTER_TYPE)
+                throw std::ios_base::failure("unknown block filter type");
+            std::vector<unsigned char> vchEncoded;
+            READWRITE(vchEncoded);
+            InitFilter(vchEncoded);
+        } else {
+            std::vector<unsigned char> vchEncoded(filter.GetEncoded());
+            READWRITE(vchEncoded);
+        }
+    }
+};
+
+#endif // BITCOIN_BLOCKFILTER_H
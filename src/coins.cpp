@@ -78,13 +78,22 @@ bool CCoinsViewBacked::GetStats(CCoinsStats& stats) const { return base->GetStat
 
 CCoinsKeyHasher::CCoinsKeyHasher() : salt(GetRandHash()) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView* baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), hashBlock(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView* baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), hashBlock(0), cachedParentCoins(0) {}
 
 CCoinsViewCache::~CCoinsViewCache()
 {
     assert(!hasModifier);
 }
 
+void CCoinsViewCache::MarkDirty(CCoinsCacheEntry& entry)
+{
+    if (!(entry.flags & (CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH))) {
+        entry.pcoinsParent = std::make_shared<const CCoins>(entry.coins);
+        cachedParentCoins++;
+    }
+    entry.flags |= CCoinsCacheEntry::DIRTY;
+}
+
 CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256& txid) const
 {
     CCoinsMap::iterator it = cacheCoins.find(txid);
@@ -128,7 +137,7 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256& txid)
         }
     }
     // Assume that whenever ModifyCoins is called, the entry will be modified.
-    ret.first->second.flags |= CCoinsCacheEntry::DIRTY;
+    MarkDirty(ret.first->second);
     return CCoinsModifier(*this, ret.first);
 }
 
@@ -189,8 +198,8 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlockIn
                     cacheCoins.erase(itUs);
                 } else {
                     // A normal modification.
+                    MarkDirty(itUs->second);
                     itUs->second.coins.swap(it->second.coins);
-                    itUs->second.flags |= CCoinsCacheEntry::DIRTY;
                 }
             }
         }
@@ -205,12 +214,14 @@ bool CCoinsViewCache::Flush()
 {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
+    cachedParentCoins = 0;
     return fOk;
 }
 
 unsigned int CCoinsViewCache::GetCacheSize() const
 {
-    return cacheCoins.size();
+    // A saved parent version costs about as much as another entry
+    return cacheCoins.size() + cachedParentCoins;
 }
 
 const CTxOut& CCoinsViewCache::GetOutputFor(const CTxIn& input) const
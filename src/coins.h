@@ -15,6 +15,7 @@
 #include "undo.h"
 
 #include <assert.h>
+#include <memory>
 #include <stdint.h>
 
 #include <boost/foreach.hpp>
@@ -309,6 +310,10 @@ public:
 struct CCoinsCacheEntry {
     CCoins coins; // The actual cached data.
     unsigned char flags;
+    // The parent view's version of a DIRTY entry that is not FRESH, saved when it
+    // was first modified, so the coin database can update its statistics
+    // without reading the old entry back.
+    std::shared_ptr<const CCoins> pcoinsParent;
 
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
@@ -423,6 +428,9 @@ protected:
     mutable uint256 hashBlock;
     mutable CCoinsMap cacheCoins;
 
+    /* Number of entries holding a copy of the parent view's version, counted in GetCacheSize(). */
+    unsigned int cachedParentCoins;
+
 public:
     CCoinsViewCache(CCoinsView* baseIn);
     ~CCoinsViewCache();
@@ -455,7 +463,7 @@ public:
      */
     bool Flush();
 
-    //! Calculate the size of the cache (in number of transactions)
+    //! Calculate the size of the cache (in number of transactions, including the saved parent versions)
     unsigned int GetCacheSize() const;
 
     /** 
@@ -481,6 +489,9 @@ public:
 private:
     CCoinsMap::iterator FetchCoins(const uint256& txid);
     CCoinsMap::const_iterator FetchCoins(const uint256& txid) const;
+
+    /** Mark an entry DIRTY, saving the parent view's version the first time an entry the parent has is modified */
+    void MarkDirty(CCoinsCacheEntry& entry);
 };
 
 #endif // BITCOIN_COINS_H
@@ -263,6 +263,8 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
                 return error("Failed to read zleno seed from DB. Wallet is probably corrupt.");
             }
             pwalletMain->zwalletMain->SetMasterSeed(nSeed, false);
+            pwalletMain->zwalletMain->LoadMintPoolFromDB();
+            pwalletMain->zwalletMain->GenerateMintPool();
         } else {
             // First time this wallet has been unlocked with dzleno
             // Borrow random generator from the key class so that we don't have to worry about randomness
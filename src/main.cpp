@@ -13,6 +13,7 @@
 #include "accumulatormap.h"
 #include "addrman.h"
 #include "alert.h"
+#include "blockfilter.h"
 #include "blocksignature.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -41,6 +42,7 @@
 #include "libzerocoin/Denominations.h"
 #include "invalid.h"
 
+#include <atomic>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -63,6 +65,14 @@ using namespace libzerocoin;
 
 CCriticalSection cs_main;
 
+/**
+ * Serializes the masternode, budget, spork, SwiftTX and obfuscation message
+ * handlers (and readers of their relay maps) across message handler threads,
+ * so they no longer run under cs_main. May be held while acquiring cs_main;
+ * code holding cs_main must only TRY_LOCK it.
+ */
+static CCriticalSection cs_extensionMessages;
+
 BlockMap mapBlockIndex;
 map<uint256, uint256> mapProofOfStake;
 set<pair<COutPoint, unsigned int> > setStakeSeen;
@@ -75,7 +85,9 @@ CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
+std::atomic<bool> fMempoolLoaded(false);
 bool fTxIndex = true;
+bool fBlockFilterIndex = false;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
@@ -614,8 +626,10 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache* pcoinsTip = NULL;
+CCoinsViewDB* pcoinsdbview = NULL;
 CBlockTreeDB* pblocktree = NULL;
 CZerocoinDB* zerocoinDB = NULL;
+CBlockFilterDB* pblockfilterdb = NULL;
 CSporkDB* pSporkDB = NULL;
 
 //////////////////////////////////////////////////////////////////////////////
@@ -924,10 +938,7 @@ int GetInputAgeIX(uint256 nTXHash, CTxIn& vin)
 	if (nResult < 0) nResult = 0;
 
 	if (nResult < 6) {
-		std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
-		if (i != mapTxLocks.end()) {
-			sigs = (*i).second.CountSignatures();
-		}
+		sigs = txLockManager.GetLockSignatures(nTXHash);
 		if (sigs >= SWIFTTX_SIGNATURES_REQUIRED) {
 			return nSwiftTXDepth + nResult;
 		}
@@ -940,10 +951,7 @@ int GetIXConfirmations(uint256 nTXHash)
 {
 	int sigs = 0;
 
-	std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
-	if (i != mapTxLocks.end()) {
-		sigs = (*i).second.CountSignatures();
-	}
+	sigs = txLockManager.GetLockSignatures(nTXHash);
 	if (sigs >= SWIFTTX_SIGNATURES_REQUIRED) {
 		return nSwiftTXDepth;
 	}
@@ -1076,6 +1084,94 @@ bool ContextualCheckZerocoinSpendNoSerialCheck(const CTransaction& tx, const Coi
 	return true;
 }
 
+namespace {
+
+/**
+ * Valid zerocoin spend proof cache, to avoid verifying the same spend twice
+ * (once when accepted into the memory pool, and again when its block arrives).
+ * Entries are the hash of the spend script, the accumulator checksum and the
+ * parameter set the proof was verified with.
+ */
+class CZerocoinProofCache
+{
+private:
+	std::set<uint256> setValid;
+	boost::shared_mutex cs_proofcache;
+
+public:
+	bool Get(const uint256& hash)
+	{
+		boost::shared_lock<boost::shared_mutex> lock(cs_proofcache);
+		return setValid.count(hash) > 0;
+	}
+
+	void Set(const uint256& hash)
+	{
+		boost::unique_lock<boost::shared_mutex> lock(cs_proofcache);
+
+		// Evict a random entry, as in the signature cache
+		while (setValid.size() >= MAX_ZEROCOIN_PROOF_CACHE_SIZE) {
+			std::set<uint256>::iterator it = setValid.lower_bound(GetRandHash());
+			if (it == setValid.end())
+				it = setValid.begin();
+			setValid.erase(it);
+		}
+		setValid.insert(hash);
+	}
+};
+
+CZerocoinProofCache zerocoinProofCache;
+
+} // anon namespace
+
+static bool VerifyZerocoinSpendProof(const CTxIn& txin, const CoinSpend& spend, bool fUseV1Params, CValidationState& state)
+{
+	uint32_t nChecksum = spend.getAccumulatorChecksum();
+	CHashWriter ss(SER_GETHASH, 0);
+	ss << txin.scriptSig << nChecksum << fUseV1Params;
+	uint256 hashProof = ss.GetHash();
+	if (zerocoinProofCache.Get(hashProof))
+		return true;
+
+	//see if we have record of the accumulator used in the spend tx
+	CBigNum bnAccumulatorValue = 0;
+	if (!zerocoinDB->ReadAccumulatorValue(nChecksum, bnAccumulatorValue))
+		return state.DoS(100, error("%s: Zerocoinspend could not find accumulator associated with checksum %s", __func__, HexStr(BEGIN(nChecksum), END(nChecksum))));
+
+	Accumulator accumulator(Params().Zerocoin_Params(fUseV1Params), spend.getDenomination(), bnAccumulatorValue);
+
+	//Check that the coin has been accumulated
+	if (!spend.Verify(accumulator))
+		return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
+
+	zerocoinProofCache.Set(hashProof);
+	return true;
+}
+
+bool CheckZerocoinSpendProofs(const CTransaction& tx, CValidationState& state)
+{
+	bool fUseV1Params;
+	{
+		LOCK(cs_main);
+		// Same condition as CheckTransaction, proofs it would skip are not worth checking early
+		if (IsInitialBlockDownload() || GetTime() - chainActive.Tip()->GetBlockTime() >= (60 * 60 * 24))
+			return true;
+		fUseV1Params = chainActive.Height() < Params().Zerocoin_Block_V2_Start();
+	}
+
+	for (const CTxIn& txin : tx.vin) {
+		if (!txin.scriptSig.IsZerocoinSpend())
+			continue;
+
+		CoinSpend spend = TxInToZerocoinSpend(txin);
+		if (spend.getDenomination() == ZQ_ERROR)
+			return state.DoS(100, error("Zerocoinspend does not have the correct denomination"));
+		if (!VerifyZerocoinSpendProof(txin, spend, fUseV1Params, state))
+			return false;
+	}
+	return true;
+}
+
 bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state)
 {
 	//max needed non-mint outputs should be 2 - one for redemption address and a possible 2nd for change
@@ -1123,21 +1219,8 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
 			return state.DoS(100, error("Zerocoinspend does not use the same txout that was used in the SoK"));
 
 		// Skip signature verification during initial block download
-		if (fVerifySignature) {
-			//see if we have record of the accumulator used in the spend tx
-			CBigNum bnAccumulatorValue = 0;
-			if (!zerocoinDB->ReadAccumulatorValue(newSpend.getAccumulatorChecksum(), bnAccumulatorValue)) {
-				uint32_t nChecksum = newSpend.getAccumulatorChecksum();
-				return state.DoS(100, error("%s: Zerocoinspend could not find accumulator associated with checksum %s", __func__, HexStr(BEGIN(nChecksum), END(nChecksum))));
-			}
-
-			Accumulator accumulator(Params().Zerocoin_Params(chainActive.Height() < Params().Zerocoin_Block_V2_Start()),
-				newSpend.getDenomination(), bnAccumulatorValue);
-
-			//Check that the coin has been accumulated
-			if (!newSpend.Verify(accumulator))
-				return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
-		}
+		if (fVerifySignature && !VerifyZerocoinSpendProof(txin, newSpend, chainActive.Height() < Params().Zerocoin_Block_V2_Start(), state))
+			return false;
 
 		if (serials.count(newSpend.getCoinSerialNumber()))
 			return state.DoS(100, error("Zerocoinspend serial is used twice in the same tx"));
@@ -1307,8 +1390,16 @@ CAmount GetMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowF
 	return nMinFee;
 }
 
+static void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age)
+{
+	int expired = pool.Expire(GetTime() - age);
+	if (expired != 0)
+		LogPrint("mempool", "Expired %i transactions from the memory pool\n", expired);
+
+	pool.TrimToSize(limit);
+}
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, int64_t nAcceptTime, bool fRejectInsaneFee, bool ignoreFees)
 {
 	AssertLockHeld(cs_main);
 	if (pfMissingInputs)
@@ -1346,14 +1437,11 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
 	// ----------- swiftTX transaction scanning -----------
 
-	BOOST_FOREACH(const CTxIn& in, tx.vin) {
-		if (mapLockedInputs.count(in.prevout)) {
-			if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-				return state.DoS(0,
-					error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason),
-					REJECT_INVALID, "tx-lock-conflict");
-			}
-		}
+	uint256 txHashLocked;
+	if (txLockManager.HasConflictingLock(tx, txHashLocked)) {
+		return state.DoS(0,
+			error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason),
+			REJECT_INVALID, "tx-lock-conflict");
 	}
 
 	// Check for conflicts with in-memory transactions
@@ -1472,9 +1560,9 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 		CAmount nFees = nValueIn - nValueOut;
 		double dPriority = 0;
 		if (!tx.IsZerocoinSpend())
-			view.GetPriority(tx, chainActive.Height());
+			dPriority = view.GetPriority(tx, chainActive.Height());
 
-		CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height());
+		CTxMemPoolEntry entry(tx, nFees, nAcceptTime, dPriority, chainActive.Height());
 		unsigned int nSize = entry.GetTxSize();
 
 		// Don't accept it if it can't get into a block
@@ -1489,6 +1577,13 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 					hash.ToString(), nFees, txMinFee),
 					REJECT_INSUFFICIENTFEE, "insufficient fee");
 
+			// Once the pool has had to evict, new transactions have to outbid what was evicted
+			CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+			if (mempoolRejectFee > 0 && nFees < mempoolRejectFee && !tx.IsZerocoinSpend())
+				return state.DoS(0, error("AcceptToMemoryPool : mempool min fee not met %s, %d < %d",
+					hash.ToString(), nFees, mempoolRejectFee),
+					REJECT_INSUFFICIENTFEE, "mempool min fee not met");
+
 			// Require that free transactions have sufficient priority to be mined in the next block.
 			if (tx.IsZerocoinMint()) {
 				if (nFees < Params().Zerocoin_MintFee() * tx.GetZerocoinMintCount())
@@ -1527,6 +1622,17 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 				hash.ToString(),
 				nFees, ::minRelayTxFee.GetFee(nSize) * 10000);
 
+		// Calculate in-mempool ancestors, up to a limit.
+		std::set<uint256> setAncestors;
+		size_t nLimitAncestors = GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
+		size_t nLimitAncestorSize = GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT) * 1000;
+		size_t nLimitDescendants = GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
+		size_t nLimitDescendantSize = GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000;
+		std::string errString;
+		if (!pool.CalculateMemPoolAncestors(tx, nSize, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString))
+			return state.DoS(0, error("AcceptToMemoryPool : too long mempool chain %s, %s", hash.ToString(), errString),
+				REJECT_NONSTANDARD, "too-long-mempool-chain");
+
 		// Check against previous transactions
 		// This is done last to help prevent CPU exhaustion denial-of-service attacks.
 		if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true)) {
@@ -1548,9 +1654,14 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
 		// Store transaction in memory
 		pool.addUnchecked(hash, entry);
+
+		// trim mempool and check if tx was trimmed
+		LimitMempoolSize(pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+		if (!pool.exists(hash))
+			return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
 	}
 
-	SyncWithWallets(tx, NULL);
+	SyncWithWallets(tx);
 
 	//Track zerocoinspends and ensure that they are given priority to make it into the blockchain
 	if (tx.IsZerocoinSpend())
@@ -1559,6 +1670,11 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 	return true;
 }
 
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+{
+	return AcceptToMemoryPoolWithTime(pool, state, tx, fLimitFree, pfMissingInputs, GetTime(), fRejectInsaneFee, ignoreFees);
+}
+
 bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool isDSTX)
 {
 	AssertLockHeld(cs_main);
@@ -1589,14 +1705,11 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 
 	// ----------- swiftTX transaction scanning -----------
 
-	BOOST_FOREACH(const CTxIn& in, tx.vin) {
-		if (mapLockedInputs.count(in.prevout)) {
-			if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-				return state.DoS(0,
-					error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
-					REJECT_INVALID, "tx-lock-conflict");
-			}
-		}
+	uint256 txHashLocked;
+	if (txLockManager.HasConflictingLock(tx, txHashLocked)) {
+		return state.DoS(0,
+			error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
+			REJECT_INVALID, "tx-lock-conflict");
 	}
 
 	// Check for conflicts with in-memory transactions
@@ -1759,6 +1872,165 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 	return true;
 }
 
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+
+bool DumpMempool()
+{
+	int64_t nStart = GetTimeMillis();
+
+	// Parents before their children, so that the children find them when loading
+	std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+	std::vector<std::pair<CTransaction, int64_t> > vEntries;
+	{
+		LOCK(mempool.cs);
+		mapDeltas = mempool.mapDeltas;
+		std::vector<std::pair<uint64_t, uint256> > vOrder;
+		vOrder.reserve(mempool.mapTx.size());
+		for (std::map<uint256, CTxMemPoolEntry>::const_iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi)
+			vOrder.push_back(make_pair(mi->second.GetCountWithAncestors(), mi->first));
+		std::sort(vOrder.begin(), vOrder.end());
+
+		vEntries.reserve(vOrder.size());
+		for (const std::pair<uint64_t, uint256>& item : vOrder) {
+			const CTxMemPoolEntry& entry = mempool.mapTx[item.second];
+			vEntries.push_back(make_pair(entry.GetTx(), entry.GetTime()));
+		}
+	}
+
+	boost::filesystem::path pathMempool = GetDataDir() / "mempool.dat";
+	boost::filesystem::path pathTmp = GetDataDir() / "mempool.dat.new";
+	try {
+		CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+		if (fileout.IsNull())
+			return error("%s : failed to open %s", __func__, pathTmp.string());
+
+		fileout << MEMPOOL_DUMP_VERSION;
+		fileout << mapDeltas;
+		fileout << (uint64_t)vEntries.size();
+		for (const std::pair<CTransaction, int64_t>& entry : vEntries)
+			fileout << entry.first << entry.second;
+
+		FileCommit(fileout.Get());
+		fileout.fclose();
+	} catch (const std::exception& e) {
+		return error("%s : failed to write %s: %s", __func__, pathTmp.string(), e.what());
+	}
+	if (!RenameOver(pathTmp, pathMempool))
+		return error("%s : failed to rename %s", __func__, pathTmp.string());
+
+	LogPrintf("Dumped mempool: %u transactions, %dms\n", vEntries.size(), GetTimeMillis() - nStart);
+	return true;
+}
+
+/** A transaction read from mempool.dat */
+struct CMempoolLoadTx {
+	CTransaction tx;
+	int64_t nTime;
+	bool fProofsValid; //!< False if a zerocoin spend proof failed to verify
+
+	CMempoolLoadTx() : nTime(0), fProofsValid(true) {}
+};
+
+void static ThreadVerifyMempoolProofs(std::vector<CMempoolLoadTx>* pvTx, std::atomic<size_t>* pnNext)
+{
+	size_t i;
+	while ((i = (*pnNext)++) < pvTx->size()) {
+		CMempoolLoadTx& loadtx = (*pvTx)[i];
+		if (!loadtx.tx.IsZerocoinSpend())
+			continue;
+
+		try {
+			CValidationState state;
+			loadtx.fProofsValid = CheckZerocoinSpendProofs(loadtx.tx, state);
+		} catch (const std::exception& e) {
+			LogPrintf("%s : failed to verify %s: %s\n", __func__, loadtx.tx.GetHash().ToString(), e.what());
+			loadtx.fProofsValid = false;
+		}
+	}
+}
+
+bool LoadMempool()
+{
+	boost::filesystem::path pathMempool = GetDataDir() / "mempool.dat";
+	CAutoFile filein(fopen(pathMempool.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+	// Allowed to fail as this file IS missing on first startup.
+	if (filein.IsNull()) {
+		LogPrintf("%s : no mempool file on disk, continuing anyway\n", __func__);
+		return false;
+	}
+
+	int64_t nStart = GetTimeMillis();
+	int64_t nNow = GetTime();
+	int64_t nExpiryTimeout = GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+	int nThreads = std::max(1, std::min((int)boost::thread::hardware_concurrency(), MAX_MEMPOOL_LOAD_THREADS));
+	int nAccepted = 0;
+	int nFailed = 0;
+	int nExpired = 0;
+	try {
+		uint64_t nVersion;
+		filein >> nVersion;
+		if (nVersion != MEMPOOL_DUMP_VERSION)
+			return error("%s : unknown mempool file version %d", __func__, nVersion);
+
+		// Deltas also apply to transactions that are not in the pool
+		std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+		filein >> mapDeltas;
+		for (const std::pair<const uint256, std::pair<double, CAmount> >& delta : mapDeltas)
+			mempool.PrioritiseTransaction(delta.first, delta.first.ToString(), delta.second.first, delta.second.second);
+
+		uint64_t nTotal;
+		filein >> nTotal;
+		uint64_t nRead = 0;
+		while (nRead < nTotal) {
+			std::vector<CMempoolLoadTx> vBatch;
+			bool fZerocoinSpends = false;
+			while (nRead < nTotal && vBatch.size() < MEMPOOL_LOAD_BATCH_SIZE) {
+				CMempoolLoadTx loadtx;
+				filein >> loadtx.tx >> loadtx.nTime;
+				nRead++;
+				if (loadtx.nTime + nExpiryTimeout <= nNow) {
+					nExpired++;
+					continue;
+				}
+				fZerocoinSpends |= loadtx.tx.IsZerocoinSpend();
+				vBatch.push_back(loadtx);
+			}
+
+			// Verify the zerocoin spend proofs of the batch in parallel, before
+			// taking cs_main. AcceptToMemoryPool then finds them cached.
+			if (fZerocoinSpends) {
+				boost::this_thread::disable_interruption di;
+				std::atomic<size_t> nNext(0);
+				boost::thread_group verifiers;
+				for (int i = 0; i < nThreads; i++)
+					verifiers.create_thread(boost::bind(&ThreadVerifyMempoolProofs, &vBatch, &nNext));
+				verifiers.join_all();
+			}
+
+			for (const CMempoolLoadTx& loadtx : vBatch) {
+				if (ShutdownRequested())
+					return false;
+
+				CValidationState state;
+				bool fAccepted = false;
+				if (loadtx.fProofsValid) {
+					LOCK(cs_main);
+					fAccepted = AcceptToMemoryPoolWithTime(mempool, state, loadtx.tx, false, NULL, loadtx.nTime);
+				}
+				if (fAccepted)
+					nAccepted++;
+				else
+					nFailed++;
+			}
+		}
+	} catch (const std::exception& e) {
+		return error("%s : failed to read %s: %s, continuing anyway", __func__, pathMempool.string(), e.what());
+	}
+
+	LogPrintf("Imported mempool transactions from disk: %i accepted, %i failed, %i expired, %dms\n", nAccepted, nFailed, nExpired, GetTimeMillis() - nStart);
+	return true;
+}
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock, bool fAllowSlow)
 {
@@ -2114,12 +2386,13 @@ void CheckForkWarningConditionsOnNewFork(CBlockIndex* pindexNewForkTip)
 	CheckForkWarningConditions();
 }
 
-// Requires cs_main.
+// Takes cs_main, since the extension message handlers call this without it.
 void Misbehaving(NodeId pnode, int howmuch)
 {
 	if (howmuch == 0)
 		return;
 
+	LOCK(cs_main);
 	CNodeState* state = State(pnode);
 	if (state == NULL)
 		return;
@@ -2543,6 +2816,93 @@ void ThreadScriptCheck()
 	scriptcheckqueue.Thread();
 }
 
+/**
+ * Index the filter of a block, chaining its filter header to the parent's.
+ * Blocks whose parent has no filter yet are left to ThreadBlockFilterIndex.
+ */
+static bool IndexBlockFilter(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+	uint256 hashPrevHeader = 0;
+	if (pindex->pprev && !pblockfilterdb->ReadFilterHeader(pindex->pprev->GetBlockHash(), hashPrevHeader))
+		return true;
+
+	CBlockFilter filter(block, blockundo);
+	return pblockfilterdb->WriteFilter(filter, filter.ComputeHeader(hashPrevHeader));
+}
+
+void ThreadBlockFilterIndex()
+{
+	int64_t nStart = GetTimeMillis();
+	int nBuilt = 0;
+
+	// Resume after the last block indexed, or the part of it still in the active chain
+	const CBlockIndex* pindexLast = NULL;
+	{
+		LOCK(cs_main);
+		uint256 hashBest;
+		if (pblockfilterdb->ReadBestBlock(hashBest) && mapBlockIndex.count(hashBest))
+			pindexLast = chainActive.FindFork(mapBlockIndex[hashBest]);
+	}
+
+	while (true) {
+		boost::this_thread::interruption_point();
+
+		CBlockIndex* pindex;
+		CDiskBlockPos posUndo;
+		{
+			LOCK(cs_main);
+			pindex = pindexLast ? chainActive.Next(chainActive.FindFork(pindexLast)) : chainActive.Genesis();
+			if (!pindex)
+				break;
+			if (pindex->nStatus & BLOCK_HAVE_UNDO)
+				posUndo = pindex->GetUndoPos();
+		}
+
+		// Connected since the last pass, or indexed before a restart
+		if (pblockfilterdb->HaveFilter(pindex->GetBlockHash())) {
+			pindexLast = pindex;
+			continue;
+		}
+
+		uint256 hashPrevHeader = 0;
+		if (pindex->pprev && !pblockfilterdb->ReadFilterHeader(pindex->pprev->GetBlockHash(), hashPrevHeader)) {
+			error("%s : no filter header for block %s", __func__, pindex->pprev->GetBlockHash().ToString());
+			return;
+		}
+
+		CBlock block;
+		CBlockUndo blockundo;
+		if (!ReadBlockFromDisk(block, pindex)) {
+			error("%s : failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+			return;
+		}
+		// Blocks below a loaded UTXO snapshot have no undo data, so their spent scripts are unknown
+		if (pindex->pprev && (posUndo.IsNull() || !blockundo.ReadFromDisk(posUndo, pindex->pprev->GetBlockHash()))) {
+			error("%s : no undo data for block %s at height %d, cannot build its filter", __func__, pindex->GetBlockHash().ToString(), pindex->nHeight);
+			return;
+		}
+
+		CBlockFilter filter(block, blockundo);
+		if (!pblockfilterdb->WriteFilter(filter, filter.ComputeHeader(hashPrevHeader))) {
+			error("%s : failed to write the filter of block %s", __func__, pindex->GetBlockHash().ToString());
+			return;
+		}
+		pindexLast = pindex;
+
+		if (++nBuilt % 10000 == 0)
+			LogPrintf("%s : built filters up to height %d\n", __func__, pindex->nHeight);
+	}
+
+	LogPrintf("%s : block filter index synced, %d filters built in %dms\n", __func__, nBuilt, GetTimeMillis() - nStart);
+}
+
+bool GetBlockFilter(const CBlockIndex* pindex, CBlockFilter& filter, uint256* pHashHeader)
+{
+	if (!pblockfilterdb || !pblockfilterdb->ReadFilter(pindex->GetBlockHash(), filter))
+		return false;
+	return !pHashHeader || pblockfilterdb->ReadFilterHeader(pindex->GetBlockHash(), *pHashHeader);
+}
+
 void RecalculateZLENOMinted()
 {
 	CBlockIndex *pindex = chainActive[Params().Zerocoin_StartHeight()];
@@ -3052,6 +3412,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 		setDirtyBlockIndex.insert(pindex);
 	}
 
+	if (fBlockFilterIndex && !IndexBlockFilter(block, blockundo, pindex))
+		return state.Abort("Failed to write block filter");
+
 	//Record zleno serials
 	set<uint256> setAddedTx;
 	for (pair<CoinSpend, uint256> pSpend : vSpends) {
@@ -3082,6 +3445,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 	// Flush spend/mint info to disk
 	if (!zerocoinDB->WriteCoinSpendBatch(vSpends)) return state.Abort(("Failed to record coin serials to database"));
 	if (!zerocoinDB->WriteCoinMintBatch(vMints)) return state.Abort(("Failed to record new mints to database"));
+	if (pindex->nHeight >= Params().Zerocoin_StartHeight()) {
+		std::vector<CZerocoinBlockMint> vBlockMints;
+		if (!BlockToZerocoinBlockMints(block, vBlockMints) || !zerocoinDB->WriteBlockMints(pindex->GetBlockHash(), vBlockMints))
+			return state.Abort("Failed to record block mints to database");
+	}
 
 	//Record accumulator checksums
 	DatabaseChecksums(mapAccumulators);
@@ -3172,7 +3540,7 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
 				return state.Abort("Failed to write to coin database");
 			// Update best block in wallet (so we can detect restored wallets).
 			if (mode != FLUSH_STATE_IF_NEEDED) {
-				GetMainSignals().SetBestChain(chainActive.GetLocator());
+				SignalSetBestChain(chainActive.GetLocator());
 			}
 			nLastWrite = GetTimeMicros();
 		}
@@ -3264,7 +3632,7 @@ bool static DisconnectTip(CValidationState& state)
 	// Let wallets know transactions went from 1-confirmed to
 	// 0-confirmed or conflicted:
 	BOOST_FOREACH(const CTransaction& tx, block.vtx) {
-		SyncWithWallets(tx, NULL);
+		SyncWithWallets(tx);
 	}
 	return true;
 }
@@ -3339,12 +3707,10 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
 	// Tell wallet about transactions that went from mempool
 	// to conflicted:
 	BOOST_FOREACH(const CTransaction& tx, txConflicted) {
-		SyncWithWallets(tx, NULL);
+		SyncWithWallets(tx);
 	}
 	// ... and about transactions that got confirmed:
-	BOOST_FOREACH(const CTransaction& tx, pblock->vtx) {
-		SyncWithWallets(tx, pblock);
-	}
+	SyncWithWallets(*pblock);
 
 	int64_t nTime6 = GetTimeMicros();
 	nTimePostConnect += nTime6 - nTime5;
@@ -3633,7 +3999,7 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock, bool fAlreadyChe
 			// Notify external listeners about the new tip.
 			// Note: uiInterface, should switch main signals.
 			uiInterface.NotifyBlockTip(hashNewTip);
-			GetMainSignals().UpdatedBlockTip(pindexNewTip);
+			SignalUpdatedBlockTip(pindexNewTip);
 
 			unsigned size = 0;
 			if (pblock)
@@ -3723,6 +4089,28 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex)
 	return true;
 }
 
+bool ActivateSnapshotChain(CValidationState& state, CBlockIndex* pindexBase)
+{
+	AssertLockHeld(cs_main);
+	assert(pindexBase->GetAncestor(chainActive.Height()) == chainActive.Tip());
+
+	// The snapshot stands in for connecting these blocks
+	for (CBlockIndex* pindex = pindexBase; pindex != NULL; pindex = pindex->pprev) {
+		pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+		setDirtyBlockIndex.insert(pindex);
+	}
+	setBlockIndexCandidates.insert(pindexBase);
+
+	mempool.clear();
+	UpdateTip(pindexBase);
+	PruneBlockIndexCandidates();
+	if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS))
+		return false;
+
+	LogPrintf("%s: activated UTXO snapshot at height %d (%s)\n", __func__, pindexBase->nHeight, pindexBase->GetBlockHash().ToString());
+	return true;
+}
+
 CBlockIndex* AddToBlockIndex(const CBlock& block)
 {
 	// Check for duplicate
@@ -4011,15 +4399,12 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
 		BOOST_FOREACH(const CTransaction& tx, block.vtx) {
 			if (!tx.IsCoinBase()) {
 				//only reject blocks when it's based on complete consensus
-				BOOST_FOREACH(const CTxIn& in, tx.vin) {
-					if (mapLockedInputs.count(in.prevout)) {
-						if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-							mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
-							LogPrintf("CheckBlock() : found conflicting transaction with transaction lock %s %s\n", mapLockedInputs[in.prevout].ToString(), tx.GetHash().ToString());
-							return state.DoS(0, error("CheckBlock() : found conflicting transaction with transaction lock"),
-								REJECT_INVALID, "conflicting-tx-ix");
-						}
-					}
+				uint256 txHashLocked;
+				if (txLockManager.HasConflictingLock(tx, txHashLocked)) {
+					mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
+					LogPrintf("CheckBlock() : found conflicting transaction with transaction lock %s %s\n", txHashLocked.ToString(), tx.GetHash().ToString());
+					return state.DoS(0, error("CheckBlock() : found conflicting transaction with transaction lock"),
+						REJECT_INVALID, "conflicting-tx-ix");
 				}
 			}
 		}
@@ -4646,6 +5031,10 @@ void CBlockIndex::BuildSkip()
 
 bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDiskBlockPos* dbp)
 {
+	// Don't run ahead of the wallet and other listeners by more than the
+	// queue bound; they need cs_main to catch up, so wait before taking it.
+	LimitValidationInterfaceQueue();
+
 	// Preliminary checks
 	int64_t nStartTime = GetTimeMillis();
 	bool checked = CheckBlock(*pblock, state);
@@ -5000,6 +5389,9 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
 		uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
 		if (pindex->nHeight < chainActive.Height() - nCheckDepth)
 			break;
+		// Blocks below a loaded UTXO snapshot were never connected here and have no undo data
+		if (!(pindex->nStatus & BLOCK_HAVE_UNDO))
+			break;
 		CBlock block;
 		// check level 0: read from disk
 		if (!ReadBlockFromDisk(block, pindex))
@@ -5422,6 +5814,13 @@ string GetWarnings(string strFor)
 //
 
 
+/** Whether an inventory item is checked against chain state (cs_main) rather than the extension maps (cs_extensionMessages) */
+bool static IsChainInv(const CInv& inv)
+{
+	return inv.type == MSG_TX || inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK;
+}
+
+// requires LOCK(cs_main) for chain inventory, LOCK(cs_extensionMessages) otherwise
 bool static AlreadyHave(const CInv& inv)
 {
 	switch (inv.type) {
@@ -5436,10 +5835,10 @@ bool static AlreadyHave(const CInv& inv)
 	case MSG_BLOCK:
 		return mapBlockIndex.count(inv.hash);
 	case MSG_TXLOCK_REQUEST:
-		return mapTxLockReq.count(inv.hash) ||
-			mapTxLockReqRejected.count(inv.hash);
+		return txLockManager.HasLockRequest(inv.hash) ||
+			txLockManager.HasRejectedLockRequest(inv.hash);
 	case MSG_TXLOCK_VOTE:
-		return mapTxLockVote.count(inv.hash);
+		return txLockManager.HasVote(inv.hash);
 	case MSG_SPORK:
 		return mapSporks.count(inv.hash);
 	case MSG_MASTERNODE_WINNER:
@@ -5502,6 +5901,13 @@ void static ProcessGetData(CNode* pfrom)
 		const CInv& inv = *it;
 		{
 			boost::this_thread::interruption_point();
+
+			// cs_main is held, so never wait for the extension handlers; the
+			// request is answered on a later pass to keep responses in order.
+			TRY_LOCK(cs_extensionMessages, lockExtensions);
+			if (!lockExtensions && !IsChainInv(inv))
+				break;
+
 			it++;
 
 			if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
@@ -5586,19 +5992,21 @@ void static ProcessGetData(CNode* pfrom)
 					}
 				}
 				if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
-					if (mapTxLockVote.count(inv.hash)) {
+					CConsensusVote vote;
+					if (txLockManager.GetVote(inv.hash, vote)) {
 						CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
 						ss.reserve(1000);
-						ss << mapTxLockVote[inv.hash];
+						ss << vote;
 						pfrom->PushMessage("txlvote", ss);
 						pushed = true;
 					}
 				}
 				if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
-					if (mapTxLockReq.count(inv.hash)) {
+					CTransaction txLockReq;
+					if (txLockManager.GetLockRequest(inv.hash, txLockReq)) {
 						CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
 						ss.reserve(1000);
-						ss << mapTxLockReq[inv.hash];
+						ss << txLockReq;
 						pfrom->PushMessage("ix", ss);
 						pushed = true;
 					}
@@ -5721,6 +6129,38 @@ void static ProcessGetData(CNode* pfrom)
 }
 
 bool fRequestedSporksIDB = false;
+/**
+ * Validate a getcfilters or getcfheaders request for at most nMaxCount blocks
+ * from nStartHeight to hashStop, disconnecting peers that send invalid ones.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, uint8_t nFilterType, uint32_t nStartHeight, const uint256& hashStop, uint32_t nMaxCount, const CBlockIndex*& pindexStop)
+{
+	if (!(nLocalServices & NODE_COMPACT_FILTERS) || nFilterType != BASIC_BLOCK_FILTER_TYPE) {
+		LogPrint("net", "peer %d requested unsupported block filter type %d\n", pfrom->id, nFilterType);
+		pfrom->fDisconnect = true;
+		return false;
+	}
+
+	{
+		LOCK(cs_main);
+		BlockMap::iterator mi = mapBlockIndex.find(hashStop);
+		if (mi == mapBlockIndex.end() || !mi->second->IsValid(BLOCK_VALID_SCRIPTS)) {
+			LogPrint("net", "peer %d requested filters up to unknown block %s\n", pfrom->id, hashStop.ToString());
+			pfrom->fDisconnect = true;
+			return false;
+		}
+		pindexStop = mi->second;
+	}
+
+	uint32_t nStopHeight = pindexStop->nHeight;
+	if (nStartHeight > nStopHeight || nStopHeight - nStartHeight >= nMaxCount) {
+		LogPrint("net", "peer %d requested too many or no filters: start height %d, stop height %d\n", pfrom->id, nStartHeight, nStopHeight);
+		pfrom->fDisconnect = true;
+		return false;
+	}
+	return true;
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
 	RandAddSeedPerfmon();
@@ -5943,8 +6383,6 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 			return error("message inv size() = %u", vInv.size());
 		}
 
-		LOCK(cs_main);
-
 		std::vector<CInv> vToFetch;
 
 		for (unsigned int nInv = 0; nInv < vInv.size(); nInv++) {
@@ -5953,6 +6391,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 			boost::this_thread::interruption_point();
 			pfrom->AddInventoryKnown(inv);
 
+			// Only transactions and blocks need cs_main
+			CCriticalSection& csInv = IsChainInv(inv) ? cs_main : cs_extensionMessages;
+			LOCK(csInv);
+
 			bool fAlreadyHave = AlreadyHave(inv);
 			LogPrint("net", "got inv: %s  %s peer=%d\n", inv.ToString(), fAlreadyHave ? "have" : "new", pfrom->id);
 
@@ -5973,6 +6415,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 			GetMainSignals().Inventory(inv.hash);
 
 			if (pfrom->nSendSize > (SendBufferSize() * 2)) {
+				LOCK(cs_main);
 				Misbehaving(pfrom->GetId(), 50);
 				return error("send buffer size() = %u", pfrom->nSendSize);
 			}
@@ -6129,13 +6572,33 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 		CInv inv(MSG_TX, tx.GetHash());
 		pfrom->AddInventoryKnown(inv);
 
+		LimitValidationInterfaceQueue();
+
+		// Verify zerocoin spend proofs before taking cs_main, AcceptToMemoryPool then finds them cached
+		CValidationState stateProofs;
+		if (tx.IsZerocoinSpend() && GetAdjustedTime() <= GetSporkValue(SPORK_16_ZEROCOIN_MAINTENANCE_MODE) &&
+			!CheckZerocoinSpendProofs(tx, stateProofs)) {
+			int nDoS = 0;
+			stateProofs.IsInvalid(nDoS);
+			LogPrint("mempool", "%s from peer=%d %s has an invalid zerocoin spend proof\n", tx.GetHash().ToString(), pfrom->id, pfrom->cleanSubVer);
+			pfrom->PushMessage("reject", strCommand, REJECT_INVALID, std::string("bad-txns-invalid-zleno"), inv.hash);
+			if (nDoS > 0) {
+				LOCK(cs_main);
+				Misbehaving(pfrom->GetId(), nDoS);
+			}
+			return true;
+		}
+
 		LOCK(cs_main);
 
 		bool fMissingInputs = false;
 		bool fMissingZerocoinInputs = false;
 		CValidationState state;
 
-		mapAlreadyAskedFor.erase(inv);
+		{
+			LOCK(cs_mapAlreadyAskedFor);
+			mapAlreadyAskedFor.erase(inv);
+		}
 
 		if (!tx.IsZerocoinSpend() && AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, ignoreFees)) {
 			mempool.check(pcoinsTip);
@@ -6348,7 +6811,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 	// Making users (which are behind NAT and can only make outgoing connections) ignore
 	// getaddr message mitigates the attack.
 	else if ((strCommand == "getaddr") && (pfrom->fInbound)) {
-		pfrom->vAddrToSend.clear();
+		{
+			LOCK(pfrom->cs_vAddrToSend);
+			pfrom->vAddrToSend.clear();
+		}
 		vector<CAddress> vAddr = addrman.GetAddr();
 		BOOST_FOREACH(const CAddress& addr, vAddr)
 			pfrom->PushAddress(addr);
@@ -6545,6 +7011,61 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 	}
 
 
+	else if (strCommand == "getcfilters") {
+		uint8_t nFilterType;
+		uint32_t nStartHeight;
+		uint256 hashStop;
+		vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+		const CBlockIndex* pindexStop;
+		if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFILTERS_SIZE, pindexStop))
+			return true;
+
+		std::vector<CBlockFilter> vFilters;
+		for (const CBlockIndex* pindex = pindexStop; pindex && pindex->nHeight >= (int)nStartHeight; pindex = pindex->pprev) {
+			CBlockFilter filter;
+			if (!GetBlockFilter(pindex, filter)) {
+				LogPrint("net", "getcfilters: filter of block %s is not indexed yet, peer=%d\n", pindex->GetBlockHash().ToString(), pfrom->id);
+				return true;
+			}
+			vFilters.push_back(filter);
+		}
+		for (std::vector<CBlockFilter>::reverse_iterator it = vFilters.rbegin(); it != vFilters.rend(); ++it)
+			pfrom->PushMessage("cfilter", *it);
+	}
+
+
+	else if (strCommand == "getcfheaders") {
+		uint8_t nFilterType;
+		uint32_t nStartHeight;
+		uint256 hashStop;
+		vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+		const CBlockIndex* pindexStop;
+		if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFHEADERS_SIZE, pindexStop))
+			return true;
+
+		std::vector<uint256> vFilterHashes(pindexStop->nHeight - nStartHeight + 1);
+		const CBlockIndex* pindex = pindexStop;
+		for (size_t i = vFilterHashes.size(); i-- > 0; pindex = pindex->pprev) {
+			CBlockFilter filter;
+			if (!GetBlockFilter(pindex, filter)) {
+				LogPrint("net", "getcfheaders: filter of block %s is not indexed yet, peer=%d\n", pindex->GetBlockHash().ToString(), pfrom->id);
+				return true;
+			}
+			vFilterHashes[i] = filter.GetHash();
+		}
+
+		// Header of the filter before the first one, zero below the genesis block
+		uint256 hashPrevHeader = 0;
+		if (pindex && !pblockfilterdb->ReadFilterHeader(pindex->GetBlockHash(), hashPrevHeader)) {
+			LogPrint("net", "getcfheaders: filter header of block %s is not indexed yet, peer=%d\n", pindex->GetBlockHash().ToString(), pfrom->id);
+			return true;
+		}
+		pfrom->PushMessage("cfheaders", nFilterType, hashStop, hashPrevHeader, vFilterHashes);
+	}
+
+
 	else if (strCommand == "reject") {
 		if (fDebug) {
 			try {
@@ -6571,6 +7092,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 	}
 	else {
 		//probably one the extensions
+		LOCK(cs_extensionMessages);
 		obfuScationPool.ProcessMessageObfuscation(pfrom, strCommand, vRecv);
 		mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
 		budget.ProcessMessage(pfrom, strCommand, vRecv);
@@ -6764,8 +7286,10 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
 			LOCK(cs_vNodes);
 			BOOST_FOREACH(CNode* pnode, vNodes) {
 				// Periodically clear setAddrKnown to allow refresh broadcasts
-				if (nLastRebroadcast)
+				if (nLastRebroadcast) {
+					LOCK(pnode->cs_vAddrToSend);
 					pnode->setAddrKnown.clear();
+				}
 
 				// Rebroadcast our address
 				AdvertizeLocal(pnode);
@@ -6778,6 +7302,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
 		// Message: addr
 		//
 		if (fSendTrickle) {
+			LOCK(pto->cs_vAddrToSend);
 			vector<CAddress> vAddr;
 			vAddr.reserve(pto->vAddrToSend.size());
 			BOOST_FOREACH(const CAddress& addr, pto->vAddrToSend) {
@@ -6927,7 +7452,18 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
 		//
 		while (!pto->fDisconnect && !pto->mapAskFor.empty() && (*pto->mapAskFor.begin()).first <= nNow) {
 			const CInv& inv = (*pto->mapAskFor.begin()).second;
-			if (!AlreadyHave(inv)) {
+			bool fAlreadyHave;
+			if (IsChainInv(inv)) {
+				fAlreadyHave = AlreadyHave(inv);
+			} else {
+				// cs_main is held, so never wait for the extension handlers; the
+				// entry stays queued and is looked at again on the next pass.
+				TRY_LOCK(cs_extensionMessages, lockExtensions);
+				if (!lockExtensions)
+					break;
+				fAlreadyHave = AlreadyHave(inv);
+			}
+			if (!fAlreadyHave) {
 				if (fDebug)
 					LogPrint("net", "Requesting %s peer=%d\n", inv.ToString(), pto->id);
 				vGetData.push_back(inv);
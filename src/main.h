@@ -33,6 +33,7 @@
 #include "undo.h"
 
 #include <algorithm>
+#include <atomic>
 #include <exception>
 #include <map>
 #include <set>
@@ -45,8 +46,11 @@
 
 #include <boost/unordered_map.hpp>
 
+class CBlockFilter;
+class CBlockFilterDB;
 class CBlockIndex;
 class CBlockTreeDB;
+class CCoinsViewDB;
 class CZerocoinDB;
 class CSporkDB;
 class CBloomFilter;
@@ -78,6 +82,26 @@ static const unsigned int MAX_TX_SIGOPS_CURRENT = MAX_BLOCK_SIGOPS_CURRENT / 5;
 static const unsigned int MAX_TX_SIGOPS_LEGACY = MAX_BLOCK_SIGOPS_LEGACY / 5;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -maxmempool, maximum megabytes of mempool memory usage */
+static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
+/** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
+static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
+/** Default for -limitancestorcount, max number of in-mempool ancestors */
+static const unsigned int DEFAULT_ANCESTOR_LIMIT = 25;
+/** Default for -limitancestorsize, maximum kilobytes of tx + all in-mempool ancestors */
+static const unsigned int DEFAULT_ANCESTOR_SIZE_LIMIT = 101;
+/** Default for -limitdescendantcount, max number of in-mempool descendants */
+static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
+/** Default for -limitdescendantsize, maximum kilobytes of in-mempool descendants */
+static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
+/** Number of verified zerocoin spend proofs remembered between mempool and block validation */
+static const unsigned int MAX_ZEROCOIN_PROOF_CACHE_SIZE = 20000;
+/** Default for -persistmempool */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Number of mempool.dat transactions read and checked at a time when loading the mempool */
+static const unsigned int MEMPOOL_LOAD_BATCH_SIZE = 500;
+/** Maximum number of threads verifying zerocoin spend proofs when loading the mempool */
+static const int MAX_MEMPOOL_LOAD_THREADS = 8;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 														  /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -112,6 +136,15 @@ static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 /** Enable bloom filter */
 static const bool DEFAULT_PEERBLOOMFILTERS = true;
 
+/** Default for -blockfilterindex, maintain compact block filters */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+/** Default for -peerblockfilters, serve compact block filters to peers */
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+/** Maximum number of filters sent in reply to a getcfilters message */
+static const unsigned int MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of filter hashes sent in reply to a getcfheaders message */
+static const unsigned int MAX_GETCFHEADERS_SIZE = 2000;
+
 /** Default for -blockspamfilter, use header spam filter */
 static const bool DEFAULT_BLOCK_SPAM_FILTER = true;
 /** Default for -blockspamfiltermaxsize, maximum size of the list of indexes in the block spam filter */
@@ -146,8 +179,11 @@ extern CWaitableCriticalSection csBestBlock;
 extern CConditionVariable cvBlockChange;
 extern bool fImporting;
 extern bool fReindex;
+/** Whether mempool.dat was loaded at startup, so that it may be overwritten */
+extern std::atomic<bool> fMempoolLoaded;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fBlockFilterIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern unsigned int nCoinCacheSize;
@@ -220,6 +256,10 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto, bool fSendTrickle);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Build the filters of active chain blocks that have none yet, until the filter index reaches the tip */
+void ThreadBlockFilterIndex();
+/** Read the compact filter of a block and optionally its filter header, false if it is not indexed */
+bool GetBlockFilter(const CBlockIndex* pindex, CBlockFilter& filter, uint256* pHashHeader = NULL);
 
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
@@ -253,6 +293,15 @@ void FlushStateToDisk();
 /** (try to) add transaction to memory pool **/
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool ignoreFees = false);
 
+/** (try to) add transaction to memory pool with a specified acceptance time **/
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, int64_t nAcceptTime, bool fRejectInsaneFee = false, bool ignoreFees = false);
+
+/** Dump the mempool to mempool.dat in the data directory */
+bool DumpMempool();
+
+/** Load the mempool from mempool.dat, re-accepting each transaction */
+bool LoadMempool();
+
 bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool isDSTX = false);
 
 int GetInputAge(CTxIn& vin);
@@ -348,6 +397,8 @@ void UpdateCoins(const CTransaction& tx, CValidationState& state, CCoinsViewCach
 /** Context-independent validity checks */
 bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state);
 bool CheckZerocoinMint(const uint256& txHash, const CTxOut& txout, CValidationState& state, bool fCheckOnly = false);
+/** Verify the zerocoin spend proofs of tx and cache the result; called without cs_main */
+bool CheckZerocoinSpendProofs(const CTransaction& tx, CValidationState& state);
 bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state);
 bool ContextualCheckZerocoinSpend(const CTransaction& tx, const libzerocoin::CoinSpend& spend, CBlockIndex* pindex, const uint256& hashBlock);
 bool ContextualCheckZerocoinSpendNoSerialCheck(const CTransaction& tx, const libzerocoin::CoinSpend& spend, CBlockIndex* pindex, const uint256& hashBlock);
@@ -617,15 +668,28 @@ bool InvalidateBlock(CValidationState& state, CBlockIndex* pindex);
 /** Remove invalidity status from a block and its descendants. */
 bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex);
 
+/**
+ * Make pindexBase the active tip after its UTXO snapshot has been written to
+ * the coin and zerocoin databases. Its ancestors are treated as fully
+ * validated; they have no undo data, so the chain cannot be rewound below it.
+ */
+bool ActivateSnapshotChain(CValidationState& state, CBlockIndex* pindexBase);
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache* pcoinsTip;
 
+/** Global variable that points to the coin database below pcoinsTip (protected by cs_main) */
+extern CCoinsViewDB* pcoinsdbview;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB* pblocktree;
 
 /** Global variable that points to the zerocoin database (protected by cs_main) */
 extern CZerocoinDB* zerocoinDB;
 
+/** Global variable that points to the compact block filter index, NULL unless -blockfilterindex */
+extern CBlockFilterDB* pblockfilterdb;
+
 /** Global variable that points to the spork database (protected by cs_main) */
 extern CSporkDB* pSporkDB;
 
@@ -1398,6 +1398,32 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
     LogPrint("mnbudget", "CBudgetManager::Sync - sent %d items\n", nInvCount);
 }
 
+void CBudgetManager::GetSnapshot(CMasternodeSyncSnapshot& snapshot)
+{
+    LOCK(cs);
+
+    // the same objects Sync announces, each proposal or finalized budget followed by its votes
+    for (const std::pair<const uint256, CBudgetProposalBroadcast>& item : mapSeenMasternodeBudgetProposals) {
+        CBudgetProposal* pbudgetProposal = FindProposal(item.first);
+        if (!pbudgetProposal || !pbudgetProposal->fValid) continue;
+
+        snapshot.Add("mprop", item.second);
+        for (const std::pair<const uint256, CBudgetVote>& vote : pbudgetProposal->mapVotes) {
+            if (vote.second.fValid) snapshot.Add("mvote", vote.second);
+        }
+    }
+
+    for (const std::pair<const uint256, CFinalizedBudgetBroadcast>& item : mapSeenFinalizedBudgets) {
+        CFinalizedBudget* pfinalizedBudget = FindFinalizedBudget(item.first);
+        if (!pfinalizedBudget || !pfinalizedBudget->fValid) continue;
+
+        snapshot.Add("fbs", item.second);
+        for (const std::pair<const uint256, CFinalizedBudgetVote>& vote : pfinalizedBudget->mapVotes) {
+            if (vote.second.fValid) snapshot.Add("fbvote", vote.second);
+        }
+    }
+}
+
 bool CBudgetManager::UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string& strError)
 {
     LOCK(cs);
@@ -1459,6 +1485,7 @@ CBudgetProposal::CBudgetProposal()
     nAmount = 0;
     nTime = 0;
     fValid = true;
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strURLIn, int nBlockStartIn, int nBlockEndIn, CScript addressIn, CAmount nAmountIn, uint256 nFeeTXHashIn)
@@ -1471,6 +1498,7 @@ CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strU
     nAmount = nAmountIn;
     nFeeTXHash = nFeeTXHashIn;
     fValid = true;
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
@@ -1485,6 +1513,7 @@ CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
     nFeeTXHash = other.nFeeTXHash;
     mapVotes = other.mapVotes;
     fValid = true;
+    RecountVotes();
 }
 
 bool CBudgetProposal::IsValid(std::string& strError, bool fCheckCollateral)
@@ -1591,35 +1620,52 @@ bool CBudgetProposal::AddOrUpdateVote(CBudgetVote& vote, std::string& strError)
         return false;
     }
 
+    std::map<uint256, CBudgetVote>::iterator it = mapVotes.find(hash);
+    if (it != mapVotes.end())
+        CountVote(it->second, -1);
     mapVotes[hash] = vote;
+    CountVote(vote, 1);
     LogPrint("mnbudget", "CBudgetProposal::AddOrUpdateVote - %s %s\n", strAction.c_str(), vote.GetHash().ToString().c_str());
 
     return true;
 }
 
+void CBudgetProposal::CountVote(const CBudgetVote& vote, int nDelta)
+{
+    if (vote.nVote < VOTE_ABSTAIN || vote.nVote > VOTE_NO) return;
+    nVoteTally[vote.nVote][vote.fValid ? 1 : 0] += nDelta;
+}
+
+void CBudgetProposal::RecountVotes()
+{
+    LOCK(cs);
+
+    memset(nVoteTally, 0, sizeof(nVoteTally));
+    for (const std::pair<const uint256, CBudgetVote>& item : mapVotes)
+        CountVote(item.second, 1);
+}
+
 // If masternode voted for a proposal, but is now invalid -- remove the vote
 void CBudgetProposal::CleanAndRemove(bool fSignatureCheck)
 {
+    LOCK(cs);
+
     std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
 
     while (it != mapVotes.end()) {
+        CountVote((*it).second, -1);
         (*it).second.fValid = (*it).second.SignatureValid(fSignatureCheck);
+        CountVote((*it).second, 1);
         ++it;
     }
 }
 
 double CBudgetProposal::GetRatio()
 {
-    int yeas = 0;
-    int nays = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
+    LOCK(cs);
 
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES) yeas++;
-        if ((*it).second.nVote == VOTE_NO) nays++;
-        ++it;
-    }
+    int yeas = nVoteTally[VOTE_YES][0] + nVoteTally[VOTE_YES][1];
+    int nays = nVoteTally[VOTE_NO][0] + nVoteTally[VOTE_NO][1];
 
     if (yeas + nays == 0) return 0.0f;
 
@@ -1628,41 +1674,20 @@ double CBudgetProposal::GetRatio()
 
 int CBudgetProposal::GetYeas()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    LOCK(cs);
+    return nVoteTally[VOTE_YES][1];
 }
 
 int CBudgetProposal::GetNays()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_NO && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    LOCK(cs);
+    return nVoteTally[VOTE_NO][1];
 }
 
 int CBudgetProposal::GetAbstains()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_ABSTAIN && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    LOCK(cs);
+    return nVoteTally[VOTE_ABSTAIN][1];
 }
 
 int CBudgetProposal::GetBlockStartCycle()
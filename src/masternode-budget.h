@@ -29,6 +29,7 @@ class CFinalizedBudget;
 class CBudgetProposal;
 class CBudgetProposalBroadcast;
 class CTxBudgetPayment;
+class CMasternodeSyncSnapshot;
 
 #define VOTE_ABSTAIN 0
 #define VOTE_YES 1
@@ -224,6 +225,7 @@ public:
     void ResetSync();
     void MarkSynced();
     void Sync(CNode* node, uint256 nProp, bool fPartial = false);
+    void GetSnapshot(CMasternodeSyncSnapshot& snapshot);
 
     void Calculate();
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
@@ -469,6 +471,13 @@ private:
     mutable CCriticalSection cs;
     CAmount nAlloted;
 
+protected:
+    // running count of mapVotes by [nVote][fValid], so the getters don't walk the votes
+    int nVoteTally[3][2];
+
+    void CountVote(const CBudgetVote& vote, int nDelta);
+    void RecountVotes();
+
 public:
     bool fValid;
     std::string strProposalName;
@@ -560,6 +569,8 @@ public:
 
         //for saving to the serialized db
         READWRITE(mapVotes);
+        if (ser_action.ForRead())
+            RecountVotes();
     }
 };
 
@@ -588,6 +599,7 @@ public:
         swap(first.nTime, second.nTime);
         swap(first.nFeeTXHash, second.nFeeTXHash);
         first.mapVotes.swap(second.mapVotes);
+        swap(first.nVoteTally, second.nVoteTally);
     }
 
     CBudgetProposalBroadcast& operator=(CBudgetProposalBroadcast from)
@@ -941,6 +941,27 @@ void CMasternodePayments::Sync(CNode* node, int nCountNeeded)
     node->PushMessage("ssc", MASTERNODE_SYNC_MNW, nInvCount);
 }
 
+void CMasternodePayments::GetSnapshot(CMasternodeSyncSnapshot& snapshot)
+{
+    int nHeight;
+    {
+        LOCK(cs_main);
+        if (chainActive.Tip() == NULL) return;
+        nHeight = chainActive.Tip()->nHeight;
+    }
+
+    // same window Sync serves to a peer asking for every winner
+    int nCountNeeded = (mnodeman.CountEnabled() * 1.25);
+
+    LOCK(cs_mapMasternodePayeeVotes);
+
+    for (const std::pair<const uint256, CMasternodePaymentWinner>& item : mapMasternodePayeeVotes) {
+        const CMasternodePaymentWinner& winner = item.second;
+        if (winner.nBlockHeight >= nHeight - nCountNeeded && winner.nBlockHeight <= nHeight + 20)
+            snapshot.Add("mnw", winner);
+    }
+}
+
 std::string CMasternodePayments::ToString() const
 {
     std::ostringstream info;
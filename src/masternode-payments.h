@@ -22,6 +22,7 @@ extern CCriticalSection cs_mapMasternodePayeeVotes;
 class CMasternodePayments;
 class CMasternodePaymentWinner;
 class CMasternodeBlockPayees;
+class CMasternodeSyncSnapshot;
 
 extern CMasternodePayments masternodePayments;
 
@@ -325,6 +326,7 @@ public:
     bool ProcessBlock(int nBlockHeight);
 
     void Sync(CNode* node, int nCountNeeded);
+    void GetSnapshot(CMasternodeSyncSnapshot& snapshot);
     void CleanPaymentList();
     int LastPayment(CMasternode& mn);
 
@@ -16,11 +16,111 @@
 #include "spork.h"
 #include "util.h"
 #include "addrman.h"
+#include "hash.h"
 // clang-format on
 
 class CMasternodeSync;
 CMasternodeSync masternodeSync;
 
+CMasternodeSyncSnapshot::CMasternodeSyncSnapshot(int nItemIDIn) : ssChunk(SER_NETWORK, PROTOCOL_VERSION)
+{
+    nItemID = nItemIDIn;
+    nItems = 0;
+    nChunksReceived = 0;
+}
+
+void CMasternodeSyncSnapshot::CloseChunk()
+{
+    if (ssChunk.empty()) return;
+    vChunk.push_back(std::vector<unsigned char>(ssChunk.begin(), ssChunk.end()));
+    ssChunk.clear();
+}
+
+void CMasternodeSyncSnapshot::Finish()
+{
+    CloseChunk();
+    vChunkHash.clear();
+    for (const std::vector<unsigned char>& vchChunk : vChunk)
+        vChunkHash.push_back(Hash(vchChunk.begin(), vchChunk.end()));
+    nChunksReceived = vChunk.size();
+}
+
+bool CMasternodeSyncSnapshot::SetChunk(int nChunk, const std::vector<unsigned char>& vchData)
+{
+    if (nChunk < 0 || nChunk >= (int)vChunkHash.size() || !vChunk[nChunk].empty())
+        return false;
+    if (vchData.empty() || Hash(vchData.begin(), vchData.end()) != vChunkHash[nChunk])
+        return false;
+
+    vChunk[nChunk] = vchData;
+    nChunksReceived++;
+    return true;
+}
+
+void CMasternodeSyncSnapshot::Push(CNode* pnode) const
+{
+    pnode->PushMessage("mnsnaphdr", nItemID, nItems, vChunkHash);
+    for (unsigned int i = 0; i < vChunk.size(); i++)
+        pnode->PushMessage("mnsnap", nItemID, (int)i, vChunk[i]);
+}
+
+static bool IsSnapshotCommand(int nItemID, const std::string& strCommand)
+{
+    switch (nItemID) {
+    case (MASTERNODE_SYNC_LIST):
+        return strCommand == "mnb";
+    case (MASTERNODE_SYNC_MNW):
+        return strCommand == "mnw";
+    case (MASTERNODE_SYNC_BUDGET):
+        return strCommand == "mprop" || strCommand == "mvote" || strCommand == "fbs" || strCommand == "fbvote";
+    }
+    return false;
+}
+
+bool CMasternodeSyncSnapshot::Apply(CNode* pfrom) const
+{
+    // decode and check the whole snapshot before handing any item over
+    std::vector<std::pair<std::string, std::vector<unsigned char> > > vItems;
+    try {
+        for (const std::vector<unsigned char>& vchChunk : vChunk) {
+            CDataStream ss(vchChunk, SER_NETWORK, PROTOCOL_VERSION);
+            while (!ss.empty()) {
+                std::pair<std::string, std::vector<unsigned char> > item;
+                ss >> item.first >> item.second;
+                if (!IsSnapshotCommand(nItemID, item.first))
+                    return error("CMasternodeSyncSnapshot::Apply - unexpected command %s in snapshot %d", SanitizeString(item.first), nItemID);
+                vItems.push_back(item);
+            }
+        }
+    } catch (const std::exception& e) {
+        return error("CMasternodeSyncSnapshot::Apply - malformed snapshot %d: %s", nItemID, e.what());
+    }
+
+    if ((int)vItems.size() != nItems)
+        return error("CMasternodeSyncSnapshot::Apply - snapshot %d has %u items, header announced %d", nItemID, vItems.size(), nItems);
+
+    // a synced peer always knows some masternodes, it resyncs when it loses them all
+    if (nItemID == MASTERNODE_SYNC_LIST && nItems == 0)
+        return error("CMasternodeSyncSnapshot::Apply - empty masternode list snapshot");
+
+    // every item is checked by the handler of its per-item message
+    for (std::pair<std::string, std::vector<unsigned char> >& item : vItems) {
+        CDataStream ssItem(item.second, SER_NETWORK, PROTOCOL_VERSION);
+        try {
+            if (nItemID == MASTERNODE_SYNC_LIST)
+                mnodeman.ProcessMessage(pfrom, item.first, ssItem);
+            else if (nItemID == MASTERNODE_SYNC_MNW)
+                masternodePayments.ProcessMessageMasternodePayments(pfrom, item.first, ssItem);
+            else
+                budget.ProcessMessage(pfrom, item.first, ssItem);
+        } catch (const std::exception& e) {
+            return error("CMasternodeSyncSnapshot::Apply - malformed %s in snapshot %d: %s", SanitizeString(item.first), nItemID, e.what());
+        }
+    }
+
+    return true;
+}
+
 CMasternodeSync::CMasternodeSync()
 {
     Reset();
@@ -83,6 +183,13 @@ void CMasternodeSync::Reset()
     RequestedMasternodeAssets = MASTERNODE_SYNC_INITIAL;
     RequestedMasternodeAttempt = 0;
     nAssetSyncStarted = GetTime();
+
+    LOCK(cs);
+    nSnapshotNode = -1;
+    nSnapshotItemID = MASTERNODE_SYNC_INITIAL;
+    fSnapshotDone = false;
+    nSnapshotRequested = 0;
+    snapshot = CMasternodeSyncSnapshot();
 }
 
 void CMasternodeSync::AddedMasternodeList(uint256 hash)
@@ -182,8 +289,169 @@ std::string CMasternodeSync::GetSyncStatus()
     return "";
 }
 
+void CMasternodeSync::SnapshotDone()
+{
+    AssertLockHeld(cs);
+
+    // the per-item requests take over, with the usual time to complete them
+    fSnapshotDone = true;
+    nSnapshotNode = -1;
+    snapshot = CMasternodeSyncSnapshot();
+    nAssetSyncStarted = GetTime();
+}
+
+// Ask a peer serving NODE_MNSNAPSHOT for the current asset, true while that snapshot is pending
+bool CMasternodeSync::RequestSnapshot()
+{
+    AssertLockHeld(cs_vNodes);
+    LOCK(cs);
+
+    if (nSnapshotItemID != RequestedMasternodeAssets) {
+        nSnapshotItemID = RequestedMasternodeAssets;
+        nSnapshotNode = -1;
+        fSnapshotDone = false;
+        snapshot = CMasternodeSyncSnapshot();
+    }
+
+    if (fSnapshotDone) return false;
+
+    if (nSnapshotNode != -1) {
+        if (GetTime() - nSnapshotRequested <= MASTERNODE_SYNC_SNAPSHOT_TIMEOUT) return true;
+
+        LogPrint("masternode", "CMasternodeSync::RequestSnapshot - snapshot %d from peer %d timed out\n", nSnapshotItemID, nSnapshotNode);
+        SnapshotDone();
+        return false;
+    }
+
+    int nMinProto = nSnapshotItemID == MASTERNODE_SYNC_BUDGET ? ActiveProtocol() : masternodePayments.GetMinMasternodePaymentsProto();
+    BOOST_FOREACH (CNode* pnode, vNodes) {
+        if (pnode->fDisconnect || !(pnode->nServices & NODE_MNSNAPSHOT) || pnode->nVersion < nMinProto) continue;
+
+        LogPrint("masternode", "CMasternodeSync::RequestSnapshot - asking peer %d for snapshot %d\n", pnode->GetId(), nSnapshotItemID);
+        pnode->PushMessage("mnsnapget", nSnapshotItemID);
+        nSnapshotNode = pnode->GetId();
+        nSnapshotRequested = GetTime();
+        return true;
+    }
+
+    // nobody serves snapshots, sync item by item
+    fSnapshotDone = true;
+    return false;
+}
+
+void CMasternodeSync::ProcessSnapshotMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
+{
+    if (strCommand == "mnsnapget") { //Masternode asset snapshot request
+        int nItemID;
+        vRecv >> nItemID;
+
+        if (fLiteMode || !(nLocalServices & NODE_MNSNAPSHOT)) return;
+        if (nItemID != MASTERNODE_SYNC_LIST && nItemID != MASTERNODE_SYNC_MNW && nItemID != MASTERNODE_SYNC_BUDGET) {
+            Misbehaving(pfrom->GetId(), 10);
+            return;
+        }
+
+        std::string strRequest = strprintf("mnsnapget%d", nItemID);
+        if (Params().NetworkID() == CBaseChainParams::MAIN) {
+            if (pfrom->HasFulfilledRequest(strRequest)) {
+                LogPrintf("CMasternodeSync::ProcessMessage() : mnsnapget - peer already asked me for snapshot %d\n", nItemID);
+                Misbehaving(pfrom->GetId(), 20);
+                return;
+            }
+        }
+        pfrom->FulfilledRequest(strRequest);
+
+        // only a synced node has a snapshot worth serving, otherwise tell the peer to sync item by item
+        CMasternodeSyncSnapshot snapshotOut(nItemID);
+        if (!IsSynced()) {
+            snapshotOut.nItems = -1;
+        } else if (nItemID == MASTERNODE_SYNC_LIST) {
+            mnodeman.GetSnapshot(snapshotOut);
+        } else if (nItemID == MASTERNODE_SYNC_MNW) {
+            masternodePayments.GetSnapshot(snapshotOut);
+        } else {
+            budget.GetSnapshot(snapshotOut);
+        }
+        snapshotOut.Finish();
+        snapshotOut.Push(pfrom);
+
+        LogPrint("masternode", "mnsnapget - Sent snapshot %d, %d items in %u chunks to peer %i\n", nItemID, snapshotOut.nItems, snapshotOut.vChunk.size(), pfrom->GetId());
+        return;
+    }
+
+    CMasternodeSyncSnapshot snapshotComplete;
+
+    if (strCommand == "mnsnaphdr") { //Masternode asset snapshot header
+        int nItemID;
+        int nItems;
+        std::vector<uint256> vChunkHash;
+        vRecv >> nItemID >> nItems >> vChunkHash;
+
+        LOCK(cs);
+        if (pfrom->GetId() != nSnapshotNode || nItemID != nSnapshotItemID || snapshot.nItemID == nItemID) return;
+
+        if (nItems < 0) {
+            LogPrint("masternode", "mnsnaphdr - peer %d can't serve snapshot %d\n", pfrom->GetId(), nItemID);
+            SnapshotDone();
+            return;
+        }
+        if (vChunkHash.size() > MASTERNODE_SNAPSHOT_MAX_CHUNKS || (vChunkHash.empty() && nItems != 0)) {
+            LogPrintf("CMasternodeSync::ProcessMessage() : mnsnaphdr - invalid snapshot %d header from peer %d\n", nItemID, pfrom->GetId());
+            Misbehaving(pfrom->GetId(), 20);
+            SnapshotDone();
+            return;
+        }
+
+        snapshot = CMasternodeSyncSnapshot(nItemID);
+        snapshot.nItems = nItems;
+        snapshot.vChunkHash = vChunkHash;
+        snapshot.vChunk.resize(vChunkHash.size());
+        nSnapshotRequested = GetTime();
+        if (!snapshot.IsComplete()) return;
+
+        snapshotComplete = snapshot;
+    } else if (strCommand == "mnsnap") { //Masternode asset snapshot chunk
+        int nItemID;
+        int nChunk;
+        std::vector<unsigned char> vchData;
+        vRecv >> nItemID >> nChunk >> vchData;
+
+        LOCK(cs);
+        if (pfrom->GetId() != nSnapshotNode || nItemID != nSnapshotItemID || snapshot.nItemID != nItemID) return;
+
+        if (!snapshot.SetChunk(nChunk, vchData)) {
+            LogPrintf("CMasternodeSync::ProcessMessage() : mnsnap - chunk %d of snapshot %d from peer %d doesn't match its header\n", nChunk, nItemID, pfrom->GetId());
+            Misbehaving(pfrom->GetId(), 20);
+            SnapshotDone();
+            return;
+        }
+        nSnapshotRequested = GetTime();
+        if (!snapshot.IsComplete()) return;
+
+        snapshotComplete = snapshot;
+    } else {
+        return;
+    }
+
+    // the snapshot stays pending until it is applied, so it isn't asked for again meanwhile
+    bool fApplied = snapshotComplete.Apply(pfrom);
+    if (!fApplied) Misbehaving(pfrom->GetId(), 20);
+
+    // A snapshot is only a first pass over the asset. The asset completes the
+    // way it does without one, after the per-item requests to other peers, so
+    // a single peer can't leave out items or finish the asset on its own.
+    LOCK(cs);
+    if (snapshotComplete.nItemID != nSnapshotItemID || pfrom->GetId() != nSnapshotNode) return;
+    SnapshotDone();
+
+    if (fApplied)
+        LogPrint("masternode", "CMasternodeSync::ProcessMessage - applied snapshot %d with %d items from peer %d\n", snapshotComplete.nItemID, snapshotComplete.nItems, pfrom->GetId());
+}
+
 void CMasternodeSync::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 {
+    ProcessSnapshotMessage(pfrom, strCommand, vRecv);
+
     if (strCommand == "ssc") { //Sync status count
         int nItemID;
         int nCount;
@@ -266,6 +534,11 @@ void CMasternodeSync::Process()
     TRY_LOCK(cs_vNodes, lockRecv);
     if (!lockRecv) return;
 
+    // fetch the whole list, winners or budget from a single peer when one serves snapshots
+    if (Params().NetworkID() != CBaseChainParams::REGTEST &&
+        RequestedMasternodeAssets >= MASTERNODE_SYNC_LIST && RequestedMasternodeAssets <= MASTERNODE_SYNC_BUDGET &&
+        RequestSnapshot()) return;
+
     BOOST_FOREACH (CNode* pnode, vNodes) {
         if (Params().NetworkID() == CBaseChainParams::REGTEST) {
             if (RequestedMasternodeAttempt <= 2) {
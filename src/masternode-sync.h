@@ -8,6 +8,14 @@
 #ifndef MASTERNODE_SYNC_H
 #define MASTERNODE_SYNC_H
 
+#include "net.h"
+#include "streams.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <string>
+#include <vector>
+
 #define MASTERNODE_SYNC_INITIAL 0
 #define MASTERNODE_SYNC_SPORKS 1
 #define MASTERNODE_SYNC_LIST 2
@@ -21,15 +29,90 @@
 #define MASTERNODE_SYNC_TIMEOUT 5
 #define MASTERNODE_SYNC_THRESHOLD 2
 
+// seconds to wait for a requested snapshot before falling back to per-item sync
+#define MASTERNODE_SYNC_SNAPSHOT_TIMEOUT 30
+// serialized size at which a snapshot chunk is closed, well below MAX_PROTOCOL_MESSAGE_LENGTH
+#define MASTERNODE_SNAPSHOT_CHUNK_SIZE (512 * 1024)
+// largest snapshot a peer may announce, in chunks
+#define MASTERNODE_SNAPSHOT_MAX_CHUNKS 128
+
+/** Default for -peermnsnapshots, serve masternode list, winner and budget snapshots to peers */
+static const bool DEFAULT_PEERMNSNAPSHOTS = true;
+
 class CMasternodeSync;
 extern CMasternodeSync masternodeSync;
 
+//
+// CMasternodeSyncSnapshot : All items of one sync asset (list, winners or budget), batched into chunks
+//
+// A peer advertising NODE_MNSNAPSHOT answers "mnsnapget" with a "mnsnaphdr" committing to the hash of
+// every chunk, followed by one "mnsnap" message per chunk. A chunk holds (command, payload) pairs, the
+// payload being what the per-item message of that command would carry. Nothing is applied until every
+// chunk has arrived and matched its hash, then each item goes through the usual per-item handler.
+// The per-item requests still run afterwards, the snapshot only saves them most of the items.
+//
+
+class CMasternodeSyncSnapshot
+{
+private:
+    CDataStream ssChunk;
+
+    void CloseChunk();
+
+public:
+    int nItemID;
+    int nItems;
+    std::vector<uint256> vChunkHash;
+    std::vector<std::vector<unsigned char> > vChunk;
+    int nChunksReceived;
+
+    CMasternodeSyncSnapshot(int nItemIDIn = MASTERNODE_SYNC_INITIAL);
+
+    template <typename T>
+    void Add(const std::string& strCommand, const T& obj)
+    {
+        CDataStream ssItem(SER_NETWORK, PROTOCOL_VERSION);
+        ssItem << obj;
+        ssChunk << strCommand << std::vector<unsigned char>(ssItem.begin(), ssItem.end());
+        nItems++;
+        if (ssChunk.size() >= MASTERNODE_SNAPSHOT_CHUNK_SIZE)
+            CloseChunk();
+    }
+
+    /// Close the last chunk and compute the chunk hashes once all items are added
+    void Finish();
+
+    /// Store a received chunk, false if it is out of range, a duplicate or doesn't match its hash
+    bool SetChunk(int nChunk, const std::vector<unsigned char>& vchData);
+    bool IsComplete() const { return nChunksReceived == (int)vChunkHash.size(); }
+
+    void Push(CNode* pnode) const;
+    /// Hand every item to its per-item handler, false if the snapshot is malformed, doesn't match its header or is an empty masternode list
+    bool Apply(CNode* pfrom) const;
+};
+
 //
 // CMasternodeSync : Sync masternode assets in stages
 //
 
 class CMasternodeSync
 {
+private:
+    // protects the snapshot being received, which is touched by both Process and ProcessMessage
+    mutable CCriticalSection cs;
+
+    // node we asked for a snapshot of the current asset, -1 if none
+    NodeId nSnapshotNode;
+    // asset the snapshot was asked for and whether it was applied or has failed, then per-item sync is used
+    int nSnapshotItemID;
+    bool fSnapshotDone;
+    int64_t nSnapshotRequested;
+    CMasternodeSyncSnapshot snapshot;
+
+    bool RequestSnapshot();
+    void SnapshotDone();
+    void ProcessSnapshotMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+
 public:
     std::map<uint256, int> mapSeenSyncMNB;
     std::map<uint256, int> mapSeenSyncMNW;
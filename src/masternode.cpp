@@ -80,6 +80,8 @@ CMasternode::CMasternode()
     nScanningErrorCount = 0;
     nLastScanningErrorBlockHeight = 0;
     lastTimeChecked = 0;
+    nCollateralAmount = 0;
+    hashCollateralBlock = 0;
 }
 
 CMasternode::CMasternode(const CMasternode& other)
@@ -103,6 +105,8 @@ CMasternode::CMasternode(const CMasternode& other)
     nScanningErrorCount = other.nScanningErrorCount;
     nLastScanningErrorBlockHeight = other.nLastScanningErrorBlockHeight;
     lastTimeChecked = 0;
+    nCollateralAmount = other.nCollateralAmount;
+    hashCollateralBlock = other.hashCollateralBlock;
 }
 
 CMasternode::CMasternode(const CMasternodeBroadcast& mnb)
@@ -126,19 +130,26 @@ CMasternode::CMasternode(const CMasternodeBroadcast& mnb)
     nScanningErrorCount = 0;
     nLastScanningErrorBlockHeight = 0;
     lastTimeChecked = 0;
+    nCollateralAmount = 0;
+    hashCollateralBlock = 0;
 }
 
 unsigned int CMasternode::GetPhase (unsigned int atBlockHeight) {
-    CTransaction prevTx;
-    uint256 hashBlock = 0;
-    
-    if (!GetTransaction (vin.prevout.hash, prevTx, hashBlock, true))
-        return 0;
-    
-    if (vin.prevout.n >= prevTx.vout.size ())
-        return 0;
+    // the collateral of a vin never changes, only read its transaction once
+    if (nCollateralAmount == 0) {
+        CTransaction prevTx;
+        uint256 hashBlock = 0;
+        
+        if (!GetTransaction (vin.prevout.hash, prevTx, hashBlock, true))
+            return 0;
+        
+        if (vin.prevout.n >= prevTx.vout.size ())
+            return 0;
+        
+        nCollateralAmount = prevTx.vout [vin.prevout.n].nValue;
+    }
     
-    return Params ().getMasternodePhase (prevTx.vout [vin.prevout.n].nValue, atBlockHeight);
+    return Params ().getMasternodePhase (nCollateralAmount, atBlockHeight);
 }
 
 //
@@ -227,13 +238,19 @@ void CMasternode::Check(bool forceCheck)
         if (!lockMain)
             return;
         
-        CCoinsViewCache cache (pcoinsTip);
-        const CCoins* coins = cache.AccessCoins (vin.prevout.hash);
-        
-        if (!coins || !coins->IsAvailable (vin.prevout.n) || !Params ().isMasternodeCollateral (coins->vout [vin.prevout.n].nValue)) {
-            activeState = MASTERNODE_VIN_SPENT;
+        // the collateral can only have been spent by a block connected since it was last looked up
+        uint256 hashBestBlock = pcoinsTip->GetBestBlock ();
+        if (hashCollateralBlock != hashBestBlock) {
+            const CCoins* coins = pcoinsTip->AccessCoins (vin.prevout.hash);
             
-            return;
+            if (!coins || !coins->IsAvailable (vin.prevout.n) || !Params ().isMasternodeCollateral (coins->vout [vin.prevout.n].nValue)) {
+                activeState = MASTERNODE_VIN_SPENT;
+                
+                return;
+            }
+            
+            nCollateralAmount = coins->vout [vin.prevout.n].nValue;
+            hashCollateralBlock = hashBestBlock;
         }
     }
 
@@ -145,6 +145,10 @@ public:
     int nScanningErrorCount;
     int nLastScanningErrorBlockHeight;
     CMasternodePing lastPing;
+    // value of the collateral, 0 until it has been looked up
+    CAmount nCollateralAmount;
+    // tip the collateral was last found unspent at, Check doesn't look it up again until the tip moves
+    uint256 hashCollateralBlock;
 
     CMasternode();
     CMasternode(const CMasternode& other);
@@ -175,6 +179,8 @@ public:
         swap(first.nLastDsq, second.nLastDsq);
         swap(first.nScanningErrorCount, second.nScanningErrorCount);
         swap(first.nLastScanningErrorBlockHeight, second.nLastScanningErrorBlockHeight);
+        swap(first.nCollateralAmount, second.nCollateralAmount);
+        swap(first.hashCollateralBlock, second.hashCollateralBlock);
     }
 
     CMasternode& operator=(CMasternode from)
@@ -216,6 +222,8 @@ public:
         READWRITE(nLastDsq);
         READWRITE(nScanningErrorCount);
         READWRITE(nLastScanningErrorBlockHeight);
+        READWRITE(nCollateralAmount);
+        READWRITE(hashCollateralBlock);
     }
 
     int64_t SecondsSincePayment();
@@ -8,6 +8,7 @@
 #include "masternodeman.h"
 #include "activemasternode.h"
 #include "addrman.h"
+#include "masternode-sync.h"
 #include "masternode.h"
 #include "obfuscation.h"
 #include "spork.h"
@@ -61,6 +62,7 @@ bool CMasternodeDB::Write(const CMasternodeMan& mnodemanToSave)
     CDataStream ssMasternodes(SER_DISK, CLIENT_VERSION);
     ssMasternodes << strMagicMessage;                   // masternode cache file specific magic message
     ssMasternodes << FLATDATA(Params().MessageStart()); // network specific magic number
+    ssMasternodes << (int)MASTERNODE_CACHE_VERSION;     // masternode cache format
     ssMasternodes << mnodemanToSave;
     uint256 hash = Hash(ssMasternodes.begin(), ssMasternodes.end());
     ssMasternodes << hash;
@@ -147,6 +149,15 @@ CMasternodeDB::ReadResult CMasternodeDB::Read(CMasternodeMan& mnodemanToLoad, bo
             error("%s : Invalid network magic number", __func__);
             return IncorrectMagicNumber;
         }
+
+        // de-serialize the cache format, older files don't have the collateral state of the entries
+        int nVersion;
+        ssMasternodes >> nVersion;
+        if (nVersion != MASTERNODE_CACHE_VERSION) {
+            error("%s : Unsupported masternode cache version %d", __func__, nVersion);
+            return IncorrectFormat;
+        }
+
         // de-serialize data into CMasternodeMan object
         ssMasternodes >> mnodemanToLoad;
     } catch (std::exception& e) {
@@ -197,6 +208,7 @@ void DumpMasternodes()
 CMasternodeMan::CMasternodeMan()
 {
     nDsqCount = 0;
+    nEnabledCountCacheTime = 0;
 }
 
 bool CMasternodeMan::Add(CMasternode& mn)
@@ -210,6 +222,7 @@ bool CMasternodeMan::Add(CMasternode& mn)
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        InvalidateEnabledCount();
         return true;
     }
 
@@ -236,6 +249,9 @@ void CMasternodeMan::Check()
 {
     LOCK(cs);
 
+    // check the whole list under a single cs_main lock, rather than taking it per Masternode
+    TRY_LOCK(cs_main, lockMain);
+
     for (CMasternode& mn : vMasternodes) {
         mn.Check();
     }
@@ -248,6 +264,7 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
     LOCK(cs);
 
     //remove inactive and outdated
+    std::set<COutPoint> setRemoved;
     vector<CMasternode>::iterator it = vMasternodes.begin();
     while (it != vMasternodes.end()) {
         if ((*it).activeState == CMasternode::MASTERNODE_REMOVE ||
@@ -256,35 +273,34 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
             (*it).protocolVersion < masternodePayments.GetMinMasternodePaymentsProto()) {
             LogPrint("masternode", "CMasternodeMan: Removing inactive Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
 
-            //erase all of the broadcasts we've seen from this vin
-            // -- if we missed a few pings and the node was removed, this will allow is to get it back without them
-            //    sending a brand new mnb
-            map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
-            while (it3 != mapSeenMasternodeBroadcast.end()) {
-                if ((*it3).second.vin == (*it).vin) {
-                    masternodeSync.mapSeenSyncMNB.erase((*it3).first);
-                    mapSeenMasternodeBroadcast.erase(it3++);
-                } else {
-                    ++it3;
-                }
-            }
-
-            // allow us to ask for this masternode again if we see another ping
-            map<COutPoint, int64_t>::iterator it2 = mWeAskedForMasternodeListEntry.begin();
-            while (it2 != mWeAskedForMasternodeListEntry.end()) {
-                if ((*it2).first == (*it).vin.prevout) {
-                    mWeAskedForMasternodeListEntry.erase(it2++);
-                } else {
-                    ++it2;
-                }
-            }
-
+            setRemoved.insert((*it).vin.prevout);
             it = vMasternodes.erase(it);
         } else {
             ++it;
         }
     }
 
+    if (!setRemoved.empty()) {
+        InvalidateEnabledCount();
+
+        //erase all of the broadcasts we've seen from the removed vins
+        // -- if we missed a few pings and the node was removed, this will allow is to get it back without them
+        //    sending a brand new mnb
+        map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
+        while (it3 != mapSeenMasternodeBroadcast.end()) {
+            if (setRemoved.count((*it3).second.vin.prevout)) {
+                masternodeSync.mapSeenSyncMNB.erase((*it3).first);
+                mapSeenMasternodeBroadcast.erase(it3++);
+            } else {
+                ++it3;
+            }
+        }
+
+        // allow us to ask for these masternodes again if we see another ping
+        for (const COutPoint& prevout : setRemoved)
+            mWeAskedForMasternodeListEntry.erase(prevout);
+    }
+
     // check who's asked for the Masternode list
     map<CNetAddr, int64_t>::iterator it1 = mAskedUsForMasternodeList.begin();
     while (it1 != mAskedUsForMasternodeList.end()) {
@@ -341,6 +357,7 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     vMasternodes.clear();
+    InvalidateEnabledCount();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -387,9 +404,23 @@ int CMasternodeMan::CountEnabled (int protocolVersion) {
 }
 
 int CMasternodeMan::CountEnabledOnLevel (unsigned int mnLevel, int protocolVersion) {
-    int masternodeCount = 0;
-    
+    LOCK(cs);
+
     protocolVersion = (protocolVersion == -1 ? masternodePayments.GetMinMasternodePaymentsProto () : protocolVersion);
+
+    // Budget thresholds ask for this count once per proposal, only walk the list
+    // again once the entries could have changed state in CMasternode::Check
+    if (GetTime() - nEnabledCountCacheTime >= MASTERNODE_CHECK_SECONDS) {
+        mapEnabledCountCache.clear();
+        nEnabledCountCacheTime = GetTime();
+    }
+
+    std::pair<unsigned int, int> key = std::make_pair(mnLevel, protocolVersion);
+    std::map<std::pair<unsigned int, int>, int>::const_iterator it = mapEnabledCountCache.find(key);
+    if (it != mapEnabledCountCache.end())
+        return it->second;
+
+    int masternodeCount = 0;
     
     for (CMasternode& mn : vMasternodes) {
         mn.Check ();
@@ -402,6 +433,7 @@ int CMasternodeMan::CountEnabledOnLevel (unsigned int mnLevel, int protocolVersi
         masternodeCount++;
     }
 
+    mapEnabledCountCache[key] = masternodeCount;
     return masternodeCount;
 }
 
@@ -457,6 +489,22 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
     mWeAskedForMasternodeList[pnode->addr] = askAgain;
 }
 
+void CMasternodeMan::GetSnapshot(CMasternodeSyncSnapshot& snapshot)
+{
+    LOCK(cs);
+
+    for (CMasternode& mn : vMasternodes) {
+        if (mn.addr.IsRFC1918()) continue; //local network
+        if (!mn.IsEnabled()) continue;
+
+        CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
+        uint256 hash = mnb.GetHash();
+        if (!mapSeenMasternodeBroadcast.count(hash)) mapSeenMasternodeBroadcast.insert(make_pair(hash, mnb));
+
+        snapshot.Add("mnb", mnb);
+    }
+}
+
 CMasternode* CMasternodeMan::Find(const CScript& payee)
 {
     LOCK(cs);
@@ -687,6 +735,7 @@ std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t
     uint256 hash = 0;
     if (!GetBlockHash(hash, nBlockHeight)) return vecMasternodeRanks;
 
+    LOCK(cs);
     // scan for winner
     for (CMasternode& mn : vMasternodes) {
         mn.Check();
@@ -900,6 +949,7 @@ void CMasternodeMan::Remove(CTxIn vin)
         if ((*it).vin == vin) {
             LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
             vMasternodes.erase(it);
+            InvalidateEnabledCount();
             break;
         }
         ++it;
@@ -919,7 +969,9 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
         CMasternode mn(mnb);
         Add(mn);
     } else {
-    	pmn->UpdateFromNewBroadcast(mnb);
+        LOCK(cs);
+        if (pmn->UpdateFromNewBroadcast(mnb))
+            InvalidateEnabledCount();
     }
 }
 
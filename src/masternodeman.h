@@ -18,10 +18,13 @@
 
 #define MASTERNODES_DUMP_SECONDS (15 * 60)
 #define MASTERNODES_DSEG_SECONDS (3 * 60 * 60)
+// format of mncache.dat, files of another version are dropped and recreated
+#define MASTERNODE_CACHE_VERSION 1
 
 using namespace std;
 
 class CMasternodeMan;
+class CMasternodeSyncSnapshot;
 
 extern CMasternodeMan mnodeman;
 void DumpMasternodes();
@@ -68,6 +71,13 @@ private:
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
 
+    // enabled Masternode counts by (level, protocol version), dropped whenever the list changes
+    std::map<std::pair<unsigned int, int>, int> mapEnabledCountCache;
+    // when mapEnabledCountCache was started, it is refreshed at the pace of CMasternode::Check
+    int64_t nEnabledCountCacheTime;
+
+    void InvalidateEnabledCount() { mapEnabledCountCache.clear(); }
+
 public:
     // Keep track of all broadcasts I've seen
     map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
@@ -91,6 +101,8 @@ public:
 
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
+        if (ser_action.ForRead())
+            InvalidateEnabledCount();
     }
 
     CMasternodeMan();
@@ -119,6 +131,9 @@ public:
 
     void DsegUpdate(CNode* pnode);
 
+    /// Add the broadcast of every enabled Masternode to a sync snapshot, as dseg would announce them
+    void GetSnapshot(CMasternodeSyncSnapshot& snapshot);
+
     /// Find an entry
     CMasternode* Find(const CScript& payee);
     CMasternode* Find(const CTxIn& vin);
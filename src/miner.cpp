@@ -33,7 +33,6 @@
 
 
 #include <boost/thread.hpp>
-#include <boost/tuple/tuple.hpp>
 
 using namespace std;
 
@@ -43,53 +42,247 @@ using namespace std;
 //
 
 //
-// Unconfirmed transactions in the memory pool often depend on other
-// transactions in the memory pool. When we select transactions from the
-// pool, we select by highest priority or fee rate, so we might consider
-// transactions that depend on transactions that aren't yet in the block.
-// The COrphan class keeps track of these 'temporary orphans' while
-// CreateBlock is figuring out which transactions to include.
+// Collects mempool transactions into a block template. Every transaction is
+// checked against the UTXO view as updated by the transactions before it, so
+// a transaction has to come after its in-mempool parents.
 //
-class COrphan
+class CBlockTxCollector
 {
-public:
-	const CTransaction* ptx;
-	set<uint256> setDependsOn;
-	CFeeRate feeRate;
-	double dPriority;
+private:
+	CBlockTemplate* pblocktemplate;
+	CCoinsViewCache& view;
+	const int nHeight;
+	const unsigned int nBlockMaxSize;
+	vector<CBigNum> vBlockSerials;
 
-	COrphan(const CTransaction* ptxIn) : ptx(ptxIn), feeRate(0), dPriority(0)
+public:
+	uint64_t nBlockSize;
+	uint64_t nBlockTx;
+	int nBlockSigOps;
+	CAmount nFees;
+	set<uint256> setInBlock;
+
+	CBlockTxCollector(CBlockTemplate* pblocktemplateIn, CCoinsViewCache& viewIn, int nHeightIn, unsigned int nBlockMaxSizeIn) :
+		pblocktemplate(pblocktemplateIn), view(viewIn), nHeight(nHeightIn), nBlockMaxSize(nBlockMaxSizeIn),
+		nBlockSize(1000), nBlockTx(0), nBlockSigOps(100), nFees(0)
 	{
 	}
+
+	/** Add tx to the block if it is valid on top of the transactions before it */
+	bool TryAdd(const CTransaction& tx) { return AddTx(tx, view); }
+
+	/** Add the transactions, parents first, all of them or none */
+	bool TryAddPackage(const vector<const CTransaction*>& vPackage);
+
+private:
+	bool AddTx(const CTransaction& tx, CCoinsViewCache& viewTx);
 };
 
-uint64_t nLastBlockTx = 0;
-uint64_t nLastBlockSize = 0;
-int64_t nLastCoinStakeSearchInterval = 0;
+// Nothing is changed before all the checks pass, so a single transaction is
+// either added or left out as a whole
+bool CBlockTxCollector::AddTx(const CTransaction& tx, CCoinsViewCache& viewTx)
+{
+	if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight))
+		return false;
+	if (GetAdjustedTime() > GetSporkValue(SPORK_16_ZEROCOIN_MAINTENANCE_MODE) && tx.ContainsZerocoins())
+		return false;
+
+	// Size limits
+	unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+	if (nBlockSize + nTxSize >= nBlockMaxSize)
+		return false;
+
+	// Legacy limits on sigOps:
+	unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
+	unsigned int nTxSigOps = GetLegacySigOpCount(tx);
+	if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
+		return false;
+
+	if (!tx.IsZerocoinSpend()) {
+		//Check for invalid/fraudulent inputs. They shouldn't make it through mempool, but check anyways.
+		for (const CTxIn& txin : tx.vin) {
+			if (invalid_out::ContainsOutPoint(txin.prevout)) {
+				LogPrintf("%s : found invalid input %s in tx %s", __func__, txin.prevout.ToString(), tx.GetHash().ToString());
+				return false;
+			}
+		}
+	}
+
+	if (!viewTx.HaveInputs(tx))
+		return false;
+
+	// double check that there are no double spent zleno spends in this block or tx
+	vector<CBigNum> vTxSerials;
+	if (tx.IsZerocoinSpend()) {
+		int nHeightTx = 0;
+		if (IsTransactionInChain(tx.GetHash(), nHeightTx))
+			return false;
+
+		for (const CTxIn& txIn : tx.vin) {
+			if (txIn.scriptSig.IsZerocoinSpend()) {
+				libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txIn);
+				bool fUseV1Params = libzerocoin::ExtractVersionFromSerial(spend.getCoinSerialNumber()) < libzerocoin::PrivateCoin::PUBKEY_VERSION;
+				//This zleno serial has already been included in the block, do not add this tx.
+				if (!spend.HasValidSerial(Params().Zerocoin_Params(fUseV1Params)))
+					return false;
+				if (count(vBlockSerials.begin(), vBlockSerials.end(), spend.getCoinSerialNumber()))
+					return false;
+				if (count(vTxSerials.begin(), vTxSerials.end(), spend.getCoinSerialNumber()))
+					return false;
+				vTxSerials.emplace_back(spend.getCoinSerialNumber());
+			}
+		}
+	}
+
+	CAmount nTxFees = viewTx.GetValueIn(tx) - tx.GetValueOut();
+
+	nTxSigOps += GetP2SHSigOpCount(tx, viewTx);
+	if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
+		return false;
+
+	// Note that flags: we don't want to set mempool/IsStandard()
+	// policy here, but we still have to ensure that the block we
+	// create only contains transactions that are valid in new blocks.
+	CValidationState state;
+	if (!CheckInputs(tx, state, viewTx, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
+		return false;
+
+	CTxUndo txundo;
+	UpdateCoins(tx, state, viewTx, txundo, nHeight);
+
+	// Added
+	pblocktemplate->block.vtx.push_back(tx);
+	pblocktemplate->vTxFees.push_back(nTxFees);
+	pblocktemplate->vTxSigOps.push_back(nTxSigOps);
+	nBlockSize += nTxSize;
+	++nBlockTx;
+	nBlockSigOps += nTxSigOps;
+	nFees += nTxFees;
+	setInBlock.insert(tx.GetHash());
+
+	for (const CBigNum& bnSerial : vTxSerials)
+		vBlockSerials.emplace_back(bnSerial);
+
+	return true;
+}
+
+bool CBlockTxCollector::TryAddPackage(const vector<const CTransaction*>& vPackage)
+{
+	// The package is added on top of a view of its own, which only goes into
+	// the block's view once every transaction is in
+	CCoinsViewCache viewPackage(&view);
+	const size_t nTemplateTx = pblocktemplate->block.vtx.size();
+	const size_t nBlockSerials = vBlockSerials.size();
+	const uint64_t nBlockSizeBefore = nBlockSize;
+	const uint64_t nBlockTxBefore = nBlockTx;
+	const int nBlockSigOpsBefore = nBlockSigOps;
+	const CAmount nFeesBefore = nFees;
+
+	for (const CTransaction* ptx : vPackage) {
+		if (AddTx(*ptx, viewPackage))
+			continue;
 
-// We want to sort transactions by priority and fee rate, so:
-typedef boost::tuple<double, CFeeRate, const CTransaction*> TxPriority;
-class TxPriorityCompare
+		// Take the members added so far out again
+		for (size_t i = nTemplateTx; i < pblocktemplate->block.vtx.size(); i++)
+			setInBlock.erase(pblocktemplate->block.vtx[i].GetHash());
+		pblocktemplate->block.vtx.erase(pblocktemplate->block.vtx.begin() + nTemplateTx, pblocktemplate->block.vtx.end());
+		pblocktemplate->vTxFees.erase(pblocktemplate->vTxFees.begin() + nTemplateTx, pblocktemplate->vTxFees.end());
+		pblocktemplate->vTxSigOps.erase(pblocktemplate->vTxSigOps.begin() + nTemplateTx, pblocktemplate->vTxSigOps.end());
+		vBlockSerials.erase(vBlockSerials.begin() + nBlockSerials, vBlockSerials.end());
+		nBlockSize = nBlockSizeBefore;
+		nBlockTx = nBlockTxBefore;
+		nBlockSigOps = nBlockSigOpsBefore;
+		nFees = nFeesBefore;
+		return false;
+	}
+
+	viewPackage.Flush();
+	return true;
+}
+
+//
+// Ancestor packages of mempool transactions less the ancestors that are in
+// the block already. The ancestor score in the mempool counts every
+// in-mempool ancestor, so it goes stale as soon as one of them is mined.
+//
+class CModifiedAncestors
 {
-	bool byFee;
+private:
+	struct CModifiedEntry {
+		uint64_t nSizeWithAncestors;
+		CAmount nModFeesWithAncestors;
+		CAmount nScore;
+	};
+	map<uint256, CModifiedEntry> mapModified;
 
 public:
-	TxPriorityCompare(bool _byFee) : byFee(_byFee) {}
+	//! Modified entries by the ancestor score that is left, taken out once considered
+	set<pair<CAmount, uint256> > setByScore;
 
-	bool operator()(const TxPriority& a, const TxPriority& b)
-	{
-		if (byFee) {
-			if (a.get<1>() == b.get<1>())
-				return a.get<0>() < b.get<0>();
-			return a.get<1>() < b.get<1>();
-		}
-		else {
-			if (a.get<0>() == b.get<0>())
-				return a.get<1>() < b.get<1>();
-			return a.get<0>() < b.get<0>();
+	bool Contains(const uint256& hash) const { return mapModified.count(hash) != 0; }
+
+	/** Take hashIncluded, now in the block, out of the packages of its descendants */
+	void Include(const uint256& hashIncluded, const set<uint256>& setInBlock);
+};
+
+void CModifiedAncestors::Include(const uint256& hashIncluded, const set<uint256>& setInBlock)
+{
+	const CTxMemPoolEntry& included = mempool.mapTx[hashIncluded];
+	set<uint256> setDescendants;
+	mempool.CalculateDescendants(hashIncluded, setDescendants);
+	for (const uint256& hash : setDescendants) {
+		if (setInBlock.count(hash))
+			continue;
+		const CTxMemPoolEntry& entry = mempool.mapTx[hash];
+		if (entry.GetTx().IsZerocoinSpend())
+			continue;
+
+		map<uint256, CModifiedEntry>::iterator it = mapModified.find(hash);
+		if (it == mapModified.end()) {
+			CModifiedEntry modified = {entry.GetSizeWithAncestors(), entry.GetModFeesWithAncestors(), 0};
+			it = mapModified.insert(make_pair(hash, modified)).first;
+		} else {
+			setByScore.erase(make_pair(it->second.nScore, hash));
 		}
+		it->second.nSizeWithAncestors -= included.GetTxSize();
+		it->second.nModFeesWithAncestors -= included.GetModifiedFee();
+
+		// As CTxMemPool::GetAncestorScore, on the package that is left
+		CAmount nFeeRate = CFeeRate(entry.GetModifiedFee(), entry.GetTxSize()).GetFeePerK();
+		CAmount nPackageFeeRate = CFeeRate(it->second.nModFeesWithAncestors, it->second.nSizeWithAncestors).GetFeePerK();
+		it->second.nScore = std::min(nFeeRate, nPackageFeeRate);
+		setByScore.insert(make_pair(it->second.nScore, hash));
 	}
-};
+}
+
+//Give a high priority to zerocoinspends to get into the next block
+//Priority = (age^6+100000)*amount - gives higher priority to zlenos that have been in mempool long
+//and higher priority to zlenos that are large in value
+static double GetZerocoinSpendPriority(const CTransaction& tx)
+{
+	uint256 txid = tx.GetHash();
+	int64_t nTimeSeen = GetAdjustedTime();
+	double nConfs = 100000;
+
+	auto it = mapZerocoinspends.find(txid);
+	if (it != mapZerocoinspends.end()) {
+		nTimeSeen = it->second;
+	}
+	else {
+		//for some reason not in map, add it
+		mapZerocoinspends[txid] = nTimeSeen;
+	}
+
+	double nTimePriority = std::pow(GetAdjustedTime() - nTimeSeen, 6);
+
+	// zleno spends can have very large priority, use non-overflowing safe functions
+	double dPriority = double_safe_addition(0, (nTimePriority * nConfs));
+	return double_safe_multiplication(dPriority, tx.GetZerocoinSpent());
+}
+
+uint64_t nLastBlockTx = 0;
+uint64_t nLastBlockSize = 0;
+int64_t nLastCoinStakeSearchInterval = 0;
 
 void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
 {
@@ -101,10 +294,11 @@ void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
 }
 
 std::pair<int, std::pair<uint256, uint256> > pCheckpointCache;
-CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet, bool fProofOfStake)
-{
-	CReserveKey reservekey(pwallet);
 
+// Build a block on the current tip from the mempool. A proof-of-stake block
+// still lacks its coinstake, which FillCoinStake puts in once a kernel is found.
+static CBlockTemplate* CreateBlockTemplate(const CScript& scriptPubKeyIn, bool fProofOfStake)
+{
 	// Create new block
 	unique_ptr<CBlockTemplate> pblocktemplate(new CBlockTemplate());
 	if (!pblocktemplate.get())
@@ -129,35 +323,15 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 	txNew.vin[0].prevout.SetNull();
 	txNew.vout.resize(1);
 	txNew.vout[0].scriptPubKey = scriptPubKeyIn;
+	if (fProofOfStake)
+		txNew.vout[0].SetEmpty();
 	pblock->vtx.push_back(txNew);
 	pblocktemplate->vTxFees.push_back(-1);   // updated at end
 	pblocktemplate->vTxSigOps.push_back(-1); // updated at end
 
-											 // ppcoin: if coinstake available add coinstake tx
-	static int64_t nLastCoinStakeSearchTime = GetAdjustedTime(); // only initialized at startup
-
 	if (fProofOfStake) {
 		boost::this_thread::interruption_point();
 		pblock->nTime = GetAdjustedTime();
-		CBlockIndex* pindexPrev = chainActive.Tip();
-		pblock->nBits = GetNextWorkRequired(pindexPrev, pblock);
-		CMutableTransaction txCoinStake;
-		int64_t nSearchTime = pblock->nTime; // search to current time
-		bool fStakeFound = false;
-		if (nSearchTime >= nLastCoinStakeSearchTime) {
-			unsigned int nTxNewTime = 0;
-			if (pwallet->CreateCoinStake(*pwallet, pblock->nBits, nSearchTime - nLastCoinStakeSearchTime, txCoinStake, nTxNewTime)) {
-				pblock->nTime = nTxNewTime;
-				pblock->vtx[0].vout[0].SetEmpty();
-				pblock->vtx.push_back(CTransaction(txCoinStake));
-				fStakeFound = true;
-			}
-			nLastCoinStakeSearchInterval = nSearchTime - nLastCoinStakeSearchTime;
-			nLastCoinStakeSearchTime = nSearchTime;
-		}
-
-		if (!fStakeFound)
-			return NULL;
 	}
 
 	// Largest block you're willing to create:
@@ -187,246 +361,153 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
         txNew.vin[0].scriptSig = CScript() << nHeight << OP_0;
         CCoinsViewCache view(pcoinsTip);
 
-		// Priority order to process transactions
-		list<COrphan> vOrphan; // list memory doesn't move
-		map<uint256, vector<COrphan*> > mapDependers;
+		CBlockTxCollector collector(pblocktemplate.get(), view, nHeight, nBlockMaxSize);
 		bool fPrintPriority = GetBoolArg("-printpriority", false);
 
-		// This vector will be sorted into a priority queue:
-		vector<TxPriority> vecPriority;
-		vecPriority.reserve(mempool.mapTx.size());
-		for (map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin();
-			mi != mempool.mapTx.end(); ++mi) {
-			const CTransaction& tx = mi->second.GetTx();
-			if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight)) {
-				continue;
-			}
-			if (GetAdjustedTime() > GetSporkValue(SPORK_16_ZEROCOIN_MAINTENANCE_MODE) && tx.ContainsZerocoins()) {
-				continue;
+		// Fill the high-priority area first, highest coin age priority first. The
+		// priorities come from the mempool entries, a transaction waits in
+		// mapWaiting until its in-mempool parents are in the block.
+		if (nBlockPrioritySize > 0) {
+			vector<pair<double, uint256> > vecPriority;
+			vecPriority.reserve(mempool.mapTx.size());
+			for (map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi) {
+				const CTransaction& tx = mi->second.GetTx();
+				double dPriority = tx.IsZerocoinSpend() ? GetZerocoinSpendPriority(tx) : mi->second.GetPriority(nHeight);
+				CAmount nFeeDelta = 0;
+				mempool.ApplyDeltas(mi->first, dPriority, nFeeDelta);
+				vecPriority.push_back(make_pair(dPriority, mi->first));
 			}
+			std::make_heap(vecPriority.begin(), vecPriority.end());
 
-			COrphan* porphan = NULL;
-			double dPriority = 0;
-			CAmount nTotalIn = 0;
-			bool fMissingInputs = false;
-			uint256 txid = tx.GetHash();
-			for (const CTxIn& txin : tx.vin) {
-				//zerocoinspend has special vin
-				if (tx.IsZerocoinSpend()) {
-					nTotalIn = tx.GetZerocoinSpent();
-
-					//Give a high priority to zerocoinspends to get into the next block
-					//Priority = (age^6+100000)*amount - gives higher priority to zlenos that have been in mempool long
-					//and higher priority to zlenos that are large in value
-					int64_t nTimeSeen = GetAdjustedTime();
-					double nConfs = 100000;
-
-					auto it = mapZerocoinspends.find(txid);
-					if (it != mapZerocoinspends.end()) {
-						nTimeSeen = it->second;
-					}
-					else {
-						//for some reason not in map, add it
-						mapZerocoinspends[txid] = nTimeSeen;
-					}
-
-					double nTimePriority = std::pow(GetAdjustedTime() - nTimeSeen, 6);
-
-					// zleno spends can have very large priority, use non-overflowing safe functions
-					dPriority = double_safe_addition(dPriority, (nTimePriority * nConfs));
-					dPriority = double_safe_multiplication(dPriority, nTotalIn);
+			map<uint256, double> mapWaiting;
+			while (!vecPriority.empty()) {
+				double dPriority = vecPriority.front().first;
+				uint256 hash = vecPriority.front().second;
+				std::pop_heap(vecPriority.begin(), vecPriority.end());
+				vecPriority.pop_back();
 
-					continue;
-				}
+				const CTxMemPoolEntry& entry = mempool.mapTx[hash];
+				if (collector.nBlockSize + entry.GetTxSize() >= nBlockPrioritySize || !AllowFree(dPriority))
+					break;
 
-				// Read prev transaction
-				if (!view.HaveCoins(txin.prevout.hash)) {
-					// This should never happen; all transactions in the memory
-					// pool should connect to either transactions in the chain
-					// or other transactions in the memory pool.
-					if (!mempool.mapTx.count(txin.prevout.hash)) {
-						LogPrintf("ERROR: mempool transaction missing input\n");
-						if (fDebug) assert("mempool transaction missing input" == 0);
-						fMissingInputs = true;
-						if (porphan)
-							vOrphan.pop_back();
+				bool fParentsInBlock = true;
+				for (const uint256& hashParent : mempool.GetMemPoolParents(hash)) {
+					if (!collector.setInBlock.count(hashParent)) {
+						fParentsInBlock = false;
 						break;
 					}
-
-					// Has to wait for dependencies
-					if (!porphan) {
-						// Use list for automatic deletion
-						vOrphan.push_back(COrphan(&tx));
-						porphan = &vOrphan.back();
-					}
-					mapDependers[txin.prevout.hash].push_back(porphan);
-					porphan->setDependsOn.insert(txin.prevout.hash);
-					nTotalIn += mempool.mapTx[txin.prevout.hash].GetTx().vout[txin.prevout.n].nValue;
-					continue;
 				}
-
-				//Check for invalid/fraudulent inputs. They shouldn't make it through mempool, but check anyways.
-				if (invalid_out::ContainsOutPoint(txin.prevout)) {
-					LogPrintf("%s : found invalid input %s in tx %s", __func__, txin.prevout.ToString(), tx.GetHash().ToString());
-					fMissingInputs = true;
-					break;
+				if (!fParentsInBlock) {
+					mapWaiting[hash] = dPriority;
+					continue;
 				}
 
-				const CCoins* coins = view.AccessCoins(txin.prevout.hash);
-				assert(coins);
-
-				CAmount nValueIn = coins->vout[txin.prevout.n].nValue;
-				nTotalIn += nValueIn;
-
-				int nConf = nHeight - coins->nHeight;
+				if (!collector.TryAdd(entry.GetTx()))
+					continue;
 
-				// zleno spends can have very large priority, use non-overflowing safe functions
-				dPriority = double_safe_addition(dPriority, ((double)nValueIn * nConf));
+				if (fPrintPriority) {
+					LogPrintf("priority %.1f fee %s txid %s\n",
+						dPriority, CFeeRate(entry.GetModifiedFee(), entry.GetTxSize()).ToString(), hash.ToString());
+				}
 
+				// Children waiting on this transaction may be ready now
+				for (const uint256& hashChild : mempool.GetMemPoolChildren(hash)) {
+					map<uint256, double>::iterator itWaiting = mapWaiting.find(hashChild);
+					if (itWaiting != mapWaiting.end()) {
+						vecPriority.push_back(make_pair(itWaiting->second, hashChild));
+						std::push_heap(vecPriority.begin(), vecPriority.end());
+						mapWaiting.erase(itWaiting);
+					}
+				}
 			}
-			if (fMissingInputs) continue;
-
-			// Priority is sum(valuein * age) / modified_txsize
-			unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-			dPriority = tx.ComputePriority(dPriority, nTxSize);
-
-			uint256 hash = tx.GetHash();
-			mempool.ApplyDeltas(hash, dPriority, nTotalIn);
-
-			CFeeRate feeRate(nTotalIn - tx.GetValueOut(), nTxSize);
+		}
 
-			if (porphan) {
-				porphan->dPriority = dPriority;
-				porphan->feeRate = feeRate;
+		// Then fill the block by fee rate, walking the mempool by ancestor score.
+		// A transaction comes with the ancestors the block does not have yet,
+		// parents first, so child-pays-for-parent packages are mined together.
+		// Transactions with ancestors in the block are ranked by what is left
+		// of their package instead.
+		CModifiedAncestors modified;
+		for (const uint256& hashInBlock : collector.setInBlock)
+			modified.Include(hashInBlock, collector.setInBlock);
+
+		set<uint256> setFailed;
+		set<pair<CAmount, uint256> >::reverse_iterator mi = mempool.setEntriesByAncestorScore.rbegin();
+		while (mi != mempool.setEntriesByAncestorScore.rend() || !modified.setByScore.empty()) {
+			// The better of the next mempool entry and the best modified one
+			CAmount nScore;
+			uint256 hash;
+			if (mi != mempool.setEntriesByAncestorScore.rend() &&
+				(modified.setByScore.empty() || mi->first >= modified.setByScore.rbegin()->first)) {
+				nScore = mi->first;
+				hash = mi->second;
+				++mi;
+				if (modified.Contains(hash))
+					continue;
+			} else {
+				set<pair<CAmount, uint256> >::iterator itBest = --modified.setByScore.end();
+				nScore = itBest->first;
+				hash = itBest->second;
+				modified.setByScore.erase(itBest);
 			}
-			else
-				vecPriority.push_back(TxPriority(dPriority, feeRate, &mi->second.GetTx()));
-		}
+			if (collector.setInBlock.count(hash) || setFailed.count(hash))
+				continue;
 
-		// Collect transactions into block
-		uint64_t nBlockSize = 1000;
-		uint64_t nBlockTx = 0;
-		int nBlockSigOps = 100;
-		bool fSortedByFee = (nBlockPrioritySize <= 0);
-
-		TxPriorityCompare comparer(fSortedByFee);
-		std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-
-		vector<CBigNum> vBlockSerials;
-		vector<CBigNum> vTxSerials;
-		while (!vecPriority.empty()) {
-			// Take highest priority transaction off the priority queue:
-			double dPriority = vecPriority.front().get<0>();
-			CFeeRate feeRate = vecPriority.front().get<1>();
-			const CTransaction& tx = *(vecPriority.front().get<2>());
-
-			std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-			vecPriority.pop_back();
-
-			// Size limits
-			unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-			if (nBlockSize + nTxSize >= nBlockMaxSize)
+			set<uint256> setAncestors;
+			mempool.CalculateAncestors(hash, setAncestors);
+			vector<pair<uint64_t, uint256> > vPackage;
+			uint64_t nPackageSize = 0;
+			bool fAncestorFailed = false;
+			for (const uint256& hashAncestor : setAncestors) {
+				if (collector.setInBlock.count(hashAncestor))
+					continue;
+				if (setFailed.count(hashAncestor)) {
+					fAncestorFailed = true;
+					break;
+				}
+				const CTxMemPoolEntry& ancestor = mempool.mapTx[hashAncestor];
+				vPackage.push_back(make_pair(ancestor.GetCountWithAncestors(), hashAncestor));
+				nPackageSize += ancestor.GetTxSize();
+			}
+			if (fAncestorFailed) {
+				setFailed.insert(hash);
 				continue;
+			}
 
-			// Legacy limits on sigOps:
-			unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
-			unsigned int nTxSigOps = GetLegacySigOpCount(tx);
-			if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
+			const CTxMemPoolEntry& entry = mempool.mapTx[hash];
+			vPackage.push_back(make_pair(entry.GetCountWithAncestors(), hash));
+			nPackageSize += entry.GetTxSize();
+			if (collector.nBlockSize + nPackageSize >= nBlockMaxSize)
 				continue;
 
 			// Skip free transactions if we're past the minimum block size:
-			const uint256& hash = tx.GetHash();
 			double dPriorityDelta = 0;
 			CAmount nFeeDelta = 0;
 			mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
-			if (!tx.IsZerocoinSpend() && fSortedByFee && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
+			CFeeRate feeRate(nScore);
+			if (!entry.GetTx().IsZerocoinSpend() && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (collector.nBlockSize + nPackageSize >= nBlockMinSize))
 				continue;
 
-			// Prioritise by fee once past the priority size or we run out of high-priority
-			// transactions:
-			if (!fSortedByFee &&
-				((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))) {
-				fSortedByFee = true;
-				comparer = TxPriorityCompare(fSortedByFee);
-				std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-			}
-
-			if (!view.HaveInputs(tx))
+			// An ancestor always has fewer ancestors than its descendants
+			std::sort(vPackage.begin(), vPackage.end());
+			vector<const CTransaction*> vPackageTx;
+			for (const pair<uint64_t, uint256>& member : vPackage)
+				vPackageTx.push_back(&mempool.mapTx[member.second].GetTx());
+			if (!collector.TryAddPackage(vPackageTx)) {
+				setFailed.insert(hash);
 				continue;
-
-			// double check that there are no double spent zleno spends in this block or tx
-			if (tx.IsZerocoinSpend()) {
-				int nHeightTx = 0;
-				if (IsTransactionInChain(tx.GetHash(), nHeightTx))
-					continue;
-
-				bool fDoubleSerial = false;
-				for (const CTxIn& txIn : tx.vin) {
-					if (txIn.scriptSig.IsZerocoinSpend()) {
-						libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txIn);
-						bool fUseV1Params = libzerocoin::ExtractVersionFromSerial(spend.getCoinSerialNumber()) < libzerocoin::PrivateCoin::PUBKEY_VERSION;
-						if (!spend.HasValidSerial(Params().Zerocoin_Params(fUseV1Params)))
-							fDoubleSerial = true;
-						if (count(vBlockSerials.begin(), vBlockSerials.end(), spend.getCoinSerialNumber()))
-							fDoubleSerial = true;
-						if (count(vTxSerials.begin(), vTxSerials.end(), spend.getCoinSerialNumber()))
-							fDoubleSerial = true;
-						if (fDoubleSerial)
-							break;
-						vTxSerials.emplace_back(spend.getCoinSerialNumber());
-					}
-				}
-				//This zleno serial has already been included in the block, do not add this tx.
-				if (fDoubleSerial)
-					continue;
 			}
 
-			CAmount nTxFees = view.GetValueIn(tx) - tx.GetValueOut();
-
-			nTxSigOps += GetP2SHSigOpCount(tx, view);
-			if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
-				continue;
-
-			// Note that flags: we don't want to set mempool/IsStandard()
-			// policy here, but we still have to ensure that the block we
-			// create only contains transactions that are valid in new blocks.
-			CValidationState state;
-			if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
-				continue;
-
-			CTxUndo txundo;
-			UpdateCoins(tx, state, view, txundo, nHeight);
-
-			// Added
-			pblock->vtx.push_back(tx);
-			pblocktemplate->vTxFees.push_back(nTxFees);
-			pblocktemplate->vTxSigOps.push_back(nTxSigOps);
-			nBlockSize += nTxSize;
-			++nBlockTx;
-			nBlockSigOps += nTxSigOps;
-			nFees += nTxFees;
-
-			for (const CBigNum& bnSerial : vTxSerials)
-				vBlockSerials.emplace_back(bnSerial);
-
-			if (fPrintPriority) {
-				LogPrintf("priority %.1f fee %s txid %s\n",
-					dPriority, feeRate.ToString(), tx.GetHash().ToString());
-			}
-
-			// Add transactions that depend on this one to the priority queue
-			if (mapDependers.count(hash)) {
-				BOOST_FOREACH(COrphan* porphan, mapDependers[hash]) {
-					if (!porphan->setDependsOn.empty()) {
-						porphan->setDependsOn.erase(hash);
-						if (porphan->setDependsOn.empty()) {
-							vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
-							std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-						}
-					}
+			for (const pair<uint64_t, uint256>& member : vPackage) {
+				modified.Include(member.second, collector.setInBlock);
+				if (fPrintPriority) {
+					LogPrintf("package fee %s txid %s\n", feeRate.ToString(), member.second.ToString());
 				}
 			}
 		}
+		nFees = collector.nFees;
+		uint64_t nBlockSize = collector.nBlockSize;
+		uint64_t nBlockTx = collector.nBlockTx;
 
 		if (!fProofOfStake) {
 			//Masternode and general budget payments
@@ -480,17 +561,60 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 		pblock->nAccumulatorCheckpoint = pCheckpointCache.second.second;
 		}
 
-		CValidationState state;
-		if (!TestBlockValidity(state, *pblock, pindexPrev, false, false)) {
-			LogPrintf("CreateNewBlock() : TestBlockValidity failed\n");
-			mempool.clear();
-			return NULL;
+	}
+
+	return pblocktemplate.release();
+}
+
+// ppcoin: if coinstake available add coinstake tx
+int64_t nLastCoinStakeSearchTime = 0; // set on the first search
+
+// Search for a kernel and, if one is found, put its coinstake in a
+// proof-of-stake block from CreateBlockTemplate
+static bool FillCoinStake(CBlockTemplate* pblocktemplate, CWallet* pwallet)
+{
+	boost::this_thread::interruption_point();
+	CBlock* pblock = &pblocktemplate->block;
+	CMutableTransaction txCoinStake;
+	int64_t nSearchTime = GetAdjustedTime(); // search to current time
+	if (nLastCoinStakeSearchTime == 0)
+		nLastCoinStakeSearchTime = nSearchTime;
+	bool fStakeFound = false;
+	if (nSearchTime >= nLastCoinStakeSearchTime) {
+		unsigned int nTxNewTime = 0;
+		if (pwallet->CreateCoinStake(*pwallet, pblock->nBits, nSearchTime - nLastCoinStakeSearchTime, txCoinStake, nTxNewTime)) {
+			pblock->nTime = nTxNewTime;
+			pblock->vtx.insert(pblock->vtx.begin() + 1, CTransaction(txCoinStake));
+			pblocktemplate->vTxFees.insert(pblocktemplate->vTxFees.begin() + 1, 0);
+			pblocktemplate->vTxSigOps.insert(pblocktemplate->vTxSigOps.begin() + 1, GetLegacySigOpCount(pblock->vtx[1]));
+			fStakeFound = true;
 		}
+		nLastCoinStakeSearchInterval = nSearchTime - nLastCoinStakeSearchTime;
+		nLastCoinStakeSearchTime = nSearchTime;
+	}
+
+	return fStakeFound;
+}
+
+CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet, bool fProofOfStake)
+{
+	unique_ptr<CBlockTemplate> pblocktemplate(CreateBlockTemplate(scriptPubKeyIn, fProofOfStake));
+	if (!pblocktemplate.get())
+		return NULL;
+
+	if (fProofOfStake && !FillCoinStake(pblocktemplate.get(), pwallet))
+		return NULL;
+
+	LOCK(cs_main);
+	CBlockIndex* pindexPrev = chainActive.Tip();
+	if (pblocktemplate->block.hashPrevBlock != pindexPrev->GetBlockHash())
+		return NULL;
 
-		//        if (pblock->IsZerocoinStake()) {
-		//            CWalletTx wtx(pwalletMain, pblock->vtx[1]);
-		//            pwalletMain->AddToWallet(wtx);
-		//        }
+	CValidationState state;
+	if (!TestBlockValidity(state, pblocktemplate->block, pindexPrev, false, false)) {
+		LogPrintf("CreateNewBlock() : TestBlockValidity failed\n");
+		mempool.clear();
+		return NULL;
 	}
 
 	return pblocktemplate.release();
@@ -532,7 +656,8 @@ CBlockTemplate* CreateNewBlockWithKey(CReserveKey& reservekey, CWallet* pwallet,
 	return CreateNewBlock(scriptPubKey, pwallet, fProofOfStake);
 }
 
-bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
+// preservekey is NULL for proof-of-stake blocks, their coinbase pays to no key
+bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey* preservekey)
 {
 	LogPrintf("%s\n", pblock->ToString());
 	LogPrintf("generated %s\n", FormatMoney(pblock->vtx[0].vout[0].nValue));
@@ -545,7 +670,8 @@ bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
 	}
 
 	// Remove key from key pool
-	reservekey.KeepKey();
+	if (preservekey)
+		preservekey->KeepKey();
 
 	// Track how many getdata requests this block gets
 	{
@@ -575,57 +701,237 @@ bool fGenerateBitcoins = false;
 bool fMintableCoins = false;
 int nMintableLastCheck = 0;
 
-// ***TODO*** that part changed in bitcoin, we are using a mix with old one here for now
+//! Seconds a staking block template is kept before mempool changes are picked up
+static const int64_t STAKE_TEMPLATE_REFRESH_INTERVAL = 5;
 
-void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
+//
+// Wakes the staking thread when the chain tip changes, so it rebuilds its
+// template and searches the new tip without polling for it. Mempool changes
+// don't wake it, they are picked up when the template refresh timer fires.
+//
+class CStakeNotifier : public CValidationInterface
 {
-	LogPrintf("LenoCoreMiner started\n");
-	SetThreadPriority(THREAD_PRIORITY_LOWEST);
-	RenameThread("lenocore-miner");
+private:
+	boost::mutex mutex;
+	boost::condition_variable cond;
+	bool fNotified;
 
-	// Each thread has its own key and counter
-	CReserveKey reservekey(pwallet);
+	void Notify()
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			fNotified = true;
+		}
+		cond.notify_all();
+	}
+
+protected:
+	void UpdatedBlockTip(const CBlockIndex* pindex)
+	{
+		Notify();
+	}
+
+public:
+	CStakeNotifier() : fNotified(false) {}
+
+	/** Wait for a notification, at most nMilliseconds */
+	void Wait(int64_t nMilliseconds)
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		if (!fNotified)
+			cond.timed_wait(lock, boost::posix_time::milliseconds(nMilliseconds));
+		fNotified = false;
+	}
+};
+
+static CStakeNotifier stakeNotifier;
+
+// Validate a staked block before it is signed. The template transactions
+// were checked against the tip by CBlockTxCollector when the template was
+// built, so only the coinstake is checked here: the block is tested with the
+// coinbase and the coinstake alone, and the coinstake must not spend an input
+// or a zerocoin serial that a template transaction spends.
+static bool TestStakedBlockValidity(const CBlock& block)
+{
+	LOCK(cs_main);
+	CBlockIndex* pindexPrev = chainActive.Tip();
+	if (block.hashPrevBlock != pindexPrev->GetBlockHash())
+		return false;
+
+	set<COutPoint> setStakeInputs;
+	vector<CBigNum> vStakeSerials;
+	for (const CTxIn& txin : block.vtx[1].vin) {
+		if (txin.scriptSig.IsZerocoinSpend())
+			vStakeSerials.emplace_back(TxInToZerocoinSpend(txin).getCoinSerialNumber());
+		else
+			setStakeInputs.insert(txin.prevout);
+	}
+	for (unsigned int i = 2; i < block.vtx.size(); i++) {
+		for (const CTxIn& txin : block.vtx[i].vin) {
+			bool fConflict = txin.scriptSig.IsZerocoinSpend() ?
+				count(vStakeSerials.begin(), vStakeSerials.end(), TxInToZerocoinSpend(txin).getCoinSerialNumber()) > 0 :
+				setStakeInputs.count(txin.prevout) > 0;
+			if (fConflict) {
+				LogPrintf("BitcoinMiner(): coinstake conflicts with template tx %s\n", block.vtx[i].GetHash().ToString());
+				return false;
+			}
+		}
+	}
+
+	// The coinbase and the coinstake alone
+	CBlock blockStake(block);
+	blockStake.vtx.resize(2);
+	blockStake.hashMerkleRoot = blockStake.BuildMerkleTree();
+	CValidationState state;
+	if (!TestBlockValidity(state, blockStake, pindexPrev, false, false)) {
+		LogPrintf("BitcoinMiner(): staked block failed validation: %s\n", state.GetRejectReason());
+		return false;
+	}
+	return true;
+}
+
+// Proof-of-stake loop. A block template for the tip is kept ready, so that
+// after a kernel is found only the coinstake has to be added and signed.
+static void BitcoinStaker(CWallet* pwallet)
+{
 	unsigned int nExtraNonce = 0;
 
-	while (fGenerateBitcoins || fProofOfStake) {
-		if (fProofOfStake) {
-			//control the amount of times the client will check for mintable coins
-			if ((GetTime() - nMintableLastCheck > 5 * 60)) // 5 minute check time
-			{
-				nMintableLastCheck = GetTime();
-				fMintableCoins = pwallet->MintableCoins();
+	unique_ptr<CBlockTemplate> pblocktemplate;
+	unsigned int nTransactionsUpdatedLast = 0;
+	int64_t nTemplateTime = 0;
+
+	uint256 hashLastSearchTip = 0;
+	int64_t nLastSearchTime = 0;
+
+	// The balance is checked once per tip
+	uint256 hashBalanceTip = 0;
+	bool fBalanceStakeable = false;
+
+	while (true) {
+		boost::this_thread::interruption_point();
+
+		//control the amount of times the client will check for mintable coins
+		if (GetTime() - nMintableLastCheck > (fMintableCoins ? 5 * 60 : 1 * 60)) {
+			nMintableLastCheck = GetTime();
+			fMintableCoins = pwallet->MintableCoins();
+		}
+
+		CBlockIndex* pindexPrev = chainActive.Tip();
+		if (pindexPrev && pindexPrev->GetBlockHash() != hashBalanceTip) {
+			// Make sure the wallet has seen every block and transaction
+			// we are about to build on before selecting stake inputs.
+			SyncWithValidationInterfaceQueue();
+			hashBalanceTip = pindexPrev->GetBlockHash();
+			CAmount nBalance = pwallet->GetBalance();
+			fBalanceStakeable = nBalance <= 0 || nReserveBalance < nBalance;
+		}
+		if (!pindexPrev || pindexPrev->nHeight < Params().LAST_POW_BLOCK() || vNodes.empty() || pwallet->IsLocked() || !fMintableCoins ||
+			!fBalanceStakeable || !masternodeSync.IsSynced()) {
+			nLastCoinStakeSearchInterval = 0;
+			pblocktemplate.reset();
+			stakeNotifier.Wait(5000);
+			continue;
+		}
+
+		// Rebuild the template on a new tip right away, and for mempool
+		// changes at most every STAKE_TEMPLATE_REFRESH_INTERVAL seconds
+		const uint256 hashTip = pindexPrev->GetBlockHash();
+		bool fMempoolChanged = mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast;
+		if (!pblocktemplate.get() || pblocktemplate->block.hashPrevBlock != hashTip ||
+			(fMempoolChanged && GetTime() - nTemplateTime >= STAKE_TEMPLATE_REFRESH_INTERVAL)) {
+			nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+			nTemplateTime = GetTime();
+			fMempoolChanged = false;
+			pblocktemplate.reset(CreateBlockTemplate(CScript(), true));
+			if (!pblocktemplate.get()) {
+				stakeNotifier.Wait(5000);
+				continue;
 			}
+			if (pblocktemplate->block.hashPrevBlock != hashTip)
+				continue;
+		}
 
-			if (chainActive.Tip()->nHeight < Params().LAST_POW_BLOCK()) {
-				MilliSleep(5000);
+		// Search a tip for a kernel once every nHashInterval seconds, waking
+		// up early for a new tip or to refresh the template
+		if (hashLastSearchTip == hashTip) {
+			int64_t nWait = nLastSearchTime + max(pwallet->nHashInterval, (unsigned int)1) - GetTime();
+			if (nWait > 0) {
+				if (fMempoolChanged)
+					nWait = std::min(nWait, nTemplateTime + STAKE_TEMPLATE_REFRESH_INTERVAL - GetTime());
+				stakeNotifier.Wait(std::max(nWait, (int64_t)1) * 1000);
 				continue;
 			}
+		}
+		hashLastSearchTip = hashTip;
+		nLastSearchTime = GetTime();
 
-			while (vNodes.empty() || pwallet->IsLocked() || !fMintableCoins || (pwallet->GetBalance() > 0 && nReserveBalance >= pwallet->GetBalance()) || !masternodeSync.IsSynced()) {
-				nLastCoinStakeSearchInterval = 0;
-				// Do a separate 1 minute check here to ensure fMintableCoins is updated
-				if (!fMintableCoins) {
-					if (GetTime() - nMintableLastCheck > 1 * 60) // 1 minute check time
-					{
-						nMintableLastCheck = GetTime();
-						fMintableCoins = pwallet->MintableCoins();
-					}
-				}
-				MilliSleep(5000);
-				if (!fGenerateBitcoins && !fProofOfStake)
-					continue;
+		unique_ptr<CBlockTemplate> pblockstake(new CBlockTemplate(*pblocktemplate));
+		if (!FillCoinStake(pblockstake.get(), pwallet))
+			continue;
+
+		CBlock* pblock = &pblockstake->block;
+		IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
+		if (!TestStakedBlockValidity(*pblock)) {
+			if (pblock->IsZerocoinStake())
+				pwallet->zlenoTracker->RemovePending(pblock->vtx[1].GetHash());
+			pblocktemplate.reset();
+			continue;
+		}
+
+		LogPrintf("CPUMiner : proof-of-stake block found %s \n", pblock->GetHash().ToString().c_str());
+		if (pblock->IsZerocoinStake()) {
+			//Find the key associated with the zerocoin that is being staked
+			libzerocoin::CoinSpend spend = TxInToZerocoinSpend(pblock->vtx[1].vin[0]);
+			CBigNum bnSerial = spend.getCoinSerialNumber();
+			CKey key;
+			if (!pwallet->GetZerocoinKey(bnSerial, key)) {
+				LogPrintf("%s: failed to find zleno with serial %s, unable to sign block\n", __func__, bnSerial.GetHex());
+				continue;
 			}
 
-			if (mapHashedBlocks.count(chainActive.Tip()->nHeight)) //search our map of hashed blocks, see if bestblock has been hashed yet
-			{
-				if (GetTime() - mapHashedBlocks[chainActive.Tip()->nHeight] < max(pwallet->nHashInterval, (unsigned int)1)) // wait half of the nHashDrift with max wait of 3 minutes
-				{
-					MilliSleep(5000);
-					continue;
-				}
+			//Sign block with the zleno key
+			if (!SignBlockWithKey(*pblock, key)) {
+				LogPrintf("BitcoinMiner(): Signing new block with zleno key failed \n");
+				continue;
 			}
 		}
+		else if (!SignBlock(*pblock, *pwallet)) {
+			LogPrintf("BitcoinMiner(): Signing new block with UTXO key failed \n");
+			continue;
+		}
 
+		LogPrintf("CPUMiner : proof-of-stake block was signed %s \n", pblock->GetHash().ToString().c_str());
+		SetThreadPriority(THREAD_PRIORITY_NORMAL);
+		ProcessBlockFound(pblock, *pwallet, NULL);
+		SetThreadPriority(THREAD_PRIORITY_LOWEST);
+		pblocktemplate.reset();
+	}
+}
+
+// ***TODO*** that part changed in bitcoin, we are using a mix with old one here for now
+
+void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
+{
+	LogPrintf("LenoCoreMiner started\n");
+	SetThreadPriority(THREAD_PRIORITY_LOWEST);
+	RenameThread("lenocore-miner");
+
+	if (fProofOfStake) {
+		RegisterValidationInterface(&stakeNotifier);
+		try {
+			BitcoinStaker(pwallet);
+		} catch (...) {
+			UnregisterValidationInterface(&stakeNotifier);
+			throw;
+		}
+		return;
+	}
+
+	// Each thread has its own key and counter
+	CReserveKey reservekey(pwallet);
+	unsigned int nExtraNonce = 0;
+
+	while (fGenerateBitcoins) {
 		//
 		// Create new block
 		//
@@ -634,45 +940,13 @@ void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
 		if (!pindexPrev)
 			continue;
 
-		unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlockWithKey(reservekey, pwallet, fProofOfStake));
+		unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlockWithKey(reservekey, pwallet, false));
 		if (!pblocktemplate.get())
 			continue;
 
 		CBlock* pblock = &pblocktemplate->block;
 		IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
 
-		//Stake miner main
-		if (fProofOfStake) {
-			LogPrintf("CPUMiner : proof-of-stake block found %s \n", pblock->GetHash().ToString().c_str());
-			if (pblock->IsZerocoinStake()) {
-				//Find the key associated with the zerocoin that is being staked
-				libzerocoin::CoinSpend spend = TxInToZerocoinSpend(pblock->vtx[1].vin[0]);
-				CBigNum bnSerial = spend.getCoinSerialNumber();
-				CKey key;
-				if (!pwallet->GetZerocoinKey(bnSerial, key)) {
-					LogPrintf("%s: failed to find zleno with serial %s, unable to sign block\n", __func__, bnSerial.GetHex());
-					continue;
-				}
-
-				//Sign block with the zleno key
-				if (!SignBlockWithKey(*pblock, key)) {
-					LogPrintf("BitcoinMiner(): Signing new block with zleno key failed \n");
-					continue;
-				}
-			}
-			else if (!SignBlock(*pblock, *pwallet)) {
-				LogPrintf("BitcoinMiner(): Signing new block with UTXO key failed \n");
-				continue;
-			}
-
-			LogPrintf("CPUMiner : proof-of-stake block was signed %s \n", pblock->GetHash().ToString().c_str());
-			SetThreadPriority(THREAD_PRIORITY_NORMAL);
-			ProcessBlockFound(pblock, *pwallet, reservekey);
-			SetThreadPriority(THREAD_PRIORITY_LOWEST);
-
-			continue;
-		}
-
 		LogPrintf("Running LenoCoreMiner with %u transactions in block (%u bytes)\n", pblock->vtx.size(),
 			::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
 
@@ -692,7 +966,7 @@ void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
 					SetThreadPriority(THREAD_PRIORITY_NORMAL);
 					LogPrintf("BitcoinMiner:\n");
 					LogPrintf("proof-of-work found  \n  hash: %s  \ntarget: %s\n", hash.GetHex(), hashTarget.GetHex());
-					ProcessBlockFound(pblock, *pwallet, reservekey);
+					ProcessBlockFound(pblock, *pwallet, &reservekey);
 					SetThreadPriority(THREAD_PRIORITY_LOWEST);
 
 					// In regression test mode, stop mining after a block is found. This
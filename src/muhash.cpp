@@ -0,0 +1,78 @@
+// Copyright (c) 2021-2022 The LenoCore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "muhash.h"
+
+#include "crypto/sha256.h"
+#include "hash.h"
+
+/** Number of bytes in an element of the group */
+static const size_t MUHASH_ELEMENT_SIZE = 384;
+
+static CBigNum MakeModulus()
+{
+    // 2^3072 - 1103717, the largest 3072-bit safe prime
+    CBigNum bn(1);
+    bn <<= 3072;
+    bn -= CBigNum(1103717);
+    return bn;
+}
+
+const CBigNum& CMuHash3072::Modulus()
+{
+    static const CBigNum bnModulus = MakeModulus();
+    return bnModulus;
+}
+
+CBigNum CMuHash3072::ToElement(const std::vector<unsigned char>& vData)
+{
+    // Expand SHA256(data) to 3072 bits by hashing it with a counter
+    unsigned char seed[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(vData.empty() ? NULL : &vData[0], vData.size()).Finalize(seed);
+
+    std::vector<unsigned char> vch(MUHASH_ELEMENT_SIZE + 1, 0);
+    for (unsigned int i = 0; i < MUHASH_ELEMENT_SIZE / CSHA256::OUTPUT_SIZE; i++) {
+        unsigned char counter[4] = {(unsigned char)i, 0, 0, 0};
+        CSHA256().Write(seed, sizeof(seed)).Write(counter, sizeof(counter)).Finalize(&vch[i * CSHA256::OUTPUT_SIZE]);
+    }
+    // The trailing zero byte keeps the (little endian) number positive
+    CBigNum bn;
+    bn.setvch(vch);
+    bn %= Modulus();
+    if (bn == 0)
+        bn = 1;
+    return bn;
+}
+
+CMuHash3072::CMuHash3072() : bnNumerator(1), bnDenominator(1)
+{
+}
+
+void CMuHash3072::Insert(const std::vector<unsigned char>& vData)
+{
+    bnNumerator = bnNumerator.mul_mod(ToElement(vData), Modulus());
+}
+
+void CMuHash3072::Remove(const std::vector<unsigned char>& vData)
+{
+    bnDenominator = bnDenominator.mul_mod(ToElement(vData), Modulus());
+}
+
+CMuHash3072& CMuHash3072::operator*=(const CMuHash3072& other)
+{
+    bnNumerator = bnNumerator.mul_mod(other.bnNumerator, Modulus());
+    bnDenominator = bnDenominator.mul_mod(other.bnDenominator, Modulus());
+    return *this;
+}
+
+uint256 CMuHash3072::Finalize() const
+{
+    CBigNum bnValue = bnNumerator.mul_mod(bnDenominator.inverse(Modulus()), Modulus());
+    std::vector<unsigned char> vch = bnValue.getvch();
+    vch.resize(MUHASH_ELEMENT_SIZE + 1, 0);
+
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << vch;
+    return ss.GetHash();
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2021-2022 The LenoCore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MUHASH_H
+#define BITCOIN_MUHASH_H
+
+#include "libzerocoin/bignum.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <vector>
+
+/**
+ * Order-independent hash of a multiset of byte strings (MuHash).
+ *
+ * Every element is mapped to a number modulo the prime 2^3072 - 1103717 and
+ * the set is represented by the product of its elements. Inserting and
+ * removing are a single modular multiplication each, so the hash of a large
+ * set can be kept up to date as elements come and go. Removals are collected
+ * in a separate denominator so that only Finalize() needs a modular inverse.
+ */
+class CMuHash3072
+{
+private:
+    CBigNum bnNumerator;
+    CBigNum bnDenominator;
+
+    static const CBigNum& Modulus();
+    static CBigNum ToElement(const std::vector<unsigned char>& vData);
+
+public:
+    /** The hash of the empty set */
+    CMuHash3072();
+
+    /** Add an element to the set */
+    void Insert(const std::vector<unsigned char>& vData);
+    /** Remove an element that was previously inserted */
+    void Remove(const std::vector<unsigned char>& vData);
+    /** Combine with the elements of another set */
+    CMuHash3072& operator*=(const CMuHash3072& other);
+
+    /** 256-bit digest of the current set */
+    uint256 Finalize() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(bnNumerator);
+        READWRITE(bnDenominator);
+    }
+};
+
+#endif // BITCOIN_MUHASH_H
@@ -27,6 +27,7 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #ifdef USE_UPNP
@@ -36,9 +37,15 @@
 #include <miniupnpc/upnperrors.h>
 #endif
 
+#include <atomic>
+
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 // Dump addresses to peers.dat every 15 minutes (900s)
 #define DUMP_ADDRESSES_INTERVAL 900
 
@@ -63,6 +70,12 @@ using namespace std;
 namespace
 {
 const int MAX_OUTBOUND_CONNECTIONS = 16;
+/** Longest the socket handler waits for socket events, in milliseconds (frequency to poll pnode->vSend with select) */
+const int SOCKET_EVENTS_TIMEOUT = 50;
+/** How long the socket handler waits while a node's buffers are locked by another thread, in milliseconds */
+const int SOCKET_EVENTS_CONTENDED_TIMEOUT = 5;
+/** Maximum number of events fetched by one epoll_wait() call */
+const int MAX_EPOLL_EVENTS = 256;
 
 struct ListenSocket {
     SOCKET socket;
@@ -86,6 +99,7 @@ uint64_t nLocalHostNonce = 0;
 static std::vector<ListenSocket> vhListenSocket;
 CAddrMan addrman;
 int nMaxConnections = 125;
+SocketEventsMode nSocketEventsMode = SOCKETEVENTS_SELECT;
 bool fAddressesInitialized = false;
 
 vector<CNode*> vNodes;
@@ -94,6 +108,7 @@ map<CInv, CDataStream> mapRelay;
 deque<pair<int64_t, CInv> > vRelayExpiration;
 CCriticalSection cs_mapRelay;
 limitedmap<CInv, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
+CCriticalSection cs_mapAlreadyAskedFor;
 
 static deque<string> vOneShots;
 CCriticalSection cs_vOneShots;
@@ -108,7 +123,18 @@ NodeId nLastNodeId = 0;
 CCriticalSection cs_nLastNodeId;
 
 static CSemaphore* semOutbound = NULL;
-boost::condition_variable messageHandlerCondition;
+// Shared by all message handler threads, each of which waits with its own mutex
+boost::condition_variable_any messageHandlerCondition;
+static int nMessageHandlerThreads = DEFAULT_MSGHANDLER_THREADS;
+
+// Self-pipe used to interrupt the socket handler's select()/epoll_wait()
+static int hSocketHandlerWake[2] = {-1, -1};
+static std::atomic<bool> fSocketHandlerWakePending(false);
+#ifdef HAVE_SYS_EPOLL_H
+static int hEpoll = -1;
+// Address registered as epoll user data for the wake-up pipe
+static char chEpollWakeMarker;
+#endif
 
 // Signals for message handling
 static CNodeSignals g_signals;
@@ -415,7 +441,7 @@ CNode* ConnectNode(CAddress addrConnect, const char* pszDest, bool obfuScationMa
     bool proxyConnectionFailed = false;
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout, &proxyConnectionFailed) :
                   ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed)) {
-        if (!IsSelectableSocket(hSocket)) {
+        if (nSocketEventsMode == SOCKETEVENTS_SELECT && !IsSelectableSocket(hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -431,6 +457,7 @@ CNode* ConnectNode(CAddress addrConnect, const char* pszDest, bool obfuScationMa
             LOCK(cs_vNodes);
             vNodes.push_back(pnode);
         }
+        WakeSocketHandler();
 
         pnode->nTimeConnected = GetTime();
         if (obfuScationMaster) pnode->fObfuScationMaster = true;
@@ -737,7 +764,7 @@ bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes)
 
         if (msg.complete()) {
             msg.nTime = GetTimeMicros();
-            messageHandlerCondition.notify_one();
+            messageHandlerCondition.notify_all();
         }
     }
 
@@ -836,9 +863,264 @@ void SocketSendData(CNode* pnode)
 
 static list<CNode*> vNodesDisconnected;
 
+// requires LOCK(pnode->cs_vRecvMsg)
+static bool IsReceiveAllowed(CNode* pnode)
+{
+    // Stop reading while a complete message is waiting and the receive buffer
+    // is full; the message handler wakes us once it made room.
+    return pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+           pnode->GetTotalRecvSize() <= ReceiveFloodSize();
+}
+
+std::string GetSocketEventsModes()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    return "select, epoll";
+#else
+    return "select";
+#endif
+}
+
+void WakeSocketHandler()
+{
+    if (hSocketHandlerWake[1] == -1 || fSocketHandlerWakePending.exchange(true))
+        return;
+#ifndef WIN32
+    char c = 0;
+    if (write(hSocketHandlerWake[1], &c, 1) != 1)
+        fSocketHandlerWakePending = false;
+#endif
+}
+
+static void DrainSocketHandlerWake()
+{
+#ifndef WIN32
+    char buf[128];
+    fSocketHandlerWakePending = false;
+    while (read(hSocketHandlerWake[0], buf, sizeof(buf)) > 0) {
+    }
+#endif
+}
+
+static void InitSocketEvents()
+{
+#ifndef WIN32
+    if (pipe(hSocketHandlerWake) == 0) {
+        fcntl(hSocketHandlerWake[0], F_SETFL, O_NONBLOCK);
+        fcntl(hSocketHandlerWake[1], F_SETFL, O_NONBLOCK);
+    } else {
+        LogPrintf("Unable to create socket handler wake-up pipe: %s\n", NetworkErrorString(errno));
+        hSocketHandlerWake[0] = hSocketHandlerWake[1] = -1;
+    }
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+    if (nSocketEventsMode == SOCKETEVENTS_EPOLL) {
+        hEpoll = epoll_create1(EPOLL_CLOEXEC);
+        if (hEpoll == -1) {
+            LogPrintf("epoll_create1 failed: %s, falling back to select\n", NetworkErrorString(errno));
+            nSocketEventsMode = SOCKETEVENTS_SELECT;
+        } else {
+            // Listening sockets stay level-triggered as we accept one connection per pass
+            BOOST_FOREACH (ListenSocket& hListenSocket, vhListenSocket) {
+                struct epoll_event event;
+                event.events = EPOLLIN;
+                event.data.ptr = &hListenSocket;
+                if (epoll_ctl(hEpoll, EPOLL_CTL_ADD, hListenSocket.socket, &event) != 0)
+                    LogPrintf("epoll_ctl failed for listening socket: %s\n", NetworkErrorString(errno));
+            }
+            if (hSocketHandlerWake[0] != -1) {
+                struct epoll_event event;
+                event.events = EPOLLIN;
+                event.data.ptr = &chEpollWakeMarker;
+                epoll_ctl(hEpoll, EPOLL_CTL_ADD, hSocketHandlerWake[0], &event);
+            }
+        }
+    }
+#endif
+
+    LogPrintf("Using %s for socket events\n", nSocketEventsMode == SOCKETEVENTS_EPOLL ? "epoll" : "select");
+}
+
+static void SocketEventsSelect(std::set<SOCKET>& setListenReady)
+{
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = SOCKET_EVENTS_TIMEOUT * 1000;
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    bool have_fds = false;
+
+    BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
+        FD_SET(hListenSocket.socket, &fdsetRecv);
+        hSocketMax = max(hSocketMax, hListenSocket.socket);
+        have_fds = true;
+    }
+
+#ifndef WIN32
+    if (hSocketHandlerWake[0] != -1) {
+        FD_SET(hSocketHandlerWake[0], &fdsetRecv);
+        hSocketMax = max(hSocketMax, (SOCKET)hSocketHandlerWake[0]);
+        have_fds = true;
+    }
+#endif
+
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes) {
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+            FD_SET(pnode->hSocket, &fdsetError);
+            hSocketMax = max(hSocketMax, pnode->hSocket);
+            have_fds = true;
+
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is no (complete) message in the receive buffer,
+            //   or there is space left in the buffer, select() for receiving data.
+            // * (if neither of the above applies, there is certainly one message
+            //   in the receiver buffer ready to be processed).
+            // Together, that means that at least one of the following is always possible,
+            // so we don't deadlock:
+            // * We send some data.
+            // * We wait for data to be received (and disconnect after timeout).
+            // * We process a message in the buffer (message handler thread).
+            {
+                TRY_LOCK(pnode->cs_vSend, lockSend);
+                if (lockSend && !pnode->vSendMsg.empty()) {
+                    FD_SET(pnode->hSocket, &fdsetSend);
+                    continue;
+                }
+            }
+            {
+                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                if (lockRecv && IsReceiveAllowed(pnode))
+                    FD_SET(pnode->hSocket, &fdsetRecv);
+            }
+        }
+    }
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+        &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    boost::this_thread::interruption_point();
+
+    bool fSelectError = false;
+    if (nSelect == SOCKET_ERROR) {
+        if (have_fds) {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            for (unsigned int i = 0; i <= hSocketMax; i++)
+                FD_SET(i, &fdsetRecv);
+            fSelectError = true;
+        }
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        MilliSleep(timeout.tv_usec / 1000);
+    }
+
+    BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
+        if (FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            setListenReady.insert(hListenSocket.socket);
+    }
+
+#ifndef WIN32
+    if (hSocketHandlerWake[0] != -1 && FD_ISSET(hSocketHandlerWake[0], &fdsetRecv))
+        DrainSocketHandlerWake();
+#endif
+
+    LOCK(cs_vNodes);
+    BOOST_FOREACH (CNode* pnode, vNodes) {
+        SOCKET hSocket = pnode->hSocket;
+        if (hSocket == INVALID_SOCKET || hSocket > hSocketMax) {
+            // connected while we were waiting
+            pnode->fSocketRecvReady = pnode->fSocketSendReady = false;
+            continue;
+        }
+        pnode->fSocketRecvReady = fSelectError || FD_ISSET(hSocket, &fdsetRecv) || FD_ISSET(hSocket, &fdsetError);
+        pnode->fSocketSendReady = FD_ISSET(hSocket, &fdsetSend);
+    }
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static void SocketEventsEpoll(std::set<SOCKET>& setListenReady, int nTimeout)
+{
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes) {
+            if (pnode->fSocketRegistered || pnode->hSocket == INVALID_SOCKET)
+                continue;
+            // Closing the socket removes it from the epoll set, so nodes are
+            // never deregistered explicitly.
+            struct epoll_event event;
+            event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.ptr = pnode;
+            if (epoll_ctl(hEpoll, EPOLL_CTL_ADD, pnode->hSocket, &event) != 0) {
+                LogPrintf("epoll_ctl failed for peer=%d: %s\n", pnode->id, NetworkErrorString(errno));
+                pnode->CloseSocketDisconnect();
+                continue;
+            }
+            pnode->fSocketRegistered = true;
+        }
+    }
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(hEpoll, events, MAX_EPOLL_EVENTS, nTimeout);
+    boost::this_thread::interruption_point();
+
+    if (nEvents < 0) {
+        if (errno != EINTR) {
+            LogPrintf("epoll_wait error %s\n", NetworkErrorString(errno));
+            MilliSleep(SOCKET_EVENTS_TIMEOUT);
+        }
+        return;
+    }
+
+    // Nodes are only deleted by this thread, after their socket was closed,
+    // so the node pointers in the returned events are still valid.
+    for (int i = 0; i < nEvents; i++) {
+        void* ptr = events[i].data.ptr;
+        uint32_t nFlags = events[i].events;
+        if (ptr == &chEpollWakeMarker) {
+            DrainSocketHandlerWake();
+            continue;
+        }
+        bool fListen = false;
+        BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
+            if (ptr == &hListenSocket) {
+                setListenReady.insert(hListenSocket.socket);
+                fListen = true;
+                break;
+            }
+        }
+        if (fListen)
+            continue;
+
+        CNode* pnode = (CNode*)ptr;
+        if (nFlags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            pnode->fSocketRecvReady = true;
+        if (nFlags & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+            pnode->fSocketSendReady = true;
+    }
+}
+#endif
+
 void ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+    // Whether a node still had data to receive or send after the last pass
+    bool fMoreWork = false;
+    // Whether a ready node was skipped because another thread held its buffers
+    bool fLockContended = false;
     while (true) {
         //
         // Disconnect nodes
@@ -902,88 +1184,23 @@ void ThreadSocketHandler()
         }
 
         //
-        // Find which sockets have data to receive
+        // Wait for socket events
         //
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH (CNode* pnode, vNodes) {
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
-                // * (if neither of the above applies, there is certainly one message
-                //   in the receiver buffer ready to be processed).
-                // Together, that means that at least one of the following is always possible,
-                // so we don't deadlock:
-                // * We send some data.
-                // * We wait for data to be received (and disconnect after timeout).
-                // * We process a message in the buffer (message handler thread).
-                {
-                    TRY_LOCK(pnode->cs_vSend, lockSend);
-                    if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
-                    }
-                }
-                {
-                    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    if (lockRecv && (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                                        pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-            &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
-        boost::this_thread::interruption_point();
-
-        if (nSelect == SOCKET_ERROR) {
-            if (have_fds) {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec / 1000);
-        }
+        std::set<SOCKET> setListenReady;
+#ifdef HAVE_SYS_EPOLL_H
+        if (nSocketEventsMode == SOCKETEVENTS_EPOLL)
+            SocketEventsEpoll(setListenReady, fMoreWork ? 0 : fLockContended ? SOCKET_EVENTS_CONTENDED_TIMEOUT : SOCKET_EVENTS_TIMEOUT);
+        else
+#endif
+            SocketEventsSelect(setListenReady);
+        fMoreWork = false;
+        fLockContended = false;
 
         //
         // Accept new connections
         //
         BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
+            if (hListenSocket.socket != INVALID_SOCKET && setListenReady.count(hListenSocket.socket)) {
                 struct sockaddr_storage sockaddr;
                 socklen_t len = sizeof(sockaddr);
                 SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
@@ -1006,7 +1223,7 @@ void ThreadSocketHandler()
                     int nErr = WSAGetLastError();
                     if (nErr != WSAEWOULDBLOCK)
                         LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
-                } else if (!IsSelectableSocket(hSocket)) {
+                } else if (nSocketEventsMode == SOCKETEVENTS_SELECT && !IsSelectableSocket(hSocket)) {
                     LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
                     CloseSocket(hSocket);
                 } else if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS) {
@@ -1046,9 +1263,17 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
+            if (pnode->fSocketRecvReady) {
+                bool fSendPending;
+                {
+                    TRY_LOCK(pnode->cs_vSend, lockSend);
+                    fSendPending = lockSend && !pnode->vSendMsg.empty();
+                }
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                if (lockRecv) {
+                if (!lockRecv) {
+                    // keep the ready flag, spinning on the lock would only starve its holder
+                    fLockContended = true;
+                } else if (!fSendPending && IsReceiveAllowed(pnode)) {
                     {
                         // typical socket buffer is 8K-64K
                         char pchBuf[0x10000];
@@ -1059,6 +1284,7 @@ void ThreadSocketHandler()
                             pnode->nLastRecv = GetTime();
                             pnode->nRecvBytes += nBytes;
                             pnode->RecordBytesRecv(nBytes);
+                            fMoreWork = true;
                         } else if (nBytes == 0) {
                             // socket closed gracefully
                             if (!pnode->fDisconnect)
@@ -1072,6 +1298,8 @@ void ThreadSocketHandler()
                                     LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
                                 pnode->CloseSocketDisconnect();
                             }
+                            if (nErr == WSAEWOULDBLOCK)
+                                pnode->fSocketRecvReady = false;
                         }
                     }
                 }
@@ -1082,10 +1310,16 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend)) {
+            if (pnode->fSocketSendReady) {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
-                if (lockSend)
+                if (!lockSend) {
+                    fLockContended = true;
+                } else if (!pnode->vSendMsg.empty()) {
                     SocketSendData(pnode);
+                    // a partial write means the socket buffer is full again
+                    if (!pnode->vSendMsg.empty())
+                        pnode->fSocketSendReady = false;
+                }
             }
 
             //
@@ -1493,7 +1727,7 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant* grantOu
 }
 
 
-void ThreadMessageHandler()
+void ThreadMessageHandler(int nThread)
 {
     boost::mutex condition_mutex;
     boost::unique_lock<boost::mutex> lock(condition_mutex);
@@ -1503,9 +1737,12 @@ void ThreadMessageHandler()
         vector<CNode*> vNodesCopy;
         {
             LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            BOOST_FOREACH (CNode* pnode, vNodesCopy) {
-                pnode->AddRef();
+            BOOST_FOREACH (CNode* pnode, vNodes) {
+                // Every peer is served by exactly one handler thread, so its
+                // messages are still processed in the order they arrived.
+                if (pnode->id % nMessageHandlerThreads != nThread)
+                    continue;
+                vNodesCopy.push_back(pnode->AddRef());
             }
         }
 
@@ -1524,9 +1761,14 @@ void ThreadMessageHandler()
             {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv) {
+                    bool fWasFlooded = !IsReceiveAllowed(pnode);
                     if (!g_signals.ProcessMessages(pnode))
                         pnode->CloseSocketDisconnect();
 
+                    // The socket handler stopped reading from this peer until we made room
+                    if (fWasFlooded && IsReceiveAllowed(pnode))
+                        WakeSocketHandler();
+
                     if (pnode->nSendSize < SendBufferSize()) {
                         if (!pnode->vRecvGetData.empty() || (!pnode->vRecvMsg.empty() && pnode->vRecvMsg[0].complete())) {
                             fSleep = false;
@@ -1758,6 +2000,7 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
     MapPort(GetBoolArg("-upnp", DEFAULT_UPNP));
 
     // Send and receive from sockets, accept connections
+    InitSocketEvents();
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "net", &ThreadSocketHandler));
 
     // Initiate outbound connections from -addnode
@@ -1767,7 +2010,12 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "opencon", &ThreadOpenConnections));
 
     // Process messages
-    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
+    nMessageHandlerThreads = std::max(1, std::min((int)GetArg("-msghandthreads", DEFAULT_MSGHANDLER_THREADS), MAX_MSGHANDLER_THREADS));
+    LogPrintf("Using %d threads for message handling\n", nMessageHandlerThreads);
+    for (int i = 0; i < nMessageHandlerThreads; i++) {
+        boost::function<void()> messageHandler = boost::bind(&ThreadMessageHandler, i);
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msghand", messageHandler));
+    }
 
     // Dump network addresses
     scheduler.scheduleEvery(&DumpData, DUMP_ADDRESSES_INTERVAL);
@@ -1822,6 +2070,19 @@ public:
         delete pnodeLocalHost;
         pnodeLocalHost = NULL;
 
+#ifdef HAVE_SYS_EPOLL_H
+        if (hEpoll != -1)
+            close(hEpoll);
+        hEpoll = -1;
+#endif
+#ifndef WIN32
+        for (int i = 0; i < 2; i++) {
+            if (hSocketHandlerWake[i] != -1)
+                close(hSocketHandlerWake[i]);
+            hSocketHandlerWake[i] = -1;
+        }
+#endif
+
 #ifdef WIN32
         // Shutdown Windows Sockets
         WSACleanup();
@@ -2088,6 +2349,9 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     nPingUsecTime = 0;
     fPingQueued = false;
     fObfuScationMaster = false;
+    fSocketRecvReady = false;
+    fSocketSendReady = false;
+    fSocketRegistered = false;
 
     {
         LOCK(cs_nLastNodeId);
@@ -2120,6 +2384,8 @@ void CNode::AskFor(const CInv& inv)
 {
     if (mapAskFor.size() > MAPASKFOR_MAX_SZ)
         return;
+    // Shared by all message handler threads
+    LOCK(cs_mapAlreadyAskedFor);
     // We're using mapAskFor as a priority queue,
     // the key is the earliest time the request can be sent
     int64_t nRequestTime;
@@ -2202,6 +2468,10 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
     if (it == vSendMsg.begin())
         SocketSendData(this);
 
+    // Whatever could not be written is sent by the socket handler
+    if (!vSendMsg.empty())
+        WakeSocketHandler();
+
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
 
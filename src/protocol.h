@@ -80,6 +80,14 @@ enum {
 
 	 NODE_BLOOM_WITHOUT_MN = (1 << 4),
 
+    // NODE_COMPACT_FILTERS means the node will answer getcfilters and getcfheaders
+    // with the basic block filters of BIP 157/158, as on bitcoin 0.19.
+    NODE_COMPACT_FILTERS = (1 << 6),
+
+    // NODE_MNSNAPSHOT means the node will answer mnsnapget with its whole masternode list,
+    // masternode winners or budget objects in a few hash-committed chunks.
+    NODE_MNSNAPSHOT = (1 << 7),
+
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
     // bitcoin-development mailing list. Remember that service bits are just
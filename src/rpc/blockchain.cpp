@@ -8,10 +8,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "base58.h"
+#include "blockfilter.h"
 #include "checkpoints.h"
 #include "clientversion.h"
 #include "main.h"
 #include "rpc/server.h"
+#include "snapshot.h"
 #include "sync.h"
 #include "txdb.h"
 #include "util.h"
@@ -191,6 +193,12 @@ UniValue mempoolToJSON(bool fVerbose = false)
             info.push_back(Pair("height", (int)e.GetHeight()));
             info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
             info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
+            info.push_back(Pair("descendantcount", e.GetCountWithDescendants()));
+            info.push_back(Pair("descendantsize", e.GetSizeWithDescendants()));
+            info.push_back(Pair("descendantfees", e.GetModFeesWithDescendants()));
+            info.push_back(Pair("ancestorcount", e.GetCountWithAncestors()));
+            info.push_back(Pair("ancestorsize", e.GetSizeWithAncestors()));
+            info.push_back(Pair("ancestorfees", e.GetModFeesWithAncestors()));
             const CTransaction& tx = e.GetTx();
             set<string> setDepends;
             BOOST_FOREACH (const CTxIn& txin, tx.vin) {
@@ -244,6 +252,12 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
             "    \"height\" : n,           (numeric) block height when transaction entered pool\n"
             "    \"startingpriority\" : n, (numeric) priority when transaction entered pool\n"
             "    \"currentpriority\" : n,  (numeric) transaction priority now\n"
+            "    \"descendantcount\" : n,  (numeric) number of in-mempool descendant transactions (including this one)\n"
+            "    \"descendantsize\" : n,   (numeric) size of in-mempool descendants (including this one)\n"
+            "    \"descendantfees\" : n,   (numeric) fees including prioritisetransaction deltas of in-mempool descendants (including this one)\n"
+            "    \"ancestorcount\" : n,    (numeric) number of in-mempool ancestor transactions (including this one)\n"
+            "    \"ancestorsize\" : n,     (numeric) size of in-mempool ancestors (including this one)\n"
+            "    \"ancestorfees\" : n,     (numeric) fees including prioritisetransaction deltas of in-mempool ancestors (including this one)\n"
             "    \"depends\" : [           (array) unconfirmed transactions used as inputs for this transaction\n"
             "        \"transactionid\",    (string) parent transaction id\n"
             "       ... ]\n"
@@ -408,13 +422,63 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     return blockheaderToJSON(pblockindex);
 }
 
+UniValue getblockfilter(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "getblockfilter \"hash\" ( \"filtertype\" )\n"
+            "\nRetrieve the BIP 158 content filter of a block. Requires -blockfilterindex.\n"
+
+            "\nArguments:\n"
+            "1. \"hash\"          (string, required) The block hash\n"
+            "2. \"filtertype\"    (string, optional, default=\"basic\") The type name of the filter\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"xxxx\",  (string) The hex-encoded filter data\n"
+            "  \"header\" : \"xxxx\"   (string) The hex-encoded filter header\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getblockfilter", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\" \"basic\"") +
+            HelpExampleRpc("getblockfilter", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\", \"basic\""));
+
+    uint256 hash(params[0].get_str());
+
+    if (params.size() > 1 && params[1].get_str() != "basic")
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+
+    if (!fBlockFilterIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype basic, start with -blockfilterindex");
+
+    CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = mapBlockIndex[hash];
+    }
+
+    CBlockFilter filter;
+    uint256 hashHeader;
+    if (!GetBlockFilter(pblockindex, filter, &hashHeader))
+        throw JSONRPCError(RPC_MISC_ERROR, "Filter not found. Block filters are still in the process of being indexed.");
+
+    const std::vector<unsigned char>& vchEncoded = filter.GetEncodedFilter();
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("filter", HexStr(vchEncoded.begin(), vchEncoded.end())));
+    ret.push_back(Pair("header", hashHeader.GetHex()));
+    return ret;
+}
+
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
         throw runtime_error(
             "gettxoutsetinfo\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "The statistics are maintained as blocks are connected, so this call is cheap once\n"
+            "they have been computed; the first call on an older data directory scans the whole set.\n"
 
             "\nResult:\n"
             "{\n"
@@ -423,7 +487,7 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
             "  \"transactions\": n,      (numeric) The number of transactions\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
             "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized\": \"hash\",   (string) Order-independent (MuHash) hash of the set\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
 
@@ -448,6 +512,98 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
     return ret;
 }
 
+static boost::filesystem::path GetSnapshotPath(const UniValue& param)
+{
+    boost::filesystem::path path(param.get_str());
+    if (!path.is_complete())
+        path = GetDataDir() / path;
+    return path;
+}
+
+static UniValue SnapshotMetadataToJSON(const CTxOutSetSnapshotMetadata& metadata, const uint256& hashSnapshot, const boost::filesystem::path& path)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("height", metadata.nHeight));
+    ret.push_back(Pair("bestblock", metadata.hashBlock.GetHex()));
+    ret.push_back(Pair("transactions", (int64_t)metadata.nCoins));
+    ret.push_back(Pair("hash_serialized", metadata.hashCoins.GetHex()));
+    ret.push_back(Pair("hash_snapshot", hashSnapshot.GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+UniValue dumptxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the unspent transaction output set at the current tip to a file, together with\n"
+            "the block and zerocoin state needed to continue from it (see loadtxoutset).\n"
+
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) Destination file, relative to the data directory if not absolute\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"height\":n,                 (numeric) The height of the snapshot block\n"
+            "  \"bestblock\": \"hex\",         (string) The hash of the snapshot block\n"
+            "  \"transactions\": n,          (numeric) The number of transactions with unspent outputs\n"
+            "  \"hash_serialized\": \"hash\",  (string) The hash_serialized of gettxoutsetinfo at that block\n"
+            "  \"hash_snapshot\": \"hash\",    (string) The hash of the whole snapshot, to pass to loadtxoutset\n"
+            "  \"path\": \"path\"              (string) The file written\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("dumptxoutset", "\"utxo.dat\"") + HelpExampleRpc("dumptxoutset", "\"utxo.dat\""));
+
+    boost::filesystem::path path = GetSnapshotPath(params[0]);
+    if (boost::filesystem::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    CTxOutSetSnapshotMetadata metadata;
+    uint256 hashSnapshot;
+    std::string strError;
+    if (!DumpTxOutSet(path, metadata, hashSnapshot, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    return SnapshotMetadataToJSON(metadata, hashSnapshot, path);
+}
+
+UniValue loadtxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw runtime_error(
+            "loadtxoutset \"path\" \"hash\"\n"
+            "\nReplace the chainstate with a snapshot written by dumptxoutset and continue syncing from\n"
+            "its block. The snapshot block and all its ancestors must already be stored, the current tip\n"
+            "must be one of them, and -txindex must be off. Blocks below the snapshot are not connected.\n"
+
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) Snapshot file, relative to the data directory if not absolute\n"
+            "2. \"hash\"    (string, required) The expected hash_snapshot that dumptxoutset reported for the snapshot block\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"height\":n,                 (numeric) The height of the snapshot block\n"
+            "  \"bestblock\": \"hex\",         (string) The hash of the snapshot block\n"
+            "  \"transactions\": n,          (numeric) The number of transactions with unspent outputs\n"
+            "  \"hash_serialized\": \"hash\",  (string) The hash_serialized of gettxoutsetinfo at the snapshot block\n"
+            "  \"hash_snapshot\": \"hash\",    (string) The verified hash of the whole snapshot\n"
+            "  \"path\": \"path\"              (string) The file loaded\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("loadtxoutset", "\"utxo.dat\" \"hash\"") + HelpExampleRpc("loadtxoutset", "\"utxo.dat\", \"hash\""));
+
+    boost::filesystem::path path = GetSnapshotPath(params[0]);
+    uint256 hashExpected = ParseHashV(params[1], "hash");
+
+    CTxOutSetSnapshotMetadata metadata;
+    std::string strError;
+    if (!LoadTxOutSet(path, hashExpected, metadata, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    return SnapshotMetadataToJSON(metadata, hashExpected, path);
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3)
@@ -785,7 +941,10 @@ UniValue mempoolInfoToJSON()
     UniValue ret(UniValue::VOBJ);
     ret.push_back(Pair("size", (int64_t) mempool.size()));
     ret.push_back(Pair("bytes", (int64_t) mempool.GetTotalTxSize()));
-    //ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
+    ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
+    size_t maxmempool = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+    ret.push_back(Pair("maxmempool", (int64_t) maxmempool));
+    ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK())));
 
     return ret;
 }
@@ -801,6 +960,9 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "{\n"
             "  \"size\": xxxxx                (numeric) Current tx count\n"
             "  \"bytes\": xxxxx               (numeric) Sum of all tx sizes\n"
+            "  \"usage\": xxxxx               (numeric) Total memory usage for the mempool\n"
+            "  \"maxmempool\": xxxxx          (numeric) Maximum memory usage for the mempool\n"
+            "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee per kB for a transaction to be accepted\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -809,6 +971,25 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
     return mempoolInfoToJSON();
 }
 
+UniValue savemempool(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "savemempool\n"
+            "\nDumps the mempool to disk, where it is loaded from on the next start (-persistmempool).\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("savemempool", "") + HelpExampleRpc("savemempool", ""));
+
+    if (!fMempoolLoaded)
+        throw JSONRPCError(RPC_MISC_ERROR, "The mempool was not loaded yet");
+
+    if (!DumpMempool())
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to dump mempool to disk");
+
+    return NullUniValue;
+}
+
 UniValue invalidateblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -603,13 +603,15 @@ UniValue mnbudgetvote(const UniValue& params, bool fHelp)
 
 UniValue getbudgetvotes(const UniValue& params, bool fHelp)
 {
-    if (params.size() != 1)
+    if (fHelp || params.size() < 1 || params.size() > 3)
         throw runtime_error(
-            "getbudgetvotes \"proposal-name\"\n"
+            "getbudgetvotes \"proposal-name\" ( start count )\n"
             "\nPrint vote information for a budget proposal\n"
 
             "\nArguments:\n"
             "1. \"proposal-name\":      (string, required) Name of the proposal\n"
+            "2. start                (numeric, optional, default=0) Number of votes to skip\n"
+            "3. count                (numeric, optional) Maximum number of votes to return, all if omitted\n"
 
             "\nResult:\n"
             "[\n"
@@ -628,14 +630,29 @@ UniValue getbudgetvotes(const UniValue& params, bool fHelp)
 
     std::string strProposalName = SanitizeString(params[0].get_str());
 
+    size_t nStart, nCount;
+    ParsePaging(params, 1, nStart, nCount);
+
     UniValue ret(UniValue::VARR);
 
-    CBudgetProposal* pbudgetProposal = budget.FindProposal(strProposalName);
+    // copy the requested page under budget.cs, the objects are built after releasing it
+    std::vector<std::pair<uint256, CBudgetVote> > vVotes;
+    {
+        LOCK(budget.cs);
+        CBudgetProposal* pbudgetProposal = budget.FindProposal(strProposalName);
 
-    if (pbudgetProposal == NULL) throw runtime_error("Unknown proposal name");
+        if (pbudgetProposal == NULL) throw runtime_error("Unknown proposal name");
 
-    std::map<uint256, CBudgetVote>::iterator it = pbudgetProposal->mapVotes.begin();
-    while (it != pbudgetProposal->mapVotes.end()) {
+        std::map<uint256, CBudgetVote>::iterator it = pbudgetProposal->mapVotes.begin();
+        for (size_t i = 0; i < nStart && it != pbudgetProposal->mapVotes.end(); i++)
+            it++;
+        while (it != pbudgetProposal->mapVotes.end() && vVotes.size() < nCount) {
+            vVotes.push_back(*it);
+            it++;
+        }
+    }
+
+    for (std::vector<std::pair<uint256, CBudgetVote> >::iterator it = vVotes.begin(); it != vVotes.end(); it++) {
         UniValue bObj(UniValue::VOBJ);
         bObj.push_back(Pair("mnId", (*it).second.vin.prevout.hash.ToString()));
         bObj.push_back(Pair("nHash", (*it).first.ToString().c_str()));
@@ -644,8 +661,6 @@ UniValue getbudgetvotes(const UniValue& params, bool fHelp)
         bObj.push_back(Pair("fValid", (*it).second.fValid));
 
         ret.push_back(bObj);
-
-        it++;
     }
 
     return ret;
@@ -734,13 +749,15 @@ UniValue getbudgetprojection(const UniValue& params, bool fHelp)
 
 UniValue getbudgetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 1)
+    if (fHelp || params.size() > 3)
         throw runtime_error(
-            "getbudgetinfo ( \"proposal\" )\n"
+            "getbudgetinfo ( \"proposal\" start count )\n"
             "\nShow current masternode budgets\n"
 
             "\nArguments:\n"
-            "1. \"proposal\"    (string, optional) Proposal name\n"
+            "1. \"proposal\"    (string, optional) Proposal name, \"\" to list all valid proposals\n"
+            "2. start         (numeric, optional, default=0) Number of proposals to skip when listing\n"
+            "3. count         (numeric, optional) Maximum number of proposals to return when listing, all if omitted\n"
 
             "\nResult:\n"
             "[\n"
@@ -769,12 +786,15 @@ UniValue getbudgetinfo(const UniValue& params, bool fHelp)
             "]\n"
 
             "\nExamples:\n" +
-            HelpExampleCli("getbudgetprojection", "") + HelpExampleRpc("getbudgetprojection", ""));
+            HelpExampleCli("getbudgetinfo", "") + HelpExampleCli("getbudgetinfo", "\"\" 0 20") + HelpExampleRpc("getbudgetinfo", ""));
+
+    size_t nStart, nCount;
+    ParsePaging(params, 1, nStart, nCount);
 
     UniValue ret(UniValue::VARR);
 
     std::string strShow = "valid";
-    if (params.size() == 1) {
+    if (params.size() >= 1 && params[0].get_str() != "") {
         std::string strProposalName = SanitizeString(params[0].get_str());
         CBudgetProposal* pbudgetProposal = budget.FindProposal(strProposalName);
         if (pbudgetProposal == NULL) throw runtime_error("Unknown proposal name");
@@ -784,9 +804,13 @@ UniValue getbudgetinfo(const UniValue& params, bool fHelp)
         return ret;
     }
 
+    // page before budgetToJSON, which revalidates each proposal against the chain
+    size_t nMatched = 0;
     std::vector<CBudgetProposal*> winningProps = budget.GetAllProposals();
     BOOST_FOREACH (CBudgetProposal* pbudgetProposal, winningProps) {
+        if (ret.size() >= nCount) break;
         if (strShow == "valid" && !pbudgetProposal->fValid) continue;
+        if (nMatched++ < nStart) continue;
 
         UniValue bObj(UniValue::VOBJ);
         budgetToJSON(pbudgetProposal, bObj);
@@ -102,6 +102,12 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"setban", 2},
         {"setban", 3},
         {"spork", 1},
+        {"listmasternodes", 1},
+        {"listmasternodes", 2},
+        {"getbudgetvotes", 1},
+        {"getbudgetvotes", 2},
+        {"getbudgetinfo", 1},
+        {"getbudgetinfo", 2},
         {"mnbudget", 3},
         {"mnbudget", 4},
         {"mnbudget", 6},
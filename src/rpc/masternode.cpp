@@ -20,6 +20,7 @@
 
 #include <boost/tokenizer.hpp>
 #include <fstream>
+#include <memory>
 
 UniValue getpoolinfo(const UniValue& params, bool fHelp)
 {
@@ -217,19 +218,84 @@ UniValue masternode(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+namespace
+{
+//! A masternode as listed by listmasternodes, with the fields the filter matches
+struct CMasternodeListEntry {
+    std::string strTxHash;
+    std::string strStatus;
+    std::string strAddr;
+    UniValue obj;
+};
+
+//! Entries of the last height listed, so the pages of a listing share one ranking
+CCriticalSection cs_listentries;
+int nListEntriesHeight = -1;
+std::shared_ptr<const std::vector<CMasternodeListEntry> > pListEntries;
+}
+
+static std::shared_ptr<const std::vector<CMasternodeListEntry> > GetListEntries(int nHeight)
+{
+    LOCK(cs_listentries);
+    if (pListEntries && nListEntriesHeight == nHeight)
+        return pListEntries;
+
+    // the ranks hold copies of the masternodes, taken under mnodeman.cs
+    std::vector<pair<int, CMasternode> > vMasternodeRanks = mnodeman.GetMasternodeRanks(nHeight);
+    std::shared_ptr<std::vector<CMasternodeListEntry> > pEntries = std::make_shared<std::vector<CMasternodeListEntry> >();
+    pEntries->reserve(vMasternodeRanks.size());
+    BOOST_FOREACH (PAIRTYPE(int, CMasternode) & s, vMasternodeRanks) {
+        CMasternode& mn = s.second;
+        CMasternodeListEntry entry;
+        entry.strTxHash = mn.vin.prevout.hash.ToString();
+        uint32_t oIdx = mn.vin.prevout.n;
+        entry.strStatus = mn.Status();
+        entry.strAddr = CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString();
+
+        std::string strHost;
+        int port;
+        SplitHostPort(mn.addr.ToString(), port, strHost);
+        CNetAddr node = CNetAddr(strHost, false);
+        std::string strNetwork = GetNetworkName(node.GetNetwork());
+
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("phase", (uint64_t)mn.GetPhase()));
+        obj.push_back(Pair("rank", (entry.strStatus == "ENABLED" ? s.first : 0)));
+        obj.push_back(Pair("network", strNetwork));
+        obj.push_back(Pair("txhash", entry.strTxHash));
+        obj.push_back(Pair("outidx", (uint64_t)oIdx));
+        obj.push_back(Pair("status", entry.strStatus));
+        obj.push_back(Pair("ip", mn.addr.ToStringIP()));
+        obj.push_back(Pair("addr", entry.strAddr));
+        obj.push_back(Pair("version", mn.protocolVersion));
+        obj.push_back(Pair("lastseen", (int64_t)mn.lastPing.sigTime));
+        obj.push_back(Pair("activetime", (int64_t)(mn.lastPing.sigTime - mn.sigTime)));
+        obj.push_back(Pair("lastpaid", (int64_t)mn.GetLastPaid()));
+        entry.obj = obj;
+
+        pEntries->push_back(entry);
+    }
+
+    pListEntries = pEntries;
+    nListEntriesHeight = nHeight;
+    return pListEntries;
+}
+
 UniValue listmasternodes(const UniValue& params, bool fHelp)
 {
     std::string strFilter = "";
 
-    if (params.size() == 1) strFilter = params[0].get_str();
+    if (params.size() >= 1) strFilter = params[0].get_str();
 
-    if (fHelp || (params.size() > 1))
+    if (fHelp || (params.size() > 3))
         throw runtime_error(
-            "listmasternodes ( \"filter\" )\n"
+            "listmasternodes ( \"filter\" start count )\n"
             "\nGet a ranked list of masternodes\n"
 
             "\nArguments:\n"
             "1. \"filter\"    (string, optional) Filter search text. Partial match by txhash, status, or addr.\n"
+            "2. start       (numeric, optional, default=0) Number of matching masternodes to skip\n"
+            "3. count       (numeric, optional) Maximum number of masternodes to return, all if omitted\n"
 
             "\nResult:\n"
             "[\n"
@@ -249,7 +315,10 @@ UniValue listmasternodes(const UniValue& params, bool fHelp)
             "]\n"
 
             "\nExamples:\n" +
-            HelpExampleCli("listmasternodes", "") + HelpExampleRpc("listmasternodes", ""));
+            HelpExampleCli("listmasternodes", "") + HelpExampleCli("listmasternodes", "\"\" 0 100") + HelpExampleRpc("listmasternodes", ""));
+
+    size_t nStart, nCount;
+    ParsePaging(params, 1, nStart, nCount);
 
     UniValue ret(UniValue::VARR);
     int nHeight;
@@ -259,42 +328,18 @@ UniValue listmasternodes(const UniValue& params, bool fHelp)
         if(!pindex) return 0;
         nHeight = pindex->nHeight;
     }
-    std::vector<pair<int, CMasternode> > vMasternodeRanks = mnodeman.GetMasternodeRanks(nHeight);
-    BOOST_FOREACH (PAIRTYPE(int, CMasternode) & s, vMasternodeRanks) {
-        UniValue obj(UniValue::VOBJ);
-        std::string strVin = s.second.vin.prevout.ToStringShort();
-        std::string strTxHash = s.second.vin.prevout.hash.ToString();
-        uint32_t oIdx = s.second.vin.prevout.n;
-
-        CMasternode* mn = mnodeman.Find(s.second.vin);
-
-        if (mn != NULL) {
-            if (strFilter != "" && strTxHash.find(strFilter) == string::npos &&
-                mn->Status().find(strFilter) == string::npos &&
-                CBitcoinAddress(mn->pubKeyCollateralAddress.GetID()).ToString().find(strFilter) == string::npos) continue;
-
-            std::string strStatus = mn->Status();
-            std::string strHost;
-            int port;
-            SplitHostPort(mn->addr.ToString(), port, strHost);
-            CNetAddr node = CNetAddr(strHost, false);
-            std::string strNetwork = GetNetworkName(node.GetNetwork());
-
-            obj.push_back (Pair ("phase", (uint64_t)mn->GetPhase ()));
-            obj.push_back(Pair("rank", (strStatus == "ENABLED" ? s.first : 0)));
-            obj.push_back(Pair("network", strNetwork));
-            obj.push_back(Pair("txhash", strTxHash));
-            obj.push_back(Pair("outidx", (uint64_t)oIdx));
-            obj.push_back(Pair("status", strStatus));
-			obj.push_back(Pair("ip", mn->addr.ToStringIP()));
-            obj.push_back(Pair("addr", CBitcoinAddress(mn->pubKeyCollateralAddress.GetID()).ToString()));
-            obj.push_back(Pair("version", mn->protocolVersion));
-            obj.push_back(Pair("lastseen", (int64_t)mn->lastPing.sigTime));
-            obj.push_back(Pair("activetime", (int64_t)(mn->lastPing.sigTime - mn->sigTime)));
-            obj.push_back(Pair("lastpaid", (int64_t)mn->GetLastPaid()));
-
-            ret.push_back(obj);
-        }
+    // built once per height, the pages only filter and slice it
+    std::shared_ptr<const std::vector<CMasternodeListEntry> > pEntries = GetListEntries(nHeight);
+    size_t nMatched = 0;
+    for (const CMasternodeListEntry& entry : *pEntries) {
+        if (ret.size() >= nCount) break;
+
+        if (strFilter != "" && entry.strTxHash.find(strFilter) == string::npos &&
+            entry.strStatus.find(strFilter) == string::npos &&
+            entry.strAddr.find(strFilter) == string::npos) continue;
+        if (nMatched++ < nStart) continue;
+
+        ret.push_back(entry.obj);
     }
 
     return ret;
@@ -54,8 +54,11 @@ UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const Un
 
 string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id)
 {
-    UniValue reply = JSONRPCReplyObj(result, error, id);
-    return reply.write() + "\n";
+    // Write the envelope around the result rather than copying a possibly large result into a reply object
+    std::string strReply = "{\"result\":";
+    strReply += error.isNull() ? result.write() : NullUniValue.write();
+    strReply += ",\"error\":" + error.write() + ",\"id\":" + id.write() + "}\n";
+    return strReply;
 }
 
 UniValue JSONRPCError(int code, const string& message)
@@ -791,7 +791,7 @@ UniValue sendrawtransaction(const UniValue& params, bool fHelp)
     if (!fHaveMempool && !fHaveChain) {
         // push to local node and sync with wallets
         if (fSwiftX) {
-            mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+            txLockManager.AddLockRequest(tx);
             CreateNewLock(tx);
             RelayTransactionLockReq(tx, true);
         }
@@ -17,6 +17,7 @@
 #include "ui_interface.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "validationinterface.h"
 
 #include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
@@ -181,6 +182,29 @@ bool ParseBool(const UniValue& o, string strKey)
     return v.get_bool();
 }
 
+void ParsePaging(const UniValue& params, unsigned int nIndex, size_t& nStart, size_t& nCount)
+{
+    nStart = 0;
+    nCount = std::numeric_limits<size_t>::max();
+
+    // accept numeric strings as well, for the legacy commands forwarding their arguments
+    for (unsigned int i = nIndex; i < params.size() && i < nIndex + 2; i++) {
+        const UniValue& v = params[i];
+        int n;
+        if (v.isNum())
+            n = v.get_int();
+        else if (!v.isStr() || !ParseInt32(v.get_str(), &n))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, start and count must be integers");
+        if (n < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, start and count must be non-negative");
+
+        if (i == nIndex)
+            nStart = n;
+        else
+            nCount = n;
+    }
+}
+
 
 /**
  * Note: This interface may still be subject to change.
@@ -307,13 +331,17 @@ static const CRPCCommand vRPCCommands[] =
         {"blockchain", "getblock", &getblock, true, false, false},
         {"blockchain", "getblockhash", &getblockhash, true, false, false},
         {"blockchain", "getblockheader", &getblockheader, false, false, false},
+        {"blockchain", "getblockfilter", &getblockfilter, true, false, false},
         {"blockchain", "getchaintips", &getchaintips, true, false, false},
         {"blockchain", "getdifficulty", &getdifficulty, true, false, false},
         {"blockchain", "getfeeinfo", &getfeeinfo, true, false, false},
         {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false},
         {"blockchain", "getrawmempool", &getrawmempool, true, false, false},
+        {"blockchain", "savemempool", &savemempool, true, false, false},
         {"blockchain", "gettxout", &gettxout, true, false, false},
         {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false},
+        {"blockchain", "dumptxoutset", &dumptxoutset, true, false, false},
+        {"blockchain", "loadtxoutset", &loadtxoutset, false, false, false},
         {"blockchain", "invalidateblock", &invalidateblock, true, true, false},
         {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false},
         {"blockchain", "verifychain", &verifychain, true, false, false},
@@ -575,6 +603,11 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    // Wallet commands must see the effects of every block and transaction
+    // accepted before they were issued.
+    if (pcmd->reqWallet)
+        SyncWithValidationInterfaceQueue();
+
     try {
         // Execute
         return pcmd->actor(params, false);
@@ -7,6 +7,7 @@
 #include "scheduler.h"
 
 #include "reverselock.h"
+#include "utiltime.h"
 
 #include <assert.h>
 #include <boost/bind.hpp>
@@ -132,3 +133,94 @@ size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
     }
     return result;
 }
+
+void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(callbacksMutex);
+        // Try to avoid scheduling too many copies here, but if we
+        // accidentally have two ProcessQueue's scheduled at once its
+        // not a big deal.
+        if (fCallbacksRunning || callbacksPending.empty())
+            return;
+    }
+    pscheduler->schedule(boost::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), boost::chrono::system_clock::now());
+}
+
+void SingleThreadedSchedulerClient::ProcessQueue()
+{
+    CScheduler::Function callback;
+    {
+        boost::unique_lock<boost::mutex> lock(callbacksMutex);
+        if (fCallbacksRunning || callbacksPending.empty())
+            return;
+        fCallbacksRunning = true;
+        callback = callbacksPending.front();
+        callbacksPending.pop_front();
+    }
+
+    // Release the running flag and queue up the next callback even if
+    // this one throws (e.g. boost::thread_interrupted on shutdown).
+    try {
+        callback();
+    } catch (...) {
+        {
+            boost::unique_lock<boost::mutex> lock(callbacksMutex);
+            fCallbacksRunning = false;
+        }
+        MaybeScheduleProcessQueue();
+        throw;
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(callbacksMutex);
+        fCallbacksRunning = false;
+    }
+    MaybeScheduleProcessQueue();
+}
+
+void SingleThreadedSchedulerClient::AddToProcessQueue(const CScheduler::Function& func)
+{
+    assert(pscheduler);
+    {
+        boost::unique_lock<boost::mutex> lock(callbacksMutex);
+        callbacksPending.push_back(func);
+    }
+    MaybeScheduleProcessQueue();
+}
+
+void SingleThreadedSchedulerClient::EmptyQueue()
+{
+    while (true) {
+        CScheduler::Function callback;
+        {
+            boost::unique_lock<boost::mutex> lock(callbacksMutex);
+            if (fCallbacksRunning) {
+                // The scheduler thread is still busy with a callback; wait
+                // for it rather than breaking the serial ordering.
+                reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
+                MilliSleep(1);
+                continue;
+            }
+            if (callbacksPending.empty())
+                return;
+            fCallbacksRunning = true;
+            callback = callbacksPending.front();
+            callbacksPending.pop_front();
+        }
+        try {
+            callback();
+        } catch (...) {
+            boost::unique_lock<boost::mutex> lock(callbacksMutex);
+            fCallbacksRunning = false;
+            throw;
+        }
+        boost::unique_lock<boost::mutex> lock(callbacksMutex);
+        fCallbacksRunning = false;
+    }
+}
+
+size_t SingleThreadedSchedulerClient::CallbacksPending()
+{
+    boost::unique_lock<boost::mutex> lock(callbacksMutex);
+    return callbacksPending.size();
+}
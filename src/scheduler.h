@@ -15,6 +15,7 @@
 #include <boost/function.hpp>
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
+#include <list>
 #include <map>
 
 //
@@ -82,4 +83,38 @@ private:
     bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
 };
 
+//
+// Class used by CScheduler clients which may schedule multiple jobs
+// which are required to be run serially. Jobs may not be run on the
+// same thread, but no two jobs will be executed at the same time and
+// they are executed in the order they were added.
+//
+class SingleThreadedSchedulerClient
+{
+public:
+    explicit SingleThreadedSchedulerClient(CScheduler* pschedulerIn) : pscheduler(pschedulerIn), fCallbacksRunning(false) {}
+
+    // Add a callback to be executed. Callbacks are executed serially
+    // and memory is released upon execution.
+    void AddToProcessQueue(const CScheduler::Function& func);
+
+    // Processes all remaining queue members on the calling thread,
+    // blocking until the queue has been emptied. Used at shutdown,
+    // when the scheduler thread may already have been stopped.
+    void EmptyQueue();
+
+    // Number of callbacks waiting to be executed.
+    size_t CallbacksPending();
+
+private:
+    CScheduler* pscheduler;
+
+    boost::mutex callbacksMutex;
+    std::list<CScheduler::Function> callbacksPending;
+    bool fCallbacksRunning;
+
+    void MaybeScheduleProcessQueue();
+    void ProcessQueue();
+};
+
 #endif
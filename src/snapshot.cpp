@@ -0,0 +1,430 @@
+// Copyright (c) 2021-2022 The LenoCore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "snapshot.h"
+
+#include "accumulators.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "hash.h"
+#include "main.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+/** Number of coin records written to the coin database per batch while loading */
+static const size_t SNAPSHOT_COINS_PER_BATCH = 100000;
+
+/** Block tree flag set while a snapshot is being written to the chainstate */
+static const std::string SNAPSHOT_LOADING_FLAG = "txoutsetloading";
+
+/** Serializes to or from a file, hashing everything that passes through */
+class CSnapshotFile
+{
+private:
+    CAutoFile& file;
+    //! Checksum of the whole file
+    CHash256 ctx;
+    //! Snapshot hash: everything but the coin records
+    CHash256 ctxSnapshot;
+
+public:
+    int nType;
+    int nVersion;
+    //! Whether what passes through now is part of the snapshot hash
+    bool fSnapshotHash;
+
+    explicit CSnapshotFile(CAutoFile& fileIn) : file(fileIn), nType(fileIn.GetType()), nVersion(fileIn.GetVersion()), fSnapshotHash(true) {}
+
+    CSnapshotFile& read(char* pch, size_t nSize)
+    {
+        file.read(pch, nSize);
+        ctx.Write((const unsigned char*)pch, nSize);
+        if (fSnapshotHash)
+            ctxSnapshot.Write((const unsigned char*)pch, nSize);
+        return (*this);
+    }
+
+    CSnapshotFile& write(const char* pch, size_t nSize)
+    {
+        file.write(pch, nSize);
+        ctx.Write((const unsigned char*)pch, nSize);
+        if (fSnapshotHash)
+            ctxSnapshot.Write((const unsigned char*)pch, nSize);
+        return (*this);
+    }
+
+    template <typename T>
+    CSnapshotFile& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+
+    template <typename T>
+    CSnapshotFile& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+
+    /** Write the hash of everything written so far */
+    void WriteChecksum()
+    {
+        uint256 hash;
+        ctx.Finalize((unsigned char*)&hash);
+        file << hash;
+    }
+
+    /** Compare the hash of everything read so far (returned in hash) with the stored one */
+    bool VerifyChecksum(uint256& hash)
+    {
+        uint256 hashFile;
+        ctx.Finalize((unsigned char*)&hash);
+        file >> hashFile;
+        return hash == hashFile;
+    }
+
+    /** The snapshot hash of everything read or written so far */
+    uint256 GetSnapshotHash()
+    {
+        uint256 hash;
+        ctxSnapshot.Finalize((unsigned char*)&hash);
+        return hash;
+    }
+};
+
+static bool WriteSnapshotCoins(CSnapshotFile* pfile, uint64_t* pnWritten, const uint256& txid, const CCoins& coins)
+{
+    *pfile << txid << coins;
+    (*pnWritten)++;
+    return true;
+}
+
+bool DumpTxOutSet(const boost::filesystem::path& path, CTxOutSetSnapshotMetadata& metadata, uint256& hashSnapshot, std::string& strError)
+{
+    boost::filesystem::path pathTmp = path;
+    pathTmp += ".incomplete";
+
+    CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        strError = "Unable to open " + pathTmp.string() + " for writing";
+        return false;
+    }
+
+    try {
+        CSnapshotFile file(fileout);
+        std::vector<std::pair<uint256, uint256> > vMints, vSpends;
+        std::vector<std::pair<uint32_t, CBigNum> > vAccumulatorValues;
+        boost::scoped_ptr<leveldb::Iterator> pcursor;
+        {
+            // Everything written must be from the same tip. The coin records
+            // are the bulk of the file; they are streamed from a database
+            // iterator taken here, which keeps seeing this state after
+            // cs_main is released.
+            LOCK(cs_main);
+            FlushStateToDisk();
+
+            CBlockIndex* pindexTip = chainActive.Tip();
+            CCoinsStats stats;
+            if (!pcoinsdbview->GetStats(stats)) {
+                strError = "Unable to read coin database statistics";
+                return false;
+            }
+            assert(stats.hashBlock == pindexTip->GetBlockHash());
+
+            if (!zerocoinDB->ReadCoinHashes('m', vMints) || !zerocoinDB->ReadCoinHashes('s', vSpends) ||
+                !zerocoinDB->ReadAccumulatorValues(vAccumulatorValues)) {
+                strError = "Unable to read zerocoin database";
+                return false;
+            }
+
+            metadata = CTxOutSetSnapshotMetadata();
+            metadata.hashBlock = pindexTip->GetBlockHash();
+            metadata.nHeight = pindexTip->nHeight;
+            metadata.nCoins = stats.nTransactions;
+            metadata.hashCoins = stats.hashSerialized;
+            metadata.nMints = vMints.size();
+            metadata.nSpends = vSpends.size();
+            metadata.nAccumulatorValues = vAccumulatorValues.size();
+
+            MessageStartChars pchMessageStart;
+            memcpy(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE);
+            file << FLATDATA(pchMessageStart) << metadata;
+
+            for (int nHeight = 1; nHeight <= pindexTip->nHeight; nHeight++) {
+                const CBlockIndex* pindex = chainActive[nHeight];
+                CSnapshotBlockState blockstate;
+                blockstate.hashBlock = pindex->GetBlockHash();
+                blockstate.nMint = pindex->nMint;
+                blockstate.nMoneySupply = pindex->nMoneySupply;
+                blockstate.mapZerocoinSupply = pindex->mapZerocoinSupply;
+                blockstate.vMintDenominationsInBlock = pindex->vMintDenominationsInBlock;
+                file << blockstate;
+            }
+
+            pcursor.reset(pcoinsdbview->NewCoinsIterator());
+        }
+
+        // The coin records are committed to through metadata.hashCoins
+        file.fSnapshotHash = false;
+        uint64_t nWritten = 0;
+        if (!pcoinsdbview->ForEachCoins(boost::bind(&WriteSnapshotCoins, &file, &nWritten, boost::placeholders::_1, boost::placeholders::_2), pcursor.get())) {
+            strError = "Unable to read coin database";
+            return false;
+        }
+        if (nWritten != metadata.nCoins) {
+            strError = strprintf("Coin database has %u entries, expected %u", nWritten, metadata.nCoins);
+            return false;
+        }
+        file.fSnapshotHash = true;
+
+        for (const std::pair<uint256, uint256>& mint : vMints)
+            file << mint;
+        for (const std::pair<uint256, uint256>& spend : vSpends)
+            file << spend;
+        for (const std::pair<uint32_t, CBigNum>& value : vAccumulatorValues)
+            file << value;
+        hashSnapshot = file.GetSnapshotHash();
+        file.WriteChecksum();
+    } catch (const std::exception& e) {
+        strError = strprintf("I/O error writing snapshot: %s", e.what());
+        return false;
+    }
+    fileout.fclose();
+
+    if (!RenameOver(pathTmp, path)) {
+        strError = "Unable to rename " + pathTmp.string() + " to " + path.string();
+        return false;
+    }
+    LogPrintf("%s: wrote %u coins at height %d to %s\n", __func__, metadata.nCoins, metadata.nHeight, path.string());
+    return true;
+}
+
+static bool ReadSnapshotMetadata(CSnapshotFile& file, CTxOutSetSnapshotMetadata& metadata, std::string& strError)
+{
+    MessageStartChars pchMessageStart;
+    file >> FLATDATA(pchMessageStart) >> metadata;
+    if (memcmp(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE) != 0) {
+        strError = "Snapshot is for a different network";
+        return false;
+    }
+    if (metadata.nVersion != TXOUTSET_SNAPSHOT_VERSION) {
+        strError = strprintf("Unsupported snapshot version %d", metadata.nVersion);
+        return false;
+    }
+    return true;
+}
+
+bool ReadTxOutSetMetadata(const boost::filesystem::path& path, CTxOutSetSnapshotMetadata& metadata, std::string& strError)
+{
+    CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        strError = "Unable to open " + path.string();
+        return false;
+    }
+    try {
+        CSnapshotFile file(filein);
+        return ReadSnapshotMetadata(file, metadata, strError);
+    } catch (const std::exception& e) {
+        strError = strprintf("Deserialize or I/O error reading snapshot: %s", e.what());
+        return false;
+    }
+}
+
+/**
+ * First pass: check the whole file without touching any state. Returns the
+ * file checksum, so the second pass can tell it reads the same file.
+ */
+static bool VerifyTxOutSet(const boost::filesystem::path& path, const uint256& hashExpected, CTxOutSetSnapshotMetadata& metadata, CBlockIndex*& pindexBase, uint256& hashFile, std::string& strError)
+{
+    CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        strError = "Unable to open " + path.string();
+        return false;
+    }
+
+    try {
+        CSnapshotFile file(filein);
+        if (!ReadSnapshotMetadata(file, metadata, strError))
+            return false;
+
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(metadata.hashBlock);
+            if (mi == mapBlockIndex.end() || mi->second->nHeight != metadata.nHeight) {
+                strError = strprintf("Snapshot block %s is not in the block index", metadata.hashBlock.GetHex());
+                return false;
+            }
+            pindexBase = mi->second;
+        }
+
+        // Ancestors of a block index entry never change, so no lock is needed from here
+        for (int nHeight = 1; nHeight <= metadata.nHeight; nHeight++) {
+            CSnapshotBlockState blockstate;
+            file >> blockstate;
+            if (blockstate.hashBlock != pindexBase->GetAncestor(nHeight)->GetBlockHash()) {
+                strError = strprintf("Snapshot chain differs from the block index at height %d", nHeight);
+                return false;
+            }
+        }
+
+        file.fSnapshotHash = false;
+        CCoinsDBStats stats;
+        for (uint64_t i = 0; i < metadata.nCoins; i++) {
+            if (i % SNAPSHOT_COINS_PER_BATCH == 0)
+                boost::this_thread::interruption_point();
+            uint256 txid;
+            CCoins coins;
+            file >> txid >> coins;
+            stats.Add(txid, coins);
+        }
+        if (stats.muhash.Finalize() != metadata.hashCoins) {
+            strError = "Snapshot coins do not match the snapshot hash";
+            return false;
+        }
+        file.fSnapshotHash = true;
+
+        std::pair<uint256, uint256> entry;
+        for (uint64_t i = 0; i < metadata.nMints + metadata.nSpends; i++)
+            file >> entry;
+        std::pair<uint32_t, CBigNum> value;
+        for (uint64_t i = 0; i < metadata.nAccumulatorValues; i++) {
+            file >> value;
+            if (GetChecksum(value.second) != value.first) {
+                strError = strprintf("Snapshot accumulator value %d does not match its checksum", value.first);
+                return false;
+            }
+        }
+        if (!file.VerifyChecksum(hashFile)) {
+            strError = "Snapshot checksum mismatch";
+            return false;
+        }
+        // The supply, zerocoin and accumulator state are only trusted through this
+        uint256 hashSnapshot = file.GetSnapshotHash();
+        if (hashSnapshot != hashExpected) {
+            strError = strprintf("Snapshot hash %s does not match the expected %s", hashSnapshot.GetHex(), hashExpected.GetHex());
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("Deserialize or I/O error reading snapshot: %s", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool LoadTxOutSet(const boost::filesystem::path& path, const uint256& hashExpected, CTxOutSetSnapshotMetadata& metadata, std::string& strError)
+{
+    CBlockIndex* pindexBase = NULL;
+    uint256 hashFile;
+    if (!VerifyTxOutSet(path, hashExpected, metadata, pindexBase, hashFile, strError))
+        return false;
+
+    LOCK(cs_main);
+    if (fTxIndex) {
+        strError = "Loading a snapshot requires -txindex=0, blocks below it are not indexed";
+        return false;
+    }
+    if (pindexBase->GetAncestor(chainActive.Height()) != chainActive.Tip() || chainActive.Height() >= pindexBase->nHeight) {
+        strError = "The active chain is not an ancestor of the snapshot block";
+        return false;
+    }
+    if (pindexBase->nChainTx == 0) {
+        strError = "Not all blocks up to the snapshot block are stored";
+        return false;
+    }
+
+    FlushStateToDisk();
+    CValidationState state;
+
+    // From here on the chainstate is being replaced; an interruption
+    // leaves it unusable and is detected at the next start.
+    pblocktree->WriteFlag(SNAPSHOT_LOADING_FLAG, true);
+
+    CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return state.Abort("Unable to reopen UTXO snapshot " + path.string());
+
+    try {
+        CSnapshotFile file(filein);
+        CTxOutSetSnapshotMetadata metadataCheck;
+        if (!ReadSnapshotMetadata(file, metadataCheck, strError) || metadataCheck.hashBlock != metadata.hashBlock)
+            return state.Abort("UTXO snapshot changed while loading");
+
+        for (int nHeight = 1; nHeight <= metadata.nHeight; nHeight++) {
+            CSnapshotBlockState blockstate;
+            file >> blockstate;
+            CBlockIndex* pindex = pindexBase->GetAncestor(nHeight);
+            if (blockstate.hashBlock != pindex->GetBlockHash())
+                return state.Abort("UTXO snapshot changed while loading");
+            pindex->nMint = blockstate.nMint;
+            pindex->nMoneySupply = blockstate.nMoneySupply;
+            pindex->mapZerocoinSupply = blockstate.mapZerocoinSupply;
+            pindex->vMintDenominationsInBlock = blockstate.vMintDenominationsInBlock;
+        }
+
+        if (!pcoinsdbview->WipeCoins())
+            return state.Abort("Unable to wipe the coin database");
+        CCoinsMap mapCoins;
+        for (uint64_t i = 0; i < metadata.nCoins; i++) {
+            uint256 txid;
+            CCoins coins;
+            file >> txid >> coins;
+            CCoinsCacheEntry& entry = mapCoins[txid];
+            entry.coins.swap(coins);
+            entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+            if (mapCoins.size() >= SNAPSHOT_COINS_PER_BATCH && !pcoinsdbview->BatchWrite(mapCoins, uint256(0)))
+                return state.Abort("Failed to write to coin database");
+        }
+        if (!pcoinsdbview->BatchWrite(mapCoins, metadata.hashBlock))
+            return state.Abort("Failed to write to coin database");
+
+        std::vector<std::pair<uint256, uint256> > vMints(metadata.nMints), vSpends(metadata.nSpends);
+        std::vector<std::pair<uint32_t, CBigNum> > vAccumulatorValues(metadata.nAccumulatorValues);
+        for (uint64_t i = 0; i < metadata.nMints; i++)
+            file >> vMints[i];
+        for (uint64_t i = 0; i < metadata.nSpends; i++)
+            file >> vSpends[i];
+        for (uint64_t i = 0; i < metadata.nAccumulatorValues; i++)
+            file >> vAccumulatorValues[i];
+        // Only what the first pass verified may be written
+        uint256 hashFileCheck;
+        if (!file.VerifyChecksum(hashFileCheck) || hashFileCheck != hashFile)
+            return state.Abort("UTXO snapshot changed while loading");
+
+        if (!zerocoinDB->WriteCoinHashes('m', vMints) || !zerocoinDB->WriteCoinHashes('s', vSpends))
+            return state.Abort("Failed to write to zerocoin database");
+        for (const std::pair<uint32_t, CBigNum>& value : vAccumulatorValues) {
+            if (!zerocoinDB->WriteAccumulatorValue(value.first, value.second))
+                return state.Abort("Failed to write to zerocoin database");
+        }
+    } catch (const std::exception& e) {
+        return state.Abort(strprintf("Deserialize or I/O error loading UTXO snapshot: %s", e.what()));
+    }
+
+    CCoinsStats stats;
+    if (!pcoinsdbview->GetStats(stats) || stats.hashSerialized != metadata.hashCoins)
+        return state.Abort("Loaded coin database does not match the UTXO snapshot");
+
+    pcoinsTip->SetBestBlock(metadata.hashBlock);
+    if (!ActivateSnapshotChain(state, pindexBase)) {
+        strError = "Failed to activate the snapshot chain";
+        return false;
+    }
+    pblocktree->WriteFlag(SNAPSHOT_LOADING_FLAG, false);
+
+    LogPrintf("%s: loaded %u coins at height %d from %s\n", __func__, metadata.nCoins, metadata.nHeight, path.string());
+    return true;
+}
+
+bool TxOutSetLoadInterrupted()
+{
+    bool fLoading = false;
+    return pblocktree->ReadFlag(SNAPSHOT_LOADING_FLAG, fLoading) && fLoading;
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2021-2022 The LenoCore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SNAPSHOT_H
+#define BITCOIN_SNAPSHOT_H
+
+#include "amount.h"
+#include "libzerocoin/Denominations.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+/** Version of the UTXO snapshot format written by dumptxoutset */
+static const int TXOUTSET_SNAPSHOT_VERSION = 1;
+
+/**
+ * Header of a UTXO snapshot. It is followed by one CSnapshotBlockState per
+ * block from height 1 to nHeight, nCoins (txid, CCoins) records, the
+ * zerocoin mint, spend and accumulator records and finally a double SHA256
+ * of everything before it.
+ *
+ * The snapshot hash that loadtxoutset checks is a double SHA256 of every
+ * section except the coin records, which it covers through hashCoins.
+ */
+class CTxOutSetSnapshotMetadata
+{
+public:
+    int nVersion;
+    //! Block the snapshot was taken at
+    uint256 hashBlock;
+    int nHeight;
+    //! Number of coin database records and their MuHash, as in gettxoutsetinfo
+    uint64_t nCoins;
+    uint256 hashCoins;
+    uint64_t nMints;
+    uint64_t nSpends;
+    uint64_t nAccumulatorValues;
+
+    CTxOutSetSnapshotMetadata() : nVersion(TXOUTSET_SNAPSHOT_VERSION), hashBlock(0), nHeight(0), nCoins(0), hashCoins(0), nMints(0), nSpends(0), nAccumulatorValues(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersionIn)
+    {
+        READWRITE(nVersion);
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(nCoins);
+        READWRITE(hashCoins);
+        READWRITE(nMints);
+        READWRITE(nSpends);
+        READWRITE(nAccumulatorValues);
+    }
+};
+
+/**
+ * Block index fields that are filled in when a block is connected. A node
+ * loading the snapshot never connects these blocks, so they are restored
+ * from here.
+ */
+class CSnapshotBlockState
+{
+public:
+    uint256 hashBlock;
+    int64_t nMint;
+    int64_t nMoneySupply;
+    std::map<libzerocoin::CoinDenomination, int64_t> mapZerocoinSupply;
+    std::vector<libzerocoin::CoinDenomination> vMintDenominationsInBlock;
+
+    CSnapshotBlockState() : hashBlock(0), nMint(0), nMoneySupply(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(hashBlock);
+        READWRITE(nMint);
+        READWRITE(nMoneySupply);
+        READWRITE(mapZerocoinSupply);
+        READWRITE(vMintDenominationsInBlock);
+    }
+};
+
+/** Read just the header of the snapshot at path */
+bool ReadTxOutSetMetadata(const boost::filesystem::path& path, CTxOutSetSnapshotMetadata& metadata, std::string& strError);
+
+/** Write the chainstate at the active tip to path and return its snapshot hash (dumptxoutset) */
+bool DumpTxOutSet(const boost::filesystem::path& path, CTxOutSetSnapshotMetadata& metadata, uint256& hashSnapshot, std::string& strError);
+
+/**
+ * Verify the snapshot at path against hashExpected (the snapshot hash
+ * dumptxoutset reported for its base block) and make it the chainstate
+ * (loadtxoutset). The base block and all its ancestors must already be
+ * stored, and the active tip must be one of them.
+ */
+bool LoadTxOutSet(const boost::filesystem::path& path, const uint256& hashExpected, CTxOutSetSnapshotMetadata& metadata, std::string& strError);
+
+/** Whether a LoadTxOutSet was interrupted, leaving a partial chainstate */
+bool TxOutSetLoadInterrupted();
+
+#endif // BITCOIN_SNAPSHOT_H
@@ -15,6 +15,8 @@
 #include "util.h"
 #include <boost/lexical_cast.hpp>
 
+#include <atomic>
+
 using namespace std;
 using namespace boost;
 
@@ -26,6 +28,53 @@ CSporkManager sporkManager;
 std::map<uint256, CSporkMessage> mapSporks;
 std::map<int, CSporkMessage> mapSporksActive;
 
+static int64_t GetSporkDefault(int nSporkID)
+{
+    if (nSporkID == SPORK_2_SWIFTTX) return SPORK_2_SWIFTTX_DEFAULT;
+    if (nSporkID == SPORK_3_SWIFTTX_BLOCK_FILTERING) return SPORK_3_SWIFTTX_BLOCK_FILTERING_DEFAULT;
+    if (nSporkID == SPORK_5_MAX_VALUE) return SPORK_5_MAX_VALUE_DEFAULT;
+    if (nSporkID == SPORK_7_MASTERNODE_SCANNING) return SPORK_7_MASTERNODE_SCANNING_DEFAULT;
+    if (nSporkID == SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT) return SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT;
+    if (nSporkID == SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT) return SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT_DEFAULT;
+    if (nSporkID == SPORK_10_MASTERNODE_PAY_UPDATED_NODES) return SPORK_10_MASTERNODE_PAY_UPDATED_NODES_DEFAULT;
+    if (nSporkID == SPORK_13_ENABLE_SUPERBLOCKS) return SPORK_13_ENABLE_SUPERBLOCKS_DEFAULT;
+    if (nSporkID == SPORK_14_NEW_PROTOCOL_ENFORCEMENT) return SPORK_14_NEW_PROTOCOL_ENFORCEMENT_DEFAULT;
+    if (nSporkID == SPORK_15_NEW_PROTOCOL_ENFORCEMENT_2) return SPORK_15_NEW_PROTOCOL_ENFORCEMENT_2_DEFAULT;
+    if (nSporkID == SPORK_16_ZEROCOIN_MAINTENANCE_MODE) return SPORK_16_ZEROCOIN_MAINTENANCE_MODE_DEFAULT;
+
+    return -1;
+}
+
+// Current value of every spork, indexed by nSporkID - SPORK_START. Mirrors mapSporksActive (or the
+// default) so validation can read sporks for every transaction without a map lookup or a lock.
+class CSporkValues
+{
+private:
+    std::atomic<int64_t> vValues[SPORK_END - SPORK_START + 1];
+
+public:
+    CSporkValues()
+    {
+        for (int i = SPORK_START; i <= SPORK_END; ++i)
+            vValues[i - SPORK_START] = GetSporkDefault(i);
+    }
+
+    bool Get(int nSporkID, int64_t& nValue) const
+    {
+        if (nSporkID < SPORK_START || nSporkID > SPORK_END) return false;
+        nValue = vValues[nSporkID - SPORK_START].load(std::memory_order_relaxed);
+        return true;
+    }
+
+    void Set(int nSporkID, int64_t nValue)
+    {
+        if (nSporkID < SPORK_START || nSporkID > SPORK_END) return;
+        vValues[nSporkID - SPORK_START].store(nValue, std::memory_order_relaxed);
+    }
+};
+
+static CSporkValues sporkValues;
+
 // LenoCore: on startup load spork values from previous session if they exist in the sporkDB
 void LoadSporksFromDB()
 {
@@ -44,6 +93,7 @@ void LoadSporksFromDB()
         // add spork to memory
         mapSporks[spork.GetHash()] = spork;
         mapSporksActive[spork.nSporkID] = spork;
+        sporkValues.Set(spork.nSporkID, spork.nValue);
         std::time_t result = spork.nValue;
         // If SPORK Value is greater than 1,000,000 assume it's actually a Date and then convert to a more readable format
         if (spork.nValue > 1000000) {
@@ -101,6 +151,7 @@ void ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 
         mapSporks[hash] = spork;
         mapSporksActive[spork.nSporkID] = spork;
+        sporkValues.Set(spork.nSporkID, spork.nValue);
         sporkManager.Relay(spork);
 
         // LenoCore: add to spork database.
@@ -122,23 +173,8 @@ int64_t GetSporkValue(int nSporkID)
 {
     int64_t r = -1;
 
-    if (mapSporksActive.count(nSporkID)) {
-        r = mapSporksActive[nSporkID].nValue;
-    } else {
-        if (nSporkID == SPORK_2_SWIFTTX) r = SPORK_2_SWIFTTX_DEFAULT;
-        if (nSporkID == SPORK_3_SWIFTTX_BLOCK_FILTERING) r = SPORK_3_SWIFTTX_BLOCK_FILTERING_DEFAULT;
-        if (nSporkID == SPORK_5_MAX_VALUE) r = SPORK_5_MAX_VALUE_DEFAULT;
-        if (nSporkID == SPORK_7_MASTERNODE_SCANNING) r = SPORK_7_MASTERNODE_SCANNING_DEFAULT;
-        if (nSporkID == SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT) r = SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT;
-        if (nSporkID == SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT) r = SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT_DEFAULT;
-        if (nSporkID == SPORK_10_MASTERNODE_PAY_UPDATED_NODES) r = SPORK_10_MASTERNODE_PAY_UPDATED_NODES_DEFAULT;
-        if (nSporkID == SPORK_13_ENABLE_SUPERBLOCKS) r = SPORK_13_ENABLE_SUPERBLOCKS_DEFAULT;
-        if (nSporkID == SPORK_14_NEW_PROTOCOL_ENFORCEMENT) r = SPORK_14_NEW_PROTOCOL_ENFORCEMENT_DEFAULT;
-        if (nSporkID == SPORK_15_NEW_PROTOCOL_ENFORCEMENT_2) r = SPORK_15_NEW_PROTOCOL_ENFORCEMENT_2_DEFAULT;
-        if (nSporkID == SPORK_16_ZEROCOIN_MAINTENANCE_MODE) r = SPORK_16_ZEROCOIN_MAINTENANCE_MODE_DEFAULT;
-
-        if (r == -1) LogPrintf("%s : Unknown Spork %d\n", __func__, nSporkID);
-    }
+    if (!sporkValues.Get(nSporkID, r) || r == -1)
+        LogPrintf("%s : Unknown Spork %d\n", __func__, nSporkID);
 
     return r;
 }
@@ -241,6 +277,7 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue)
         Relay(msg);
         mapSporks[msg.GetHash()] = msg;
         mapSporksActive[nSporkID] = msg;
+        sporkValues.Set(nSporkID, nValue);
         return true;
     }
 
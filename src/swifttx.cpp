@@ -22,11 +22,7 @@
 using namespace std;
 using namespace boost;
 
-std::map<uint256, CTransaction> mapTxLockReq;
-std::map<uint256, CTransaction> mapTxLockReqRejected;
-std::map<uint256, CConsensusVote> mapTxLockVote;
-std::map<uint256, CTransactionLock> mapTxLocks;
-std::map<COutPoint, uint256> mapLockedInputs;
+CTxLockManager txLockManager;
 std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
 int nCompleteTXLocks;
 
@@ -53,7 +49,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         pfrom->AddInventoryKnown(inv);
         GetMainSignals().Inventory(inv.hash);
 
-        if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash())) {
+        if (txLockManager.HasLockRequest(tx.GetHash()) || txLockManager.HasRejectedLockRequest(tx.GetHash())) {
             return;
         }
 
@@ -85,20 +81,20 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
 
             DoConsensusVote(tx, nBlockHeight);
 
-            mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+            txLockManager.AddLockRequest(tx);
 
             LogPrintf("ProcessMessageSwiftTX::ix - Transaction Lock Request: %s %s : accepted %s\n",
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
                 tx.GetHash().ToString().c_str());
 
             if (GetTransactionLockSignatures(tx.GetHash()) == SWIFTTX_SIGNATURES_REQUIRED) {
-                GetMainSignals().NotifyTransactionLock(tx);
+                SignalTransactionLock(tx);
             }
 
             return;
 
         } else {
-            mapTxLockReqRejected.insert(make_pair(tx.GetHash(), tx));
+            txLockManager.AddRejectedLockRequest(tx);
 
             // can we get the conflicting transaction as proof?
 
@@ -106,24 +102,17 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
                 tx.GetHash().ToString().c_str());
 
-            BOOST_FOREACH (const CTxIn& in, tx.vin) {
-                if (!mapLockedInputs.count(in.prevout)) {
-                    mapLockedInputs.insert(make_pair(in.prevout, tx.GetHash()));
-                }
-            }
+            txLockManager.LockInputs(tx, tx.GetHash());
 
             // resolve conflicts
-            std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
-            if (i != mapTxLocks.end()) {
-                //we only care if we have a complete tx lock
-                if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-                    if (!CheckForConflictingLocks(tx)) {
-                        LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
-
-                        //reprocess the last 15 blocks
-                        ReprocessBlocks(15);
-                        mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
-                    }
+            //we only care if we have a complete tx lock
+            if (txLockManager.GetLockSignatures(tx.GetHash()) >= SWIFTTX_SIGNATURES_REQUIRED) {
+                if (!CheckForConflictingLocks(tx)) {
+                    LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
+
+                    //reprocess the last 15 blocks
+                    ReprocessBlocks(15);
+                    txLockManager.AddLockRequest(tx);
                 }
             }
 
@@ -137,12 +126,10 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockVote.count(ctx.GetHash())) {
+        if (!txLockManager.AddVote(ctx)) {
             return;
         }
 
-        mapTxLockVote.insert(make_pair(ctx.GetHash(), ctx));
-
         if (ProcessConsensusVote(pfrom, ctx)) {
             //Spam/Dos protection
             /*
@@ -150,7 +137,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 This tracks those messages and allows it at the same rate of the rest of the network, if
                 a peer violates it, it will simply be ignored
             */
-            if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
+            if (!txLockManager.HasLockRequest(ctx.txHash) && !txLockManager.HasRejectedLockRequest(ctx.txHash)) {
                 if (!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash)) {
                     mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
                 }
@@ -168,8 +155,9 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
             RelayInv(inv);
         }
 
-        if (mapTxLockReq.count(ctx.txHash) && GetTransactionLockSignatures(ctx.txHash) == SWIFTTX_SIGNATURES_REQUIRED) {
-            GetMainSignals().NotifyTransactionLock(mapTxLockReq[ctx.txHash]);
+        CTransaction tx;
+        if (GetTransactionLockSignatures(ctx.txHash) == SWIFTTX_SIGNATURES_REQUIRED && txLockManager.GetLockRequest(ctx.txHash, tx)) {
+            SignalTransactionLock(tx);
         }
 
         return;
@@ -242,19 +230,12 @@ int64_t CreateNewLock(CTransaction tx)
     */
     int nBlockHeight = (chainActive.Tip()->nHeight - nTxAge) + 4;
 
-    if (!mapTxLocks.count(tx.GetHash())) {
+    if (!txLockManager.HasLock(tx.GetHash()))
         LogPrintf("CreateNewLock - New Transaction Lock %s !\n", tx.GetHash().ToString().c_str());
-
-        CTransactionLock newLock;
-        newLock.nBlockHeight = nBlockHeight;
-        newLock.nExpiration = GetTime() + (60 * 60); //locks expire after 60 minutes (24 confirmations)
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = tx.GetHash();
-        mapTxLocks.insert(make_pair(tx.GetHash(), newLock));
-    } else {
-        mapTxLocks[tx.GetHash()].nBlockHeight = nBlockHeight;
+    else
         LogPrint("swiftx", "CreateNewLock - Transaction Lock Exists %s !\n", tx.GetHash().ToString().c_str());
-    }
+
+    txLockManager.SetLockHeight(tx.GetHash(), nBlockHeight);
 
 
     return nBlockHeight;
@@ -295,7 +276,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
         return;
     }
 
-    mapTxLockVote[ctx.GetHash()] = ctx;
+    txLockManager.AddVote(ctx);
 
     CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
     RelayInv(inv);
@@ -329,68 +310,51 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
         return false;
     }
 
-    if (!mapTxLocks.count(ctx.txHash)) {
+    if (!txLockManager.HasLock(ctx.txHash))
         LogPrintf("SwiftX::ProcessConsensusVote - New Transaction Lock %s !\n", ctx.txHash.ToString().c_str());
-
-        CTransactionLock newLock;
-        newLock.nBlockHeight = 0;
-        newLock.nExpiration = GetTime() + (60 * 60);
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = ctx.txHash;
-        mapTxLocks.insert(make_pair(ctx.txHash, newLock));
-    } else
+    else
         LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Exists %s !\n", ctx.txHash.ToString().c_str());
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
-    if (i != mapTxLocks.end()) {
-        (*i).second.AddSignature(ctx);
+    int nSignatures = txLockManager.AddLockSignature(ctx);
 
 #ifdef ENABLE_WALLET
-        if (pwalletMain) {
-            //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
-            if (pwalletMain->mapRequestCount.count(ctx.txHash))
-                pwalletMain->mapRequestCount[ctx.txHash]++;
-        }
+    if (pwalletMain) {
+        //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
+        if (pwalletMain->mapRequestCount.count(ctx.txHash))
+            pwalletMain->mapRequestCount[ctx.txHash]++;
+    }
 #endif
 
-        LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", (*i).second.CountSignatures(), ctx.GetHash().ToString().c_str());
+    LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", nSignatures, ctx.GetHash().ToString().c_str());
 
-        if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-            LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", (*i).second.GetHash().ToString().c_str());
+    if (nSignatures >= SWIFTTX_SIGNATURES_REQUIRED) {
+        LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", ctx.txHash.ToString().c_str());
 
-            CTransaction& tx = mapTxLockReq[ctx.txHash];
-            if (!CheckForConflictingLocks(tx)) {
+        CTransaction tx;
+        bool fHaveTx = txLockManager.GetLockRequest(ctx.txHash, tx);
+        if (!CheckForConflictingLocks(tx)) {
 #ifdef ENABLE_WALLET
-                if (pwalletMain) {
-                    if (pwalletMain->UpdatedTransaction((*i).second.txHash)) {
-                        nCompleteTXLocks++;
-                    }
+            if (pwalletMain) {
+                if (pwalletMain->UpdatedTransaction(ctx.txHash)) {
+                    nCompleteTXLocks++;
                 }
+            }
 #endif
 
-                if (mapTxLockReq.count(ctx.txHash)) {
-                    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-                        if (!mapLockedInputs.count(in.prevout)) {
-                            mapLockedInputs.insert(make_pair(in.prevout, ctx.txHash));
-                        }
-                    }
-                }
+            if (fHaveTx)
+                txLockManager.LockInputs(tx, ctx.txHash);
 
-                // resolve conflicts
+            // resolve conflicts
 
-                //if this tx lock was rejected, we need to remove the conflicting blocks
-                if (mapTxLockReqRejected.count((*i).second.txHash)) {
-                    //reprocess the last 15 blocks
-                    ReprocessBlocks(15);
-                }
+            //if this tx lock was rejected, we need to remove the conflicting blocks
+            if (txLockManager.HasRejectedLockRequest(ctx.txHash)) {
+                //reprocess the last 15 blocks
+                ReprocessBlocks(15);
             }
         }
-        return true;
     }
-
-
-    return false;
+    return true;
 }
 
 bool CheckForConflictingLocks(CTransaction& tx)
@@ -402,15 +366,12 @@ bool CheckForConflictingLocks(CTransaction& tx)
         Blocks could have been rejected during this time, which is OK. After they cancel out, the client will
         rescan the blocks and find they're acceptable and then take the chain with the most work.
     */
-    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                LogPrintf("SwiftX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), mapLockedInputs[in.prevout].ToString().c_str());
-                if (mapTxLocks.count(tx.GetHash())) mapTxLocks[tx.GetHash()].nExpiration = GetTime();
-                if (mapTxLocks.count(mapLockedInputs[in.prevout])) mapTxLocks[mapLockedInputs[in.prevout]].nExpiration = GetTime();
-                return true;
-            }
-        }
+    uint256 txHashConflict;
+    if (txLockManager.HasConflictingLock(tx, txHashConflict)) {
+        LogPrintf("SwiftX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), txHashConflict.ToString().c_str());
+        txLockManager.ExpireLock(tx.GetHash());
+        txLockManager.ExpireLock(txHashConflict);
+        return true;
     }
 
     return false;
@@ -435,30 +396,7 @@ void CleanTransactionLocksList()
 {
     if (chainActive.Tip() == NULL) return;
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
-
-    while (it != mapTxLocks.end()) {
-        if (GetTime() > it->second.nExpiration) { //keep them for an hour
-            LogPrintf("Removing old transaction lock %s\n", it->second.txHash.ToString().c_str());
-
-            if (mapTxLockReq.count(it->second.txHash)) {
-                CTransaction& tx = mapTxLockReq[it->second.txHash];
-
-                BOOST_FOREACH (const CTxIn& in, tx.vin)
-                    mapLockedInputs.erase(in.prevout);
-
-                mapTxLockReq.erase(it->second.txHash);
-                mapTxLockReqRejected.erase(it->second.txHash);
-
-                BOOST_FOREACH (CConsensusVote& v, it->second.vecConsensusVotes)
-                    mapTxLockVote.erase(v.GetHash());
-            }
-
-            mapTxLocks.erase(it++);
-        } else {
-            it++;
-        }
-    }
+    txLockManager.Clean();
 }
 
 int GetTransactionLockSignatures(uint256 txHash)
@@ -466,10 +404,7 @@ int GetTransactionLockSignatures(uint256 txHash)
     if(fLargeWorkForkFound || fLargeWorkInvalidChainFound) return -2;
     if (!IsSporkActive(SPORK_2_SWIFTTX)) return -1;
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.find(txHash);
-    if(it != mapTxLocks.end()) return it->second.CountSignatures();
-
-    return -1;
+    return txLockManager.GetLockSignatures(txHash);
 }
 
 uint256 CConsensusVote::GetHash() const
@@ -552,12 +487,24 @@ bool CTransactionLock::SignaturesValid()
     return true;
 }
 
-void CTransactionLock::AddSignature(CConsensusVote& cv)
+void CTransactionLock::AddSignature(const CConsensusVote& cv)
 {
     vecConsensusVotes.push_back(cv);
+    if (cv.nBlockHeight == nBlockHeight) nSignatures++;
+}
+
+void CTransactionLock::SetBlockHeight(int nBlockHeightIn)
+{
+    if (nBlockHeightIn == nBlockHeight) return;
+
+    nBlockHeight = nBlockHeightIn;
+    nSignatures = 0;
+    BOOST_FOREACH (const CConsensusVote& v, vecConsensusVotes) {
+        if (v.nBlockHeight == nBlockHeight) nSignatures++;
+    }
 }
 
-int CTransactionLock::CountSignatures()
+int CTransactionLock::CountSignatures() const
 {
     /*
         Only count signatures where the BlockHeight matches the transaction's blockheight.
@@ -566,11 +513,281 @@ int CTransactionLock::CountSignatures()
 
     if (nBlockHeight == 0) return -1;
 
-    int n = 0;
-    BOOST_FOREACH (CConsensusVote v, vecConsensusVotes) {
-        if (v.nBlockHeight == nBlockHeight) {
-            n++;
+    return nSignatures;
+}
+
+void CTxLockManager::ScheduleExpiry(const uint256& txHash, int64_t nTime)
+{
+    LOCK(cs_expiry);
+    mapTxExpiry.insert(std::make_pair(nTime, txHash));
+}
+
+void CTxLockManager::AddLockRequest(const CTransaction& tx)
+{
+    uint256 txHash = tx.GetHash();
+    {
+        CTxShard& shard = TxShard(txHash);
+        LOCK(shard.cs);
+        if (!shard.mapTxLockReq.insert(std::make_pair(txHash, tx)).second) return;
+    }
+    ScheduleExpiry(txHash, GetTime() + (60 * 60));
+}
+
+void CTxLockManager::AddRejectedLockRequest(const CTransaction& tx)
+{
+    uint256 txHash = tx.GetHash();
+    {
+        CTxShard& shard = TxShard(txHash);
+        LOCK(shard.cs);
+        if (!shard.mapTxLockReqRejected.insert(std::make_pair(txHash, tx)).second) return;
+    }
+    ScheduleExpiry(txHash, GetTime() + (60 * 60));
+}
+
+bool CTxLockManager::HasLockRequest(const uint256& txHash) const
+{
+    const CTxShard& shard = TxShard(txHash);
+    LOCK(shard.cs);
+    return shard.mapTxLockReq.count(txHash);
+}
+
+bool CTxLockManager::HasRejectedLockRequest(const uint256& txHash) const
+{
+    const CTxShard& shard = TxShard(txHash);
+    LOCK(shard.cs);
+    return shard.mapTxLockReqRejected.count(txHash);
+}
+
+bool CTxLockManager::GetLockRequest(const uint256& txHash, CTransaction& tx) const
+{
+    const CTxShard& shard = TxShard(txHash);
+    LOCK(shard.cs);
+    boost::unordered_map<uint256, CTransaction, CCoinsKeyHasher>::const_iterator it = shard.mapTxLockReq.find(txHash);
+    if (it == shard.mapTxLockReq.end()) return false;
+    tx = it->second;
+    return true;
+}
+
+bool CTxLockManager::AddVote(const CConsensusVote& vote)
+{
+    uint256 hash = vote.GetHash();
+    {
+        CVoteShard& shard = VoteShard(hash);
+        LOCK(shard.cs);
+        if (!shard.mapTxLockVote.insert(std::make_pair(hash, vote)).second) return false;
+    }
+
+    // votes that never make it into a lock are dropped after an hour as well
+    LOCK(cs_expiry);
+    mapVoteExpiry.insert(std::make_pair(GetTime() + (60 * 60), hash));
+    return true;
+}
+
+bool CTxLockManager::HasVote(const uint256& hash) const
+{
+    const CVoteShard& shard = VoteShard(hash);
+    LOCK(shard.cs);
+    return shard.mapTxLockVote.count(hash);
+}
+
+bool CTxLockManager::GetVote(const uint256& hash, CConsensusVote& vote) const
+{
+    const CVoteShard& shard = VoteShard(hash);
+    LOCK(shard.cs);
+    boost::unordered_map<uint256, CConsensusVote, CCoinsKeyHasher>::const_iterator it = shard.mapTxLockVote.find(hash);
+    if (it == shard.mapTxLockVote.end()) return false;
+    vote = it->second;
+    return true;
+}
+
+void CTxLockManager::SetLockHeight(const uint256& txHash, int nBlockHeight)
+{
+    {
+        CTxShard& shard = TxShard(txHash);
+        LOCK(shard.cs);
+        boost::unordered_map<uint256, CTransactionLock, CCoinsKeyHasher>::iterator it = shard.mapTxLocks.find(txHash);
+        if (it != shard.mapTxLocks.end()) {
+            it->second.SetBlockHeight(nBlockHeight);
+            return;
+        }
+
+        CTransactionLock& newLock = shard.mapTxLocks[txHash];
+        newLock.SetBlockHeight(nBlockHeight);
+        newLock.nExpiration = GetTime() + (60 * 60); //locks expire after 60 minutes (24 confirmations)
+        newLock.nTimeout = GetTime() + (60 * 5);
+        newLock.txHash = txHash;
+    }
+    ScheduleExpiry(txHash, GetTime() + (60 * 60));
+}
+
+int CTxLockManager::AddLockSignature(const CConsensusVote& vote)
+{
+    int nSignatures;
+    bool fNewLock;
+    {
+        CTxShard& shard = TxShard(vote.txHash);
+        LOCK(shard.cs);
+        boost::unordered_map<uint256, CTransactionLock, CCoinsKeyHasher>::iterator it = shard.mapTxLocks.find(vote.txHash);
+        fNewLock = it == shard.mapTxLocks.end();
+        if (fNewLock) {
+            CTransactionLock newLock;
+            newLock.nExpiration = GetTime() + (60 * 60);
+            newLock.nTimeout = GetTime() + (60 * 5);
+            newLock.txHash = vote.txHash;
+            it = shard.mapTxLocks.insert(std::make_pair(vote.txHash, newLock)).first;
+        }
+        it->second.AddSignature(vote);
+        nSignatures = it->second.CountSignatures();
+    }
+    if (fNewLock) ScheduleExpiry(vote.txHash, GetTime() + (60 * 60));
+    return nSignatures;
+}
+
+bool CTxLockManager::HasLock(const uint256& txHash) const
+{
+    const CTxShard& shard = TxShard(txHash);
+    LOCK(shard.cs);
+    return shard.mapTxLocks.count(txHash);
+}
+
+int CTxLockManager::GetLockSignatures(const uint256& txHash) const
+{
+    const CTxShard& shard = TxShard(txHash);
+    LOCK(shard.cs);
+    boost::unordered_map<uint256, CTransactionLock, CCoinsKeyHasher>::const_iterator it = shard.mapTxLocks.find(txHash);
+    if (it == shard.mapTxLocks.end()) return -1;
+    return it->second.CountSignatures();
+}
+
+bool CTxLockManager::IsLockTimedOut(const uint256& txHash) const
+{
+    const CTxShard& shard = TxShard(txHash);
+    LOCK(shard.cs);
+    boost::unordered_map<uint256, CTransactionLock, CCoinsKeyHasher>::const_iterator it = shard.mapTxLocks.find(txHash);
+    if (it == shard.mapTxLocks.end()) return false;
+    return GetTime() > it->second.nTimeout;
+}
+
+void CTxLockManager::ExpireLock(const uint256& txHash)
+{
+    {
+        CTxShard& shard = TxShard(txHash);
+        LOCK(shard.cs);
+        boost::unordered_map<uint256, CTransactionLock, CCoinsKeyHasher>::iterator it = shard.mapTxLocks.find(txHash);
+        if (it == shard.mapTxLocks.end()) return;
+        it->second.nExpiration = GetTime();
+    }
+    ScheduleExpiry(txHash, GetTime());
+}
+
+void CTxLockManager::LockInputs(const CTransaction& tx, const uint256& txHash)
+{
+    BOOST_FOREACH (const CTxIn& in, tx.vin) {
+        CInputShard& shard = InputShard(in.prevout);
+        LOCK(shard.cs);
+        if (shard.mapLockedInputs.insert(std::make_pair(in.prevout, txHash)).second)
+            nLockedInputs++;
+    }
+}
+
+void CTxLockManager::UnlockInputs(const CTransaction& tx)
+{
+    uint256 txHash = tx.GetHash();
+    BOOST_FOREACH (const CTxIn& in, tx.vin) {
+        CInputShard& shard = InputShard(in.prevout);
+        LOCK(shard.cs);
+        boost::unordered_map<COutPoint, uint256, COutPointHasher>::iterator it = shard.mapLockedInputs.find(in.prevout);
+        if (it != shard.mapLockedInputs.end() && it->second == txHash) {
+            shard.mapLockedInputs.erase(it);
+            nLockedInputs--;
+        }
+    }
+}
+
+bool CTxLockManager::HasConflictingLock(const CTransaction& tx, uint256& txHashConflict) const
+{
+    if (nLockedInputs == 0) return false;
+
+    uint256 txHash = tx.GetHash();
+    BOOST_FOREACH (const CTxIn& in, tx.vin) {
+        const CInputShard& shard = InputShard(in.prevout);
+        LOCK(shard.cs);
+        boost::unordered_map<COutPoint, uint256, COutPointHasher>::const_iterator it = shard.mapLockedInputs.find(in.prevout);
+        if (it != shard.mapLockedInputs.end() && it->second != txHash) {
+            txHashConflict = it->second;
+            return true;
         }
     }
-    return n;
+
+    return false;
+}
+
+void CTxLockManager::RemoveTx(const uint256& txHash)
+{
+    std::vector<CTransaction> vTx;
+    std::vector<CConsensusVote> vVotes;
+    {
+        CTxShard& shard = TxShard(txHash);
+        LOCK(shard.cs);
+
+        // a lock that is still current keeps everything, its own expiry entry drops it later
+        boost::unordered_map<uint256, CTransactionLock, CCoinsKeyHasher>::iterator itLock = shard.mapTxLocks.find(txHash);
+        if (itLock != shard.mapTxLocks.end()) {
+            if (GetTime() <= itLock->second.nExpiration) return;
+
+            LogPrintf("Removing old transaction lock %s\n", txHash.ToString().c_str());
+            vVotes.swap(itLock->second.vecConsensusVotes);
+            shard.mapTxLocks.erase(itLock);
+        }
+
+        boost::unordered_map<uint256, CTransaction, CCoinsKeyHasher>::iterator it = shard.mapTxLockReq.find(txHash);
+        if (it != shard.mapTxLockReq.end()) {
+            vTx.push_back(it->second);
+            shard.mapTxLockReq.erase(it);
+        }
+        it = shard.mapTxLockReqRejected.find(txHash);
+        if (it != shard.mapTxLockReqRejected.end()) {
+            vTx.push_back(it->second);
+            shard.mapTxLockReqRejected.erase(it);
+        }
+    }
+
+    BOOST_FOREACH (const CTransaction& tx, vTx)
+        UnlockInputs(tx);
+
+    BOOST_FOREACH (const CConsensusVote& v, vVotes) {
+        uint256 hash = v.GetHash();
+        CVoteShard& shard = VoteShard(hash);
+        LOCK(shard.cs);
+        shard.mapTxLockVote.erase(hash);
+    }
+}
+
+void CTxLockManager::Clean()
+{
+    int64_t nNow = GetTime();
+    std::vector<uint256> vTxExpired;
+    std::vector<uint256> vVoteExpired;
+    {
+        LOCK(cs_expiry);
+        std::multimap<int64_t, uint256>::iterator it = mapTxExpiry.begin();
+        while (it != mapTxExpiry.end() && it->first <= nNow) {
+            vTxExpired.push_back(it->second);
+            mapTxExpiry.erase(it++);
+        }
+        it = mapVoteExpiry.begin();
+        while (it != mapVoteExpiry.end() && it->first <= nNow) {
+            vVoteExpired.push_back(it->second);
+            mapVoteExpiry.erase(it++);
+        }
+    }
+
+    BOOST_FOREACH (const uint256& txHash, vTxExpired)
+        RemoveTx(txHash);
+
+    BOOST_FOREACH (const uint256& hash, vVoteExpired) {
+        CVoteShard& shard = VoteShard(hash);
+        LOCK(shard.cs);
+        shard.mapTxLockVote.erase(hash);
+    }
 }
@@ -16,6 +16,11 @@
 #include "sync.h"
 #include "util.h"
 
+#include <atomic>
+#include <map>
+
+#include <boost/unordered_map.hpp>
+
 /*
     At 15 signatures, 1/2 of the masternode network can be owned by
     one party without comprimising the security of SwiftX
@@ -27,6 +32,8 @@
 */
 #define SWIFTTX_SIGNATURES_REQUIRED 6
 #define SWIFTTX_SIGNATURES_TOTAL 10
+// number of independently locked shards of the lock manager maps
+#define SWIFTTX_LOCK_SHARDS 16
 
 using namespace std;
 using namespace boost;
@@ -34,14 +41,11 @@ using namespace boost;
 class CConsensusVote;
 class CTransaction;
 class CTransactionLock;
+class CTxLockManager;
 
 static const int MIN_SWIFTTX_PROTO_VERSION = 70103;
 
-extern map<uint256, CTransaction> mapTxLockReq;
-extern map<uint256, CTransaction> mapTxLockReqRejected;
-extern map<uint256, CConsensusVote> mapTxLockVote;
-extern map<uint256, CTransactionLock> mapTxLocks;
-extern std::map<COutPoint, uint256> mapLockedInputs;
+extern CTxLockManager txLockManager;
 extern int nCompleteTXLocks;
 
 
@@ -95,6 +99,10 @@ public:
 
 class CTransactionLock
 {
+private:
+    // votes at nBlockHeight, kept up to date by AddSignature and SetBlockHeight
+    int nSignatures;
+
 public:
     int nBlockHeight;
     uint256 txHash;
@@ -102,9 +110,12 @@ public:
     int nExpiration;
     int nTimeout;
 
+    CTransactionLock() : nSignatures(0), nBlockHeight(0), txHash(0), nExpiration(0), nTimeout(0) {}
+
     bool SignaturesValid();
-    int CountSignatures();
-    void AddSignature(CConsensusVote& cv);
+    int CountSignatures() const;
+    void AddSignature(const CConsensusVote& cv);
+    void SetBlockHeight(int nBlockHeightIn);
 
     uint256 GetHash()
     {
@@ -112,5 +123,97 @@ public:
     }
 };
 
+//
+// CTxLockManager : Lock requests, votes, transaction locks and locked inputs of SwiftX
+//
+// Each map is split in SWIFTTX_LOCK_SHARDS shards by txid, vote hash or outpoint, each with its own
+// lock, so block validation checking inputs doesn't contend with the message handler. No method holds
+// more than one shard lock at a time. Requests and locks are dropped through a queue ordered by expiry
+// time instead of sweeping the maps.
+//
+
+class CTxLockManager
+{
+private:
+    struct COutPointHasher {
+        CCoinsKeyHasher hasher;
+        size_t operator()(const COutPoint& out) const { return hasher(out.hash) + out.n; }
+    };
+
+    struct CTxShard {
+        mutable CCriticalSection cs;
+        boost::unordered_map<uint256, CTransaction, CCoinsKeyHasher> mapTxLockReq;
+        boost::unordered_map<uint256, CTransaction, CCoinsKeyHasher> mapTxLockReqRejected;
+        boost::unordered_map<uint256, CTransactionLock, CCoinsKeyHasher> mapTxLocks;
+    };
+
+    struct CVoteShard {
+        mutable CCriticalSection cs;
+        boost::unordered_map<uint256, CConsensusVote, CCoinsKeyHasher> mapTxLockVote;
+    };
+
+    struct CInputShard {
+        mutable CCriticalSection cs;
+        boost::unordered_map<COutPoint, uint256, COutPointHasher> mapLockedInputs;
+    };
+
+    CTxShard vTxShards[SWIFTTX_LOCK_SHARDS];
+    CVoteShard vVoteShards[SWIFTTX_LOCK_SHARDS];
+    CInputShard vInputShards[SWIFTTX_LOCK_SHARDS];
+
+    // number of locked inputs, lets transactions skip the input lookups while no lock is active
+    std::atomic<size_t> nLockedInputs;
+
+    // txids and vote hashes by the time they are due to be dropped
+    mutable CCriticalSection cs_expiry;
+    std::multimap<int64_t, uint256> mapTxExpiry;
+    std::multimap<int64_t, uint256> mapVoteExpiry;
+
+    CTxShard& TxShard(const uint256& txHash) { return vTxShards[txHash.GetLow64() % SWIFTTX_LOCK_SHARDS]; }
+    const CTxShard& TxShard(const uint256& txHash) const { return vTxShards[txHash.GetLow64() % SWIFTTX_LOCK_SHARDS]; }
+    CVoteShard& VoteShard(const uint256& hash) { return vVoteShards[hash.GetLow64() % SWIFTTX_LOCK_SHARDS]; }
+    const CVoteShard& VoteShard(const uint256& hash) const { return vVoteShards[hash.GetLow64() % SWIFTTX_LOCK_SHARDS]; }
+    CInputShard& InputShard(const COutPoint& out) { return vInputShards[(out.hash.GetLow64() + out.n) % SWIFTTX_LOCK_SHARDS]; }
+    const CInputShard& InputShard(const COutPoint& out) const { return vInputShards[(out.hash.GetLow64() + out.n) % SWIFTTX_LOCK_SHARDS]; }
+
+    void ScheduleExpiry(const uint256& txHash, int64_t nTime);
+    void UnlockInputs(const CTransaction& tx);
+    void RemoveTx(const uint256& txHash);
+
+public:
+    CTxLockManager() : nLockedInputs(0) {}
+
+    /// Lock requests we accepted, or rejected as conflicting with the mempool or another lock
+    void AddLockRequest(const CTransaction& tx);
+    void AddRejectedLockRequest(const CTransaction& tx);
+    bool HasLockRequest(const uint256& txHash) const;
+    bool HasRejectedLockRequest(const uint256& txHash) const;
+    bool GetLockRequest(const uint256& txHash, CTransaction& tx) const;
+
+    /// Consensus votes, AddVote returns false if the vote was already known
+    bool AddVote(const CConsensusVote& vote);
+    bool HasVote(const uint256& hash) const;
+    bool GetVote(const uint256& hash, CConsensusVote& vote) const;
+
+    /// Create the lock of txHash at nBlockHeight, or move an existing one to it
+    void SetLockHeight(const uint256& txHash, int nBlockHeight);
+    /// Add a vote to the lock of its transaction, creating it if needed, and return its signature count
+    int AddLockSignature(const CConsensusVote& vote);
+    bool HasLock(const uint256& txHash) const;
+    /// Signatures of the lock of txHash, -1 if there is no lock or its height isn't known yet
+    int GetLockSignatures(const uint256& txHash) const;
+    bool IsLockTimedOut(const uint256& txHash) const;
+    /// Have the lock of txHash dropped at the next CleanTransactionLocksList
+    void ExpireLock(const uint256& txHash);
+
+    /// Lock the inputs of tx to txHash, inputs already locked are left as they are
+    void LockInputs(const CTransaction& tx, const uint256& txHash);
+    /// Whether an input of tx is locked to another transaction, which is returned in txHashConflict
+    bool HasConflictingLock(const CTransaction& tx, uint256& txHashConflict) const;
+
+    /// Drop the requests, votes, locks and locked inputs that have expired
+    void Clean();
+};
+
 
 #endif
@@ -0,0 +1,101 @@
+// Copyright (c) 2021-2022 The LenoCore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "uint256.h"
+#include "utilstrencodings.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfilter_tests)
+
+static GCSFilter::Element Element(unsigned char n, unsigned char nTag)
+{
+    GCSFilter::Element element(32, n);
+    element[0] = nTag;
+    return element;
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_match)
+{
+    GCSFilter::ElementSet included, excluded;
+    for (int i = 0; i < 100; ++i) {
+        included.insert(Element(i, 1));
+        excluded.insert(Element(i, 2));
+    }
+
+    GCSFilter filter(0, 0, BASIC_FILTER_P, BASIC_FILTER_M, included);
+    for (const GCSFilter::Element& element : included) {
+        BOOST_CHECK(filter.Match(element));
+
+        GCSFilter::ElementSet query(excluded);
+        query.insert(element);
+        BOOST_CHECK(filter.MatchAny(query));
+    }
+    BOOST_CHECK(!filter.MatchAny(excluded));
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_encoding)
+{
+    GCSFilter::ElementSet elements;
+    for (int i = 0; i < 50; ++i)
+        elements.insert(Element(i, 3));
+
+    GCSFilter filter(1, 2, BASIC_FILTER_P, BASIC_FILTER_M, elements);
+    GCSFilter decoded(1, 2, BASIC_FILTER_P, BASIC_FILTER_M, filter.GetEncoded());
+    BOOST_CHECK_EQUAL(decoded.GetN(), 50U);
+    BOOST_CHECK(decoded.GetEncoded() == filter.GetEncoded());
+    for (const GCSFilter::Element& element : elements)
+        BOOST_CHECK(decoded.Match(element));
+
+    // Trailing or missing data is rejected
+    std::vector<unsigned char> vchEncoded(filter.GetEncoded());
+    vchEncoded.push_back(0);
+    BOOST_CHECK_THROW(GCSFilter(1, 2, BASIC_FILTER_P, BASIC_FILTER_M, vchEncoded), std::ios_base::failure);
+    vchEncoded.resize(vchEncoded.size() - 2);
+    BOOST_CHECK_THROW(GCSFilter(1, 2, BASIC_FILTER_P, BASIC_FILTER_M, vchEncoded), std::ios_base::failure);
+
+    GCSFilter empty(1, 2, BASIC_FILTER_P, BASIC_FILTER_M, GCSFilter::ElementSet());
+    BOOST_CHECK_EQUAL(empty.GetEncoded().size(), 1U);
+    BOOST_CHECK(!empty.MatchAny(elements));
+}
+
+static GCSFilter BasicFilter(const uint256& hashBlock, const GCSFilter::ElementSet& elements)
+{
+    return GCSFilter(ReadLE64(hashBlock.begin()), ReadLE64(hashBlock.begin() + 8), BASIC_FILTER_P, BASIC_FILTER_M, elements);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_bip158_vectors)
+{
+    // BIP 158 test vector: basic filter of the testnet genesis block, whose
+    // only element is the genesis output script
+    uint256 hashGenesis = uint256S("000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943");
+    GCSFilter::ElementSet elements;
+    elements.insert(ParseHex("4104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac"));
+    BOOST_CHECK_EQUAL(HexStr(BasicFilter(hashGenesis, elements).GetEncoded()), "019dfca8");
+
+    CBlockFilter filterGenesis(hashGenesis, ParseHex("019dfca8"));
+    BOOST_CHECK(filterGenesis.GetFilter().Match(*elements.begin()));
+    uint256 hashHeaderGenesis = filterGenesis.ComputeHeader(uint256(0));
+    BOOST_CHECK_EQUAL(hashHeaderGenesis.GetHex(), "21584579b7eb08997773e5aeff3a7f932700042d0ed2a6129012b7d7ae81b750");
+
+    // Several elements, so the deltas and their unary quotients are covered,
+    // chained onto the genesis filter header (computed with an independent
+    // implementation of BIP 158)
+    uint256 hashBlock = uint256S("000000006c02c8ea6e4ff69651f7fcde348fb9d557a06e6957b65552002a7820");
+    elements.clear();
+    for (int i = 0; i < 20; ++i)
+        elements.insert(GCSFilter::Element(i + 1, i));
+    const std::string strEncoded = "1418831b26841266497438fdcf5bf17d762ad7edc82aba5f3f5762315a95ee50150d6358bd55b22bcc51d9ade86c6bd5b388150395b0";
+    BOOST_CHECK_EQUAL(HexStr(BasicFilter(hashBlock, elements).GetEncoded()), strEncoded);
+
+    CBlockFilter filter(hashBlock, ParseHex(strEncoded));
+    BOOST_CHECK_EQUAL(filter.GetFilter().GetN(), 20U);
+    BOOST_CHECK(filter.GetFilter().MatchAny(elements));
+    BOOST_CHECK_EQUAL(filter.ComputeHeader(hashHeaderGenesis).GetHex(), "d9ee6e9c7e1b05fe9807a7ce1be8c4e84d3e90d229c10e25184831f20425098a");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
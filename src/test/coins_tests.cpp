@@ -44,6 +44,10 @@ public:
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
     {
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
+            if ((it->second.flags & CCoinsCacheEntry::DIRTY) && !(it->second.flags & CCoinsCacheEntry::FRESH)) {
+                // Modified entries carry the version this view had before
+                BOOST_CHECK(it->second.pcoinsParent && map_.count(it->first) && *it->second.pcoinsParent == map_[it->first]);
+            }
             map_[it->first] = it->second.coins;
             if (it->second.coins.IsPruned() && insecure_rand() % 3 == 0) {
                 // Randomly delete empty entries on write.
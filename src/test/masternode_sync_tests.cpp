@@ -0,0 +1,100 @@
+// Copyright (c) 2021-2022 The LenoCore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "hash.h"
+#include "masternode-sync.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(masternode_sync_tests)
+
+// what a receiving node holds after the header of snapshotIn
+static CMasternodeSyncSnapshot ReceiveHeader(const CMasternodeSyncSnapshot& snapshotIn)
+{
+    CMasternodeSyncSnapshot snapshot(snapshotIn.nItemID);
+    snapshot.nItems = snapshotIn.nItems;
+    snapshot.vChunkHash = snapshotIn.vChunkHash;
+    snapshot.vChunk.resize(snapshotIn.vChunkHash.size());
+    return snapshot;
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_set_chunk)
+{
+    // enough items for several chunks
+    CMasternodeSyncSnapshot snapshotOut(MASTERNODE_SYNC_MNW);
+    std::vector<unsigned char> vchItem(100 * 1024, 0x5a);
+    for (int i = 0; i < 12; i++) {
+        vchItem[0] = i;
+        snapshotOut.Add("mnw", vchItem);
+    }
+    snapshotOut.Finish();
+    BOOST_CHECK_EQUAL(snapshotOut.nItems, 12);
+    BOOST_REQUIRE(snapshotOut.vChunk.size() > 1);
+    BOOST_CHECK_EQUAL(snapshotOut.vChunk.size(), snapshotOut.vChunkHash.size());
+    BOOST_CHECK(snapshotOut.IsComplete());
+
+    CMasternodeSyncSnapshot snapshot = ReceiveHeader(snapshotOut);
+    BOOST_CHECK(!snapshot.IsComplete());
+
+    // out of range
+    BOOST_CHECK(!snapshot.SetChunk(-1, snapshotOut.vChunk[0]));
+    BOOST_CHECK(!snapshot.SetChunk(snapshotOut.vChunk.size(), snapshotOut.vChunk[0]));
+
+    // not matching the committed hash
+    BOOST_CHECK(!snapshot.SetChunk(0, snapshotOut.vChunk[1]));
+    std::vector<unsigned char> vchDamaged = snapshotOut.vChunk[0];
+    vchDamaged.back() ^= 1;
+    BOOST_CHECK(!snapshot.SetChunk(0, vchDamaged));
+    BOOST_CHECK(!snapshot.SetChunk(0, std::vector<unsigned char>()));
+
+    // in any order, each once
+    for (int i = snapshotOut.vChunk.size() - 1; i >= 0; i--) {
+        BOOST_CHECK(!snapshot.IsComplete());
+        BOOST_CHECK(snapshot.SetChunk(i, snapshotOut.vChunk[i]));
+        BOOST_CHECK(!snapshot.SetChunk(i, snapshotOut.vChunk[i]));
+    }
+    BOOST_CHECK(snapshot.IsComplete());
+    BOOST_CHECK(snapshot.vChunk == snapshotOut.vChunk);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_apply)
+{
+    // an empty masternode list is refused, empty winners and budgets are fine
+    CMasternodeSyncSnapshot snapshotList(MASTERNODE_SYNC_LIST);
+    snapshotList.Finish();
+    BOOST_CHECK(snapshotList.IsComplete());
+    BOOST_CHECK(!snapshotList.Apply(NULL));
+
+    CMasternodeSyncSnapshot snapshotBudget(MASTERNODE_SYNC_BUDGET);
+    snapshotBudget.Finish();
+    BOOST_CHECK(snapshotBudget.Apply(NULL));
+
+    // commands of another asset
+    CMasternodeSyncSnapshot snapshotCommand(MASTERNODE_SYNC_MNW);
+    snapshotCommand.Add("mnw", 1);
+    snapshotCommand.Add("mnb", 2);
+    snapshotCommand.Finish();
+    BOOST_CHECK(!snapshotCommand.Apply(NULL));
+
+    // more or fewer items than the header announced
+    CMasternodeSyncSnapshot snapshotCount(MASTERNODE_SYNC_BUDGET);
+    snapshotCount.Add("mprop", 1);
+    snapshotCount.Finish();
+    snapshotCount.nItems = 2;
+    BOOST_CHECK(!snapshotCount.Apply(NULL));
+    snapshotCount.nItems = 0;
+    BOOST_CHECK(!snapshotCount.Apply(NULL));
+
+    // a chunk that doesn't decode
+    CMasternodeSyncSnapshot snapshotMalformed(MASTERNODE_SYNC_MNW);
+    snapshotMalformed.Add("mnw", 1);
+    snapshotMalformed.Finish();
+    snapshotMalformed.vChunk[0].resize(snapshotMalformed.vChunk[0].size() - 1);
+    BOOST_CHECK(!snapshotMalformed.Apply(NULL));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -99,4 +99,153 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     removed.clear();
 }
 
+BOOST_AUTO_TEST_CASE(MempoolAncestorDescendantTest)
+{
+    // Chain tx1 <- tx2 <- tx3, with tx4 also spending tx1
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_11;
+    tx1.vout.resize(2);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    tx1.vout[1].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[1].nValue = 10 * COIN;
+
+    CMutableTransaction tx2;
+    tx2.vin.resize(1);
+    tx2.vin[0].scriptSig = CScript() << OP_11;
+    tx2.vin[0].prevout.hash = tx1.GetHash();
+    tx2.vin[0].prevout.n = 0;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx2.vout[0].nValue = 9 * COIN;
+
+    CMutableTransaction tx3;
+    tx3.vin.resize(1);
+    tx3.vin[0].scriptSig = CScript() << OP_11;
+    tx3.vin[0].prevout.hash = tx2.GetHash();
+    tx3.vin[0].prevout.n = 0;
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx3.vout[0].nValue = 8 * COIN;
+
+    CMutableTransaction tx4;
+    tx4.vin.resize(1);
+    tx4.vin[0].scriptSig = CScript() << OP_11;
+    tx4.vin[0].prevout.hash = tx1.GetHash();
+    tx4.vin[0].prevout.n = 1;
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx4.vout[0].nValue = 9 * COIN;
+
+    CTxMemPool pool(CFeeRate(0));
+    pool.addUnchecked(tx1.GetHash(), CTxMemPoolEntry(tx1, 1000LL, 0, 0.0, 1));
+    pool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 2000LL, 0, 0.0, 1));
+    pool.addUnchecked(tx4.GetHash(), CTxMemPoolEntry(tx4, 4000LL, 0, 0.0, 1));
+
+    // A new transaction is checked against the limits before it is added
+    std::set<uint256> setAncestors;
+    std::string errString;
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(tx3, 100, setAncestors, 3, 100000, 4, 100000, errString));
+    BOOST_CHECK_EQUAL(setAncestors.size(), 2);
+    setAncestors.clear();
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(tx3, 100, setAncestors, 2, 100000, 4, 100000, errString));
+    setAncestors.clear();
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(tx3, 100, setAncestors, 3, 100000, 3, 100000, errString));
+
+    pool.addUnchecked(tx3.GetHash(), CTxMemPoolEntry(tx3, 3000LL, 0, 0.0, 1));
+    const CTxMemPoolEntry& entry1 = pool.mapTx[tx1.GetHash()];
+    BOOST_CHECK_EQUAL(entry1.GetCountWithDescendants(), 4);
+    BOOST_CHECK_EQUAL(entry1.GetModFeesWithDescendants(), 10000);
+    BOOST_CHECK_EQUAL(entry1.GetCountWithAncestors(), 1);
+    const CTxMemPoolEntry& entry3 = pool.mapTx[tx3.GetHash()];
+    BOOST_CHECK_EQUAL(entry3.GetCountWithAncestors(), 3);
+    BOOST_CHECK_EQUAL(entry3.GetModFeesWithAncestors(), 6000);
+    BOOST_CHECK_EQUAL(pool.GetMemPoolChildren(tx1.GetHash()).size(), 2);
+
+    // Fee deltas count towards the packages
+    pool.PrioritiseTransaction(tx2.GetHash(), tx2.GetHash().ToString(), 0.0, 5000LL);
+    BOOST_CHECK_EQUAL(pool.mapTx[tx1.GetHash()].GetModFeesWithDescendants(), 15000);
+    BOOST_CHECK_EQUAL(pool.mapTx[tx3.GetHash()].GetModFeesWithAncestors(), 11000);
+
+    // Mining tx1 and tx2 leaves tx3 and tx4 without ancestors
+    std::list<CTransaction> removed;
+    pool.remove(tx1, removed, false);
+    pool.remove(tx2, removed, false);
+    BOOST_CHECK_EQUAL(pool.size(), 2);
+    BOOST_CHECK_EQUAL(pool.mapTx[tx3.GetHash()].GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(pool.mapTx[tx3.GetHash()].GetModFeesWithAncestors(), 3000);
+    BOOST_CHECK_EQUAL(pool.mapTx[tx4.GetHash()].GetCountWithAncestors(), 1);
+
+    // tx2 coming back from a disconnected block is linked to tx3 again
+    pool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 2000LL, 0, 0.0, 1));
+    BOOST_CHECK_EQUAL(pool.mapTx[tx2.GetHash()].GetCountWithDescendants(), 2);
+    BOOST_CHECK_EQUAL(pool.mapTx[tx3.GetHash()].GetCountWithAncestors(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_1;
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx1.GetHash(), CTxMemPoolEntry(tx1, 10000LL, 0, 10.0, 1));
+
+    CMutableTransaction tx2;
+    tx2.vin.resize(1);
+    tx2.vin[0].scriptSig = CScript() << OP_2;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+    tx2.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 5000LL, 1, 10.0, 1));
+
+    CMutableTransaction tx3;
+    tx3.vin.resize(1);
+    tx3.vin[0].scriptSig = CScript() << OP_3;
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_3 << OP_EQUAL;
+    tx3.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx3.GetHash(), CTxMemPoolEntry(tx3, 20000LL, 2, 10.0, 1));
+
+    // Child of tx1 paying a high fee, its package keeps tx1 in the pool
+    CMutableTransaction tx4;
+    tx4.vin.resize(1);
+    tx4.vin[0].scriptSig = CScript() << OP_4;
+    tx4.vin[0].prevout.hash = tx1.GetHash();
+    tx4.vin[0].prevout.n = 0;
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = CScript() << OP_4 << OP_EQUAL;
+    tx4.vout[0].nValue = 9 * COIN;
+    pool.addUnchecked(tx4.GetHash(), CTxMemPoolEntry(tx4, 100000LL, 3, 10.0, 1));
+
+    // Nothing is evicted while the pool fits
+    pool.TrimToSize(pool.DynamicMemoryUsage());
+    BOOST_CHECK_EQUAL(pool.size(), 4);
+    BOOST_CHECK(pool.GetMinFee(1) == CFeeRate(0));
+
+    // The lowest fee rate goes first and raises the minimum fee above its own fee rate
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(pool.exists(tx1.GetHash()));
+    BOOST_CHECK(!pool.exists(tx2.GetHash()));
+    BOOST_CHECK(pool.exists(tx3.GetHash()));
+    BOOST_CHECK(pool.exists(tx4.GetHash()));
+    size_t nSize2 = ::GetSerializeSize(tx2, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK_EQUAL(pool.GetMinFee(1).GetFeePerK(), CFeeRate(5000LL, nSize2).GetFeePerK() + 1000);
+
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(pool.exists(tx1.GetHash()));
+    BOOST_CHECK(!pool.exists(tx3.GetHash()));
+    BOOST_CHECK(pool.exists(tx4.GetHash()));
+
+    // Only transactions older than the expiry time are removed, with their descendants
+    BOOST_CHECK_EQUAL(pool.Expire(0), 0);
+    BOOST_CHECK_EQUAL(pool.Expire(1), 2);
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+    BOOST_CHECK_EQUAL(pool.DynamicMemoryUsage(), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,69 @@
+// Copyright (c) 2021-2022 The LenoCore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "muhash.h"
+#include "streams.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(muhash_tests)
+
+static std::vector<unsigned char> Element(unsigned char n)
+{
+    return std::vector<unsigned char>(n + 1, n);
+}
+
+BOOST_AUTO_TEST_CASE(muhash_order_independent)
+{
+    CMuHash3072 a, b;
+    for (unsigned char i = 0; i < 10; i++)
+        a.Insert(Element(i));
+    for (int i = 9; i >= 0; i--)
+        b.Insert(Element(i));
+    BOOST_CHECK(a.Finalize() == b.Finalize());
+
+    // Removing an element gives the hash of the set without it
+    CMuHash3072 c;
+    for (unsigned char i = 0; i < 9; i++)
+        c.Insert(Element(i));
+    a.Remove(Element(9));
+    BOOST_CHECK(a.Finalize() == c.Finalize());
+    BOOST_CHECK(a.Finalize() != b.Finalize());
+
+    // Removing everything gives the empty set
+    for (unsigned char i = 0; i < 9; i++)
+        a.Remove(Element(i));
+    BOOST_CHECK(a.Finalize() == CMuHash3072().Finalize());
+
+    // Combining two halves gives the whole set
+    CMuHash3072 d, e;
+    for (unsigned char i = 0; i < 5; i++)
+        d.Insert(Element(i));
+    for (unsigned char i = 5; i < 10; i++)
+        e.Insert(Element(i));
+    d *= e;
+    BOOST_CHECK(d.Finalize() == b.Finalize());
+}
+
+BOOST_AUTO_TEST_CASE(muhash_serialize)
+{
+    CMuHash3072 a;
+    a.Insert(Element(1));
+    a.Insert(Element(2));
+    a.Remove(Element(1));
+
+    CDataStream ss(SER_DISK, 0);
+    ss << a;
+    CMuHash3072 b;
+    ss >> b;
+    BOOST_CHECK(a.Finalize() == b.Finalize());
+
+    CMuHash3072 c;
+    c.Insert(Element(2));
+    BOOST_CHECK(b.Finalize() == c.Finalize());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
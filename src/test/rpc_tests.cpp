@@ -12,6 +12,7 @@
 #include "util.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/assign/list_of.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include <univalue.h>
@@ -183,6 +184,32 @@ BOOST_AUTO_TEST_CASE(json_parse_errors)
     BOOST_CHECK_THROW(ParseNonRFCJSONValue("3J98t1WpEZ73CNmQviecrnyiWrnqRhWNL"), std::runtime_error);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_parse_paging)
+{
+    size_t nStart, nCount;
+
+    // Omitted arguments select everything
+    ParsePaging(RPCConvertValues("listmasternodes", boost::assign::list_of("")), 1, nStart, nCount);
+    BOOST_CHECK_EQUAL(nStart, 0U);
+    BOOST_CHECK_EQUAL(nCount, std::numeric_limits<size_t>::max());
+
+    ParsePaging(RPCConvertValues("listmasternodes", boost::assign::list_of("")("10")("20")), 1, nStart, nCount);
+    BOOST_CHECK_EQUAL(nStart, 10U);
+    BOOST_CHECK_EQUAL(nCount, 20U);
+
+    // Numeric strings, as forwarded by the legacy commands
+    UniValue params(UniValue::VARR);
+    params.push_back("list");
+    params.push_back("5");
+    ParsePaging(params, 1, nStart, nCount);
+    BOOST_CHECK_EQUAL(nStart, 5U);
+    BOOST_CHECK_EQUAL(nCount, std::numeric_limits<size_t>::max());
+
+    BOOST_CHECK_THROW(ParsePaging(RPCConvertValues("listmasternodes", boost::assign::list_of("")("-1")), 1, nStart, nCount), UniValue);
+    params.push_back("ten");
+    BOOST_CHECK_THROW(ParsePaging(params, 1, nStart, nCount), UniValue);
+}
+
 BOOST_AUTO_TEST_CASE(rpc_ban)
 {
     BOOST_CHECK_NO_THROW(CallRPC(string("clearbanned")));
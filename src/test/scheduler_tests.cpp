@@ -121,4 +121,47 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+static void orderedTask(boost::mutex& mutex, std::vector<int>& seen, int n)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    seen.push_back(n);
+}
+
+BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
+{
+    CScheduler scheduler;
+
+    // Two clients sharing one scheduler serviced by several threads:
+    // each client's callbacks must still run one at a time, in order.
+    SingleThreadedSchedulerClient queue1(&scheduler);
+    SingleThreadedSchedulerClient queue2(&scheduler);
+
+    boost::mutex mutex1, mutex2;
+    std::vector<int> seen1, seen2;
+    for (int i = 0; i < 100; i++) {
+        queue1.AddToProcessQueue(boost::bind(&orderedTask, boost::ref(mutex1), boost::ref(seen1), i));
+        queue2.AddToProcessQueue(boost::bind(&orderedTask, boost::ref(mutex2), boost::ref(seen2), i));
+    }
+
+    boost::thread_group threads;
+    for (int i = 0; i < 5; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    scheduler.stop(true);
+    threads.join_all();
+
+    // Anything the stopped scheduler did not get to runs on this thread
+    queue1.EmptyQueue();
+    queue2.EmptyQueue();
+    BOOST_CHECK_EQUAL(queue1.CallbacksPending(), 0U);
+    BOOST_CHECK_EQUAL(queue2.CallbacksPending(), 0U);
+
+    BOOST_REQUIRE_EQUAL(seen1.size(), 100U);
+    BOOST_REQUIRE_EQUAL(seen2.size(), 100U);
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK_EQUAL(seen1[i], i);
+        BOOST_CHECK_EQUAL(seen2[i], i);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,126 @@
+// Copyright (c) 2021-2022 The LenoCore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "accumulators.h"
+#include "chainparams.h"
+#include "hash.h"
+#include "main.h"
+#include "snapshot.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(snapshot_tests)
+
+static std::vector<char> ReadFileBytes(const boost::filesystem::path& path)
+{
+    std::vector<char> vch(boost::filesystem::file_size(path));
+    FILE* file = fopen(path.string().c_str(), "rb");
+    BOOST_REQUIRE(file && fread(vch.data(), 1, vch.size(), file) == vch.size());
+    fclose(file);
+    return vch;
+}
+
+static void WriteFileBytes(const boost::filesystem::path& path, const CDataStream& ss)
+{
+    FILE* file = fopen(path.string().c_str(), "wb");
+    BOOST_REQUIRE(file && fwrite(&ss[0], 1, ss.size(), file) == ss.size());
+    fclose(file);
+}
+
+/** Rewrite the snapshot at pathIn with an extra accumulator value and a checksum that matches */
+static void AppendAccumulatorValue(const boost::filesystem::path& pathIn, const boost::filesystem::path& pathOut, uint32_t nChecksum, const CBigNum& bnValue)
+{
+    std::vector<char> vch = ReadFileBytes(pathIn);
+    CDataStream ssIn(&vch[0], &vch[0] + vch.size() - sizeof(uint256), SER_DISK, CLIENT_VERSION);
+    MessageStartChars pchMessageStart;
+    CTxOutSetSnapshotMetadata metadata;
+    ssIn >> FLATDATA(pchMessageStart) >> metadata;
+    metadata.nAccumulatorValues++;
+
+    CDataStream ssOut(SER_DISK, CLIENT_VERSION);
+    ssOut << FLATDATA(pchMessageStart) << metadata;
+    if (!ssIn.empty())
+        ssOut.write(&ssIn[0], ssIn.size());
+    ssOut << std::make_pair(nChecksum, bnValue);
+    uint256 hash = Hash(ssOut.begin(), ssOut.end());
+    ssOut << hash;
+    WriteFileBytes(pathOut, ssOut);
+}
+
+static bool LoadFails(const boost::filesystem::path& path, const uint256& hashExpected, const std::string& strExpectedError)
+{
+    CTxOutSetSnapshotMetadata metadata;
+    std::string strError;
+    if (LoadTxOutSet(path, hashExpected, metadata, strError))
+        return false;
+    BOOST_TEST_MESSAGE(strError);
+    return strError.find(strExpectedError) != std::string::npos;
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_dump_load)
+{
+    bool fTxIndexOld = fTxIndex;
+    fTxIndex = false;
+    zerocoinDB = new CZerocoinDB(1 << 20, true);
+
+    boost::filesystem::path path = GetDataDir() / "snapshot_tests.dat";
+    boost::filesystem::path pathForged = GetDataDir() / "snapshot_tests_forged.dat";
+    CTxOutSetSnapshotMetadata metadata;
+    uint256 hashSnapshot;
+    std::string strError;
+    BOOST_REQUIRE(DumpTxOutSet(path, metadata, hashSnapshot, strError));
+    BOOST_CHECK(metadata.hashBlock == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK_EQUAL(metadata.nHeight, chainActive.Height());
+
+    CTxOutSetSnapshotMetadata metadataRead;
+    BOOST_CHECK(ReadTxOutSetMetadata(path, metadataRead, strError));
+    BOOST_CHECK(metadataRead.hashBlock == metadata.hashBlock);
+    BOOST_CHECK(metadataRead.hashCoins == metadata.hashCoins);
+
+    // The coins alone are not what the snapshot is checked against
+    BOOST_CHECK(hashSnapshot != metadata.hashCoins);
+    BOOST_CHECK(LoadFails(path, metadata.hashCoins, "does not match the expected"));
+
+    // A verified snapshot gets as far as the chain checks; the tip is the
+    // snapshot block itself, so there is nothing to load
+    BOOST_CHECK(LoadFails(path, hashSnapshot, "not an ancestor"));
+
+    // Damage is caught by the checksum
+    std::vector<char> vch = ReadFileBytes(path);
+    vch.back() ^= 1;
+    WriteFileBytes(pathForged, CDataStream(vch, SER_DISK, CLIENT_VERSION));
+    BOOST_CHECK(LoadFails(pathForged, hashSnapshot, "checksum mismatch"));
+
+    // Snapshots from other networks are refused
+    vch = ReadFileBytes(path);
+    vch[0] ^= 1;
+    WriteFileBytes(pathForged, CDataStream(vch, SER_DISK, CLIENT_VERSION));
+    BOOST_CHECK(LoadFails(pathForged, hashSnapshot, "different network"));
+
+    // An accumulator value that does not match its checksum
+    CBigNum bnValue(12345);
+    AppendAccumulatorValue(path, pathForged, GetChecksum(bnValue) + 1, bnValue);
+    BOOST_CHECK(LoadFails(pathForged, hashSnapshot, "does not match its checksum"));
+
+    // A well-formed extra accumulator value, with the file checksum
+    // recomputed, changes the snapshot hash
+    AppendAccumulatorValue(path, pathForged, GetChecksum(bnValue), bnValue);
+    BOOST_CHECK(LoadFails(pathForged, hashSnapshot, "does not match the expected"));
+
+    boost::filesystem::remove(path);
+    boost::filesystem::remove(pathForged);
+    delete zerocoinDB;
+    zerocoinDB = NULL;
+    fTxIndex = fTxIndexOld;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
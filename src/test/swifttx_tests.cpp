@@ -0,0 +1,174 @@
+// Copyright (c) 2021-2022 The LenoCore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "primitives/transaction.h"
+#include "swifttx.h"
+#include "utiltime.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(swifttx_tests)
+
+static CTransaction SpendTx(const uint256& hashPrev, uint32_t n, int nValue)
+{
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(COutPoint(hashPrev, n)));
+    tx.vout.push_back(CTxOut(nValue, CScript()));
+    return tx;
+}
+
+static CConsensusVote Vote(const uint256& txHash, int nMasternode, int nBlockHeight)
+{
+    CConsensusVote vote;
+    vote.vinMasternode = CTxIn(COutPoint(uint256(1000), nMasternode));
+    vote.txHash = txHash;
+    vote.nBlockHeight = nBlockHeight;
+    return vote;
+}
+
+BOOST_AUTO_TEST_CASE(txlock_requests_and_votes)
+{
+    CTxLockManager manager;
+    CTransaction tx = SpendTx(uint256(1), 0, 1);
+    CTransaction txRejected = SpendTx(uint256(2), 0, 1);
+    CTransaction txLookup;
+
+    BOOST_CHECK(!manager.HasLockRequest(tx.GetHash()));
+    BOOST_CHECK(!manager.GetLockRequest(tx.GetHash(), txLookup));
+    manager.AddLockRequest(tx);
+    manager.AddRejectedLockRequest(txRejected);
+    BOOST_CHECK(manager.HasLockRequest(tx.GetHash()));
+    BOOST_CHECK(!manager.HasRejectedLockRequest(tx.GetHash()));
+    BOOST_CHECK(manager.GetLockRequest(tx.GetHash(), txLookup));
+    BOOST_CHECK(txLookup == tx);
+    BOOST_CHECK(manager.HasRejectedLockRequest(txRejected.GetHash()));
+    BOOST_CHECK(!manager.HasLockRequest(txRejected.GetHash()));
+    BOOST_CHECK(!manager.GetLockRequest(txRejected.GetHash(), txLookup));
+
+    CConsensusVote vote = Vote(tx.GetHash(), 0, 10);
+    CConsensusVote voteLookup;
+    BOOST_CHECK(manager.AddVote(vote));
+    BOOST_CHECK(!manager.AddVote(vote));
+    BOOST_CHECK(manager.HasVote(vote.GetHash()));
+    BOOST_CHECK(manager.GetVote(vote.GetHash(), voteLookup));
+    BOOST_CHECK(voteLookup.txHash == tx.GetHash() && voteLookup.nBlockHeight == 10);
+    BOOST_CHECK(!manager.HasVote(Vote(tx.GetHash(), 1, 10).GetHash()));
+}
+
+BOOST_AUTO_TEST_CASE(txlock_signatures)
+{
+    CTxLockManager manager;
+    uint256 txHash = SpendTx(uint256(1), 0, 1).GetHash();
+    BOOST_CHECK(!manager.HasLock(txHash));
+    BOOST_CHECK_EQUAL(manager.GetLockSignatures(txHash), -1);
+
+    // votes arriving before the lock request create the lock, without a height they don't count yet
+    BOOST_CHECK_EQUAL(manager.AddLockSignature(Vote(txHash, 0, 10)), -1);
+    BOOST_CHECK_EQUAL(manager.AddLockSignature(Vote(txHash, 1, 10)), -1);
+    BOOST_CHECK_EQUAL(manager.AddLockSignature(Vote(txHash, 2, 11)), -1);
+    BOOST_CHECK(manager.HasLock(txHash));
+    BOOST_CHECK_EQUAL(manager.GetLockSignatures(txHash), -1);
+
+    // only votes for the height of the lock count, and keep counting after it moves
+    manager.SetLockHeight(txHash, 10);
+    BOOST_CHECK_EQUAL(manager.GetLockSignatures(txHash), 2);
+    BOOST_CHECK_EQUAL(manager.AddLockSignature(Vote(txHash, 3, 10)), 3);
+    BOOST_CHECK_EQUAL(manager.AddLockSignature(Vote(txHash, 4, 11)), 3);
+
+    manager.SetLockHeight(txHash, 11);
+    BOOST_CHECK_EQUAL(manager.GetLockSignatures(txHash), 2);
+    manager.SetLockHeight(txHash, 12);
+    BOOST_CHECK_EQUAL(manager.GetLockSignatures(txHash), 0);
+    manager.SetLockHeight(txHash, 10);
+    BOOST_CHECK_EQUAL(manager.GetLockSignatures(txHash), 3);
+
+    // a lock created by its request starts out counting
+    uint256 txHashNew = SpendTx(uint256(2), 0, 1).GetHash();
+    manager.SetLockHeight(txHashNew, 20);
+    BOOST_CHECK_EQUAL(manager.GetLockSignatures(txHashNew), 0);
+    BOOST_CHECK_EQUAL(manager.AddLockSignature(Vote(txHashNew, 0, 20)), 1);
+}
+
+BOOST_AUTO_TEST_CASE(txlock_conflicting_inputs)
+{
+    CTxLockManager manager;
+    CMutableTransaction txLocked;
+    txLocked.vin.push_back(CTxIn(COutPoint(uint256(1), 0)));
+    txLocked.vin.push_back(CTxIn(COutPoint(uint256(1), 1)));
+    txLocked.vout.push_back(CTxOut(1, CScript()));
+    uint256 txHashLocked = CTransaction(txLocked).GetHash();
+    CTransaction txDoubleSpend = SpendTx(uint256(1), 1, 2);
+    CTransaction txOther = SpendTx(uint256(1), 2, 1);
+
+    uint256 txHashConflict;
+    BOOST_CHECK(!manager.HasConflictingLock(txDoubleSpend, txHashConflict));
+
+    manager.LockInputs(txLocked, txHashLocked);
+    BOOST_CHECK(!manager.HasConflictingLock(txLocked, txHashConflict));
+    BOOST_CHECK(!manager.HasConflictingLock(txOther, txHashConflict));
+    BOOST_CHECK(manager.HasConflictingLock(txDoubleSpend, txHashConflict));
+    BOOST_CHECK(txHashConflict == txHashLocked);
+
+    // inputs that are locked already stay with the first transaction
+    manager.LockInputs(txDoubleSpend, txDoubleSpend.GetHash());
+    BOOST_CHECK(manager.HasConflictingLock(txDoubleSpend, txHashConflict));
+    BOOST_CHECK(txHashConflict == txHashLocked);
+}
+
+BOOST_AUTO_TEST_CASE(txlock_clean)
+{
+    int64_t nStartTime = GetTime();
+    SetMockTime(nStartTime);
+
+    CTxLockManager manager;
+    CTransaction tx = SpendTx(uint256(1), 0, 1);
+    CTransaction txDoubleSpend = SpendTx(uint256(1), 0, 2);
+    CTransaction txRejected = SpendTx(uint256(2), 0, 1);
+    uint256 txHash = tx.GetHash();
+    CConsensusVote vote = Vote(txHash, 0, 10);
+    CConsensusVote voteOrphan = Vote(uint256(3), 0, 10);
+    uint256 txHashConflict;
+
+    manager.AddLockRequest(tx);
+    manager.AddRejectedLockRequest(txRejected);
+    manager.LockInputs(tx, txHash);
+    manager.AddVote(voteOrphan);
+
+    // the lock is created later than the request, so it keeps the request beyond the request's own hour
+    SetMockTime(nStartTime + 60);
+    manager.SetLockHeight(txHash, 10);
+    manager.AddVote(vote);
+    manager.AddLockSignature(vote);
+
+    SetMockTime(nStartTime + 60 * 5 + 61);
+    BOOST_CHECK(manager.IsLockTimedOut(txHash));
+
+    SetMockTime(nStartTime + 60 * 60);
+    manager.Clean();
+    BOOST_CHECK(manager.HasLockRequest(txHash));
+    BOOST_CHECK(manager.HasLock(txHash));
+    BOOST_CHECK(manager.HasVote(vote.GetHash()));
+    BOOST_CHECK(manager.HasConflictingLock(txDoubleSpend, txHashConflict));
+    BOOST_CHECK(!manager.HasRejectedLockRequest(txRejected.GetHash()));
+    BOOST_CHECK(!manager.HasVote(voteOrphan.GetHash()));
+
+    SetMockTime(nStartTime + 60 * 61 + 1);
+    manager.Clean();
+    BOOST_CHECK(!manager.HasLockRequest(txHash));
+    BOOST_CHECK(!manager.HasLock(txHash));
+    BOOST_CHECK(!manager.HasVote(vote.GetHash()));
+    BOOST_CHECK(!manager.HasConflictingLock(txDoubleSpend, txHashConflict));
+
+    // an expired lock goes at the next Clean
+    manager.SetLockHeight(txHash, 10);
+    BOOST_CHECK(manager.HasLock(txHash));
+    manager.ExpireLock(txHash);
+    SetMockTime(nStartTime + 60 * 61 + 2);
+    manager.Clean();
+    BOOST_CHECK(!manager.HasLock(txHash));
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,11 +8,15 @@
 
 #include "main.h"
 #include "pow.h"
+#include "random.h"
+#include "streams.h"
 #include "uint256.h"
 #include "accumulators.h"
 
+#include <limits>
 #include <stdint.h>
 
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
 using namespace std;
@@ -31,8 +35,55 @@ void static BatchWriteHashBestChain(CLevelDBBatch& batch, const uint256& hash)
     batch.Write('B', hash);
 }
 
+void static BatchWriteStats(CLevelDBBatch& batch, const CCoinsDBStats& stats)
+{
+    batch.Write('S', stats);
+}
+
+static std::vector<unsigned char> SerializeCoinsEntry(const uint256& txid, const CCoins& coins)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << txid << coins;
+    return std::vector<unsigned char>(ss.begin(), ss.end());
+}
+
+void CCoinsDBStats::Add(const uint256& txid, const CCoins& coins)
+{
+    nTransactions++;
+    for (const CTxOut& out : coins.vout) {
+        if (!out.IsNull()) {
+            nTransactionOutputs++;
+            nTotalAmount += out.nValue;
+        }
+    }
+    nSerializedSize += 32 + ::GetSerializeSize(coins, SER_DISK, CLIENT_VERSION);
+    muhash.Insert(SerializeCoinsEntry(txid, coins));
+}
+
+void CCoinsDBStats::Remove(const uint256& txid, const CCoins& coins)
+{
+    nTransactions--;
+    for (const CTxOut& out : coins.vout) {
+        if (!out.IsNull()) {
+            nTransactionOutputs--;
+            nTotalAmount -= out.nValue;
+        }
+    }
+    nSerializedSize -= 32 + ::GetSerializeSize(coins, SER_DISK, CLIENT_VERSION);
+    muhash.Remove(SerializeCoinsEntry(txid, coins));
+}
+
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
 {
+    // Statistics written for a different best block are stale (e.g. the
+    // chainstate was used by a version that does not maintain them)
+    uint256 hashBestChain = GetBestBlock();
+    fStatsValid = db.Read('S', statsDB) && statsDB.hashBlock == hashBestChain;
+    if (!fStatsValid && hashBestChain == uint256(0)) {
+        // A new (or wiped) chainstate: start tracking from the empty set
+        statsDB = CCoinsDBStats();
+        fStatsValid = true;
+    }
 }
 
 bool CCoinsViewDB::GetCoins(const uint256& txid, CCoins& coins) const
@@ -56,10 +107,33 @@ uint256 CCoinsViewDB::GetBestBlock() const
 bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
 {
     CLevelDBBatch batch;
+    CCoinsDBStats stats = statsDB;
     size_t count = 0;
     size_t changed = 0;
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            if (fStatsValid) {
+                // Replace the old entry's contribution with the new one. FRESH
+                // entries are known not to be in the database yet; caches
+                // carry the database version of the others, so it is only
+                // read back for entries written without one.
+                const CCoins* pcoinsOld = it->second.pcoinsParent.get();
+                if (pcoinsOld && *pcoinsOld == it->second.coins) {
+                    // Modified and then restored; nothing to account for
+                } else {
+                    if (!(it->second.flags & CCoinsCacheEntry::FRESH)) {
+                        CCoins coinsOld;
+                        if (pcoinsOld) {
+                            if (!pcoinsOld->IsPruned())
+                                stats.Remove(it->first, *pcoinsOld);
+                        } else if (db.Read(make_pair('c', it->first), coinsOld)) {
+                            stats.Remove(it->first, coinsOld);
+                        }
+                    }
+                    if (!it->second.coins.IsPruned())
+                        stats.Add(it->first, it->second.coins);
+                }
+            }
             BatchWriteCoins(batch, it->first, it->second.coins);
             changed++;
         }
@@ -67,11 +141,18 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
         CCoinsMap::iterator itOld = it++;
         mapCoins.erase(itOld);
     }
-    if (hashBlock != uint256(0))
+    if (hashBlock != uint256(0)) {
         BatchWriteHashBestChain(batch, hashBlock);
+        stats.hashBlock = hashBlock;
+    }
+    if (fStatsValid)
+        BatchWriteStats(batch, stats);
 
     LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
-    return db.WriteBatch(batch);
+    if (!db.WriteBatch(batch))
+        return false;
+    statsDB = stats;
+    return true;
 }
 
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe)
@@ -118,17 +199,59 @@ bool CBlockTreeDB::ReadLastBlockFile(int& nFile)
 }
 
 bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
+{
+    stats.hashBlock = GetBestBlock();
+    if (!fStatsValid) {
+        // Chainstate from before the statistics were tracked: compute them
+        // once by scanning the database and keep them up to date from now on.
+        if (!ComputeStats(statsDB))
+            return false;
+        statsDB.hashBlock = stats.hashBlock;
+        CLevelDBBatch batch;
+        BatchWriteStats(batch, statsDB);
+        if (!const_cast<CLevelDBWrapper&>(db).WriteBatch(batch))
+            return error("%s : failed to write coin database statistics", __func__);
+        fStatsValid = true;
+    }
+
+    BlockMap::const_iterator mi = mapBlockIndex.find(stats.hashBlock);
+    stats.nHeight = mi != mapBlockIndex.end() ? mi->second->nHeight : 0;
+    stats.nTransactions = statsDB.nTransactions;
+    stats.nTransactionOutputs = statsDB.nTransactionOutputs;
+    stats.nSerializedSize = statsDB.nSerializedSize;
+    stats.hashSerialized = statsDB.muhash.Finalize();
+    stats.nTotalAmount = statsDB.nTotalAmount;
+    return true;
+}
+
+static bool AddToStats(CCoinsDBStats* pstats, const uint256& txid, const CCoins& coins)
+{
+    pstats->Add(txid, coins);
+    return true;
+}
+
+bool CCoinsViewDB::ComputeStats(CCoinsDBStats& stats) const
+{
+    stats = CCoinsDBStats();
+    return ForEachCoins(boost::bind(&AddToStats, &stats, boost::placeholders::_1, boost::placeholders::_2));
+}
+
+leveldb::Iterator* CCoinsViewDB::NewCoinsIterator() const
 {
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
-    pcursor->SeekToFirst();
+    return const_cast<CLevelDBWrapper*>(&db)->NewIterator();
+}
+
+bool CCoinsViewDB::ForEachCoins(const boost::function<bool(const uint256&, const CCoins&)>& func, leveldb::Iterator* pcursorIn) const
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursorOwned(pcursorIn ? NULL : NewCoinsIterator());
+    leveldb::Iterator* pcursor = pcursorIn ? pcursorIn : pcursorOwned.get();
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('c', uint256(0));
+    pcursor->Seek(ssKeySet.str());
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = GetBestBlock();
-    ss << stats.hashBlock;
-    CAmount nTotalAmount = 0;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
@@ -136,41 +259,63 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
             CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
             char chType;
             ssKey >> chType;
-            if (chType == 'c') {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CCoins coins;
-                ssValue >> coins;
-                uint256 txhash;
-                ssKey >> txhash;
-                ss << txhash;
-                ss << VARINT(coins.nVersion);
-                ss << (coins.fCoinBase ? 'c' : 'n');
-                ss << VARINT(coins.nHeight);
-                stats.nTransactions++;
-                for (unsigned int i = 0; i < coins.vout.size(); i++) {
-                    const CTxOut& out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i + 1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
-                }
-                stats.nSerializedSize += 32 + slValue.size();
-                ss << VARINT(0);
-            }
+            if (chType != 'c')
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CCoins coins;
+            ssValue >> coins;
+            uint256 txhash;
+            ssKey >> txhash;
+            if (!func(txhash, coins))
+                return false;
             pcursor->Next();
         } catch (std::exception& e) {
             return error("%s : Deserialize or I/O error - %s", __func__, e.what());
         }
     }
-    stats.nHeight = mapBlockIndex.find(GetBestBlock())->second->nHeight;
-    stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
     return true;
 }
 
+bool CCoinsViewDB::WipeCoins()
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(db.NewIterator());
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('c', uint256(0));
+    pcursor->Seek(ssKeySet.str());
+
+    CLevelDBBatch batch;
+    size_t nErased = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 'c')
+                break;
+            uint256 txhash;
+            ssKey >> txhash;
+            batch.Erase(make_pair('c', txhash));
+            if (++nErased % 100000 == 0) {
+                if (!db.WriteBatch(batch))
+                    return false;
+                batch = CLevelDBBatch();
+            }
+            pcursor->Next();
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    batch.Erase('B');
+    statsDB = CCoinsDBStats();
+    fStatsValid = true;
+    BatchWriteStats(batch, statsDB);
+    LogPrint("coindb", "Wiping %u transactions from coin database...\n", (unsigned int)nErased);
+    return db.WriteBatch(batch, true);
+}
+
 bool CBlockTreeDB::ReadTxIndex(const uint256& txid, CDiskTxPos& pos)
 {
     return Read(make_pair('t', txid), pos);
@@ -290,23 +435,138 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
     return true;
 }
 
-CZerocoinDB::CZerocoinDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "zerocoin", nCacheSize, fMemory, fWipe)
+static boost::filesystem::path GetZerocoinIndexSnapshotPath()
+{
+    return GetDataDir() / "zerocoinindex.dat";
+}
+
+CZerocoinDB::CZerocoinDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "zerocoin", nCacheSize, fMemory, fWipe),
+                                                                        fIndexed(false), nSnapshotNonce(0)
+{
+    int64_t nStart = GetTimeMillis();
+    fIndexed = LoadIndex();
+    if (fIndexed)
+        LogPrintf("Loaded %u zerocoin spends and %u mints into memory  %dms\n", mapSpends.size(), mapMints.size(), GetTimeMillis() - nStart);
+    else
+        LogPrintf("%s: unable to load the zerocoin index, mint and spend lookups will read from disk\n", __func__);
+}
+
+bool CZerocoinDB::LoadIndex()
+{
+    LOCK(cs);
+    uint64_t nNonce = 0;
+    if (Read('N', nNonce) && nNonce != 0 && ReadIndexSnapshot(nNonce)) {
+        nSnapshotNonce = nNonce;
+        return true;
+    }
+
+    mapSpends.clear();
+    mapMints.clear();
+    std::vector<std::pair<uint256, uint256> > vSpends, vMints;
+    if (!ReadCoinHashes('s', vSpends) || !ReadCoinHashes('m', vMints))
+        return false;
+    mapSpends.insert(vSpends.begin(), vSpends.end());
+    mapMints.insert(vMints.begin(), vMints.end());
+    return true;
+}
+
+bool CZerocoinDB::ReadIndexSnapshot(uint64_t nNonce)
 {
+    CAutoFile filein(fopen(GetZerocoinIndexSnapshotPath().string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+
+    try {
+        uint64_t nFileNonce;
+        std::vector<std::pair<uint256, uint256> > vSpends, vMints;
+        uint256 hashChecksum;
+        filein >> nFileNonce >> vSpends >> vMints >> hashChecksum;
+
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        hasher << nFileNonce << vSpends << vMints;
+        if (nFileNonce != nNonce || hasher.GetHash() != hashChecksum)
+            return false;
+
+        mapSpends.insert(vSpends.begin(), vSpends.end());
+        mapMints.insert(vMints.begin(), vMints.end());
+    } catch (const std::exception& e) {
+        LogPrintf("%s : Deserialize or I/O error - %s\n", __func__, e.what());
+        mapSpends.clear();
+        mapMints.clear();
+        return false;
+    }
+    return true;
+}
+
+bool CZerocoinDB::WriteIndexSnapshot()
+{
+    LOCK(cs);
+    if (!fIndexed || nSnapshotNonce != 0)
+        return true;
+
+    std::vector<std::pair<uint256, uint256> > vSpends(mapSpends.begin(), mapSpends.end());
+    std::vector<std::pair<uint256, uint256> > vMints(mapMints.begin(), mapMints.end());
+    uint64_t nNonce = GetRand(std::numeric_limits<uint64_t>::max()) | 1;
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    hasher << nNonce << vSpends << vMints;
+
+    boost::filesystem::path path = GetZerocoinIndexSnapshotPath();
+    boost::filesystem::path pathTmp = path;
+    pathTmp += ".new";
+    CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s : failed to open %s", __func__, pathTmp.string());
+    try {
+        fileout << nNonce << vSpends << vMints << hasher.GetHash();
+    } catch (const std::exception& e) {
+        return error("%s : I/O error - %s", __func__, e.what());
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+    if (!RenameOver(pathTmp, path))
+        return error("%s : failed to rename %s", __func__, pathTmp.string());
+
+    if (!Write('N', nNonce, true))
+        return error("%s : failed to write snapshot nonce", __func__);
+    nSnapshotNonce = nNonce;
+    return true;
+}
+
+void CZerocoinDB::InvalidateSnapshot(CLevelDBBatch& batch)
+{
+    AssertLockHeld(cs);
+    if (nSnapshotNonce != 0)
+        batch.Erase('N');
+}
+
+bool CZerocoinDB::WriteCoinBatch(CLevelDBBatch& batch, bool fSync)
+{
+    AssertLockHeld(cs);
+    InvalidateSnapshot(batch);
+    if (!WriteBatch(batch, fSync))
+        return false;
+    nSnapshotNonce = 0;
+    return true;
 }
 
 bool CZerocoinDB::WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::PublicCoin, uint256> >& mintInfo)
 {
+    LOCK(cs);
     CLevelDBBatch batch;
-    size_t count = 0;
+    std::vector<std::pair<uint256, uint256> > vEntries;
     for (std::vector<std::pair<libzerocoin::PublicCoin, uint256> >::const_iterator it=mintInfo.begin(); it != mintInfo.end(); it++) {
         PublicCoin pubCoin = it->first;
         uint256 hash = GetPubCoinHash(pubCoin.getValue());
         batch.Write(make_pair('m', hash), it->second);
-        ++count;
+        vEntries.push_back(make_pair(hash, it->second));
     }
 
-    LogPrint("zero", "Writing %u coin mints to db.\n", (unsigned int)count);
-    return WriteBatch(batch, true);
+    LogPrint("zero", "Writing %u coin mints to db.\n", (unsigned int)vEntries.size());
+    if (!WriteCoinBatch(batch, true))
+        return false;
+    for (const std::pair<uint256, uint256>& entry : vEntries)
+        mapMints[entry.first] = entry.second;
+    return true;
 }
 
 bool CZerocoinDB::ReadCoinMint(const CBigNum& bnPubcoin, uint256& hashTx)
@@ -316,53 +576,80 @@ bool CZerocoinDB::ReadCoinMint(const CBigNum& bnPubcoin, uint256& hashTx)
 
 bool CZerocoinDB::ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx)
 {
+    {
+        LOCK(cs);
+        if (fIndexed) {
+            CoinHashMap::const_iterator it = mapMints.find(hashPubcoin);
+            if (it == mapMints.end())
+                return false;
+            hashTx = it->second;
+            return true;
+        }
+    }
     return Read(make_pair('m', hashPubcoin), hashTx);
 }
 
 bool CZerocoinDB::EraseCoinMint(const CBigNum& bnPubcoin)
 {
+    LOCK(cs);
     uint256 hash = GetPubCoinHash(bnPubcoin);
-    return Erase(make_pair('m', hash));
+    CLevelDBBatch batch;
+    batch.Erase(make_pair('m', hash));
+    if (!WriteCoinBatch(batch, false))
+        return false;
+    mapMints.erase(hash);
+    return true;
 }
 
 bool CZerocoinDB::WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo)
 {
+    LOCK(cs);
     CLevelDBBatch batch;
-    size_t count = 0;
+    std::vector<std::pair<uint256, uint256> > vEntries;
     for (std::vector<std::pair<libzerocoin::CoinSpend, uint256> >::const_iterator it=spendInfo.begin(); it != spendInfo.end(); it++) {
-        CBigNum bnSerial = it->first.getCoinSerialNumber();
-        CDataStream ss(SER_GETHASH, 0);
-        ss << bnSerial;
-        uint256 hash = Hash(ss.begin(), ss.end());
+        uint256 hash = GetSerialHash(it->first.getCoinSerialNumber());
         batch.Write(make_pair('s', hash), it->second);
-        ++count;
+        vEntries.push_back(make_pair(hash, it->second));
     }
 
-    LogPrint("zero", "Writing %u coin spends to db.\n", (unsigned int)count);
-    return WriteBatch(batch, true);
+    LogPrint("zero", "Writing %u coin spends to db.\n", (unsigned int)vEntries.size());
+    if (!WriteCoinBatch(batch, true))
+        return false;
+    for (const std::pair<uint256, uint256>& entry : vEntries)
+        mapSpends[entry.first] = entry.second;
+    return true;
 }
 
 bool CZerocoinDB::ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash)
 {
-    CDataStream ss(SER_GETHASH, 0);
-    ss << bnSerial;
-    uint256 hash = Hash(ss.begin(), ss.end());
-
-    return Read(make_pair('s', hash), txHash);
+    return ReadCoinSpend(GetSerialHash(bnSerial), txHash);
 }
 
 bool CZerocoinDB::ReadCoinSpend(const uint256& hashSerial, uint256 &txHash)
 {
+    {
+        LOCK(cs);
+        if (fIndexed) {
+            CoinHashMap::const_iterator it = mapSpends.find(hashSerial);
+            if (it == mapSpends.end())
+                return false;
+            txHash = it->second;
+            return true;
+        }
+    }
     return Read(make_pair('s', hashSerial), txHash);
 }
 
 bool CZerocoinDB::EraseCoinSpend(const CBigNum& bnSerial)
 {
-    CDataStream ss(SER_GETHASH, 0);
-    ss << bnSerial;
-    uint256 hash = Hash(ss.begin(), ss.end());
-
-    return Erase(make_pair('s', hash));
+    LOCK(cs);
+    uint256 hash = GetSerialHash(bnSerial);
+    CLevelDBBatch batch;
+    batch.Erase(make_pair('s', hash));
+    if (!WriteCoinBatch(batch, false))
+        return false;
+    mapSpends.erase(hash);
+    return true;
 }
 
 bool CZerocoinDB::WipeCoins(std::string strType)
@@ -370,14 +657,103 @@ bool CZerocoinDB::WipeCoins(std::string strType)
     if (strType != "spends" && strType != "mints")
         return error("%s: did not recognize type %s", __func__, strType);
 
+    LOCK(cs);
+    char type = (strType == "spends" ? 's' : 'm');
+    std::vector<std::pair<uint256, uint256> > vEntries;
+    if (!ReadCoinHashes(type, vEntries))
+        return false;
+
+    CLevelDBBatch batch;
+    for (const std::pair<uint256, uint256>& entry : vEntries)
+        batch.Erase(make_pair(type, entry.first));
+    if (!WriteCoinBatch(batch, true))
+        return error("%s: failed to delete %u %s", __func__, vEntries.size(), strType);
+
+    if (type == 's')
+        mapSpends.clear();
+    else
+        mapMints.clear();
+    return true;
+}
+
+bool CZerocoinDB::ReadCoinHashes(char chType, std::vector<std::pair<uint256, uint256> >& vEntries)
+{
+    if (chType != 's' && chType != 'm')
+        return error("%s: did not recognize type %c", __func__, chType);
+
     boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair(chType, uint256(0));
+    pcursor->Seek(ssKeySet.str());
 
-    char type = (strType == "spends" ? 's' : 'm');
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chKeyType;
+            ssKey >> chKeyType;
+            if (chKeyType != chType)
+                break;
+            uint256 hash;
+            ssKey >> hash;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            uint256 txHash;
+            ssValue >> txHash;
+            vEntries.push_back(make_pair(hash, txHash));
+            pcursor->Next();
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CZerocoinDB::WriteCoinHashes(char chType, const std::vector<std::pair<uint256, uint256> >& vEntries)
+{
+    if (chType != 's' && chType != 'm')
+        return error("%s: did not recognize type %c", __func__, chType);
+
+    LOCK(cs);
+    CLevelDBBatch batch;
+    for (const std::pair<uint256, uint256>& entry : vEntries)
+        batch.Write(make_pair(chType, entry.first), entry.second);
+
+    LogPrint("zero", "Writing %u coin %s to db.\n", (unsigned int)vEntries.size(), chType == 's' ? "spends" : "mints");
+    if (!WriteCoinBatch(batch, true))
+        return false;
+    CoinHashMap& mapEntries = (chType == 's' ? mapSpends : mapMints);
+    for (const std::pair<uint256, uint256>& entry : vEntries)
+        mapEntries[entry.first] = entry.second;
+    return true;
+}
+
+bool CZerocoinDB::WriteBlockMints(const uint256& hashBlock, const std::vector<CZerocoinBlockMint>& vMints)
+{
+    return Write(make_pair('b', hashBlock), vMints);
+}
+
+bool CZerocoinDB::WriteBlockMintsBatch(const std::vector<std::pair<uint256, std::vector<CZerocoinBlockMint> > >& vBlockMints)
+{
+    CLevelDBBatch batch;
+    for (const std::pair<uint256, std::vector<CZerocoinBlockMint> >& entry : vBlockMints)
+        batch.Write(make_pair('b', entry.first), entry.second);
+    return WriteBatch(batch, true);
+}
+
+bool CZerocoinDB::ReadBlockMints(const uint256& hashBlock, std::vector<CZerocoinBlockMint>& vMints)
+{
+    return Read(make_pair('b', hashBlock), vMints);
+}
+
+bool CZerocoinDB::ReadAccumulatorValues(std::vector<std::pair<uint32_t, CBigNum> >& vValues)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
     CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
-    ssKeySet << make_pair(type, uint256(0));
+    ssKeySet << make_pair('2', (uint32_t)0);
     pcursor->Seek(ssKeySet.str());
-    // Load mapBlockIndex
-    std::set<uint256> setDelete;
+
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
@@ -385,26 +761,20 @@ bool CZerocoinDB::WipeCoins(std::string strType)
             CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
             char chType;
             ssKey >> chType;
-            if (chType == type) {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                uint256 hash;
-                ssValue >> hash;
-                setDelete.insert(hash);
-                pcursor->Next();
-            } else {
-                break; // if shutdown requested or finished loading block index
-            }
+            if (chType != '2')
+                break;
+            uint32_t nChecksum;
+            ssKey >> nChecksum;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CBigNum bnValue;
+            ssValue >> bnValue;
+            vValues.push_back(make_pair(nChecksum, bnValue));
+            pcursor->Next();
         } catch (std::exception& e) {
             return error("%s : Deserialize or I/O error - %s", __func__, e.what());
         }
     }
-
-    for (auto& hash : setDelete) {
-        if (!Erase(make_pair(type, hash)))
-            LogPrintf("%s: error failed to delete %s\n", __func__, hash.GetHex());
-    }
-
     return true;
 }
 
@@ -424,3 +794,36 @@ bool CZerocoinDB::EraseAccumulatorValue(const uint32_t& nChecksum)
     LogPrint("zero", "%s : checksum:%d\n", __func__, nChecksum);
     return Erase(make_pair('2', nChecksum));
 }
+
+CBlockFilterDB::CBlockFilterDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "blocks" / "filter", nCacheSize, fMemory, fWipe)
+{
+}
+
+bool CBlockFilterDB::WriteFilter(const CBlockFilter& filter, const uint256& hashHeader)
+{
+    CLevelDBBatch batch;
+    batch.Write(make_pair('f', filter.GetBlockHash()), filter);
+    batch.Write(make_pair('h', filter.GetBlockHash()), hashHeader);
+    batch.Write('B', filter.GetBlockHash());
+    return WriteBatch(batch);
+}
+
+bool CBlockFilterDB::ReadFilter(const uint256& hashBlock, CBlockFilter& filter)
+{
+    return Read(make_pair('f', hashBlock), filter);
+}
+
+bool CBlockFilterDB::ReadFilterHeader(const uint256& hashBlock, uint256& hashHeader)
+{
+    return Read(make_pair('h', hashBlock), hashHeader);
+}
+
+bool CBlockFilterDB::HaveFilter(const uint256& hashBlock)
+{
+    return Exists(make_pair('h', hashBlock));
+}
+
+bool CBlockFilterDB::ReadBestBlock(uint256& hashBlock)
+{
+    return Read('B', hashBlock);
+}
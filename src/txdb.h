@@ -7,8 +7,10 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "blockfilter.h"
 #include "leveldbwrapper.h"
 #include "main.h"
+#include "muhash.h"
 #include "primitives/zerocoin.h"
 
 #include <map>
@@ -16,6 +18,9 @@
 #include <utility>
 #include <vector>
 
+#include <boost/function.hpp>
+#include <boost/unordered_map.hpp>
+
 class CCoins;
 class uint256;
 
@@ -25,12 +30,58 @@ static const int64_t nDefaultDbCache = 100;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 4096 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! max. share of -dbcache given to the zerocoin database (MiB)
+static const int64_t nMaxZerocoinDbCache = 64;
+//! max. share of -dbcache given to the block filter index (MiB)
+static const int64_t nMaxBlockFilterDbCache = 16;
+
+/**
+ * Running totals and set hash of the coin database. Kept up to date by every
+ * BatchWrite and stored next to the best block, so gettxoutsetinfo does not
+ * need to scan the whole chainstate.
+ */
+class CCoinsDBStats
+{
+public:
+    //! Best block of the database these statistics were written with
+    uint256 hashBlock;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nSerializedSize;
+    CAmount nTotalAmount;
+    CMuHash3072 muhash;
+
+    CCoinsDBStats() : hashBlock(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
+
+    /** Account for a coin database entry being added */
+    void Add(const uint256& txid, const CCoins& coins);
+    /** Account for a coin database entry being removed or replaced */
+    void Remove(const uint256& txid, const CCoins& coins);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(hashBlock);
+        READWRITE(nTransactions);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nSerializedSize);
+        READWRITE(nTotalAmount);
+        READWRITE(muhash);
+    }
+};
 
 /** CCoinsView backed by the LevelDB coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CLevelDBWrapper db;
+    //! Statistics of the entries in db; only meaningful if fStatsValid
+    mutable CCoinsDBStats statsDB;
+    //! False for a chainstate written before the statistics were tracked,
+    //! until GetStats() has computed them once
+    mutable bool fStatsValid;
 
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
@@ -40,6 +91,17 @@ public:
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
     bool GetStats(CCoinsStats& stats) const;
+    /** Recompute the statistics by scanning the whole database */
+    bool ComputeStats(CCoinsDBStats& stats) const;
+    /** Iterator that keeps seeing the database as it is now, whatever is written later */
+    leveldb::Iterator* NewCoinsIterator() const;
+    /**
+     * Call func for every entry in the database, stopping early if it returns
+     * false. With pcursor (from NewCoinsIterator) the entries are read from it.
+     */
+    bool ForEachCoins(const boost::function<bool(const uint256&, const CCoins&)>& func, leveldb::Iterator* pcursor = NULL) const;
+    /** Remove all entries and the best block, e.g. before loading a UTXO snapshot */
+    bool WipeCoins();
 };
 
 /** Access to the block database (blocks/index/) */
@@ -69,7 +131,36 @@ public:
     bool LoadBlockIndexGuts();
 };
 
-/** Zerocoin database (zerocoin/) */
+/** A zerocoin mint as recorded for its block, so accumulators can be computed without reading block files */
+class CZerocoinBlockMint
+{
+public:
+    CBigNum bnValue;
+    libzerocoin::CoinDenomination denom;
+    //! False if the mint is dropped by the invalid outpoint filter of BlockToPubcoinList
+    bool fValidOutpoint;
+
+    CZerocoinBlockMint() : denom(libzerocoin::ZQ_ERROR), fValidOutpoint(true) {}
+    CZerocoinBlockMint(const CBigNum& bnValueIn, libzerocoin::CoinDenomination denomIn, bool fValidOutpointIn) : bnValue(bnValueIn), denom(denomIn), fValidOutpoint(fValidOutpointIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(bnValue);
+        READWRITE(denom);
+        READWRITE(fValidOutpoint);
+    }
+};
+
+/**
+ * Zerocoin database (zerocoin/): mint, spend and accumulator records. All mint and spend records are
+ * also held in memory, so double-spend and mint lookups, including the common
+ * negative ones, do not touch disk. The in-memory index is written to a
+ * snapshot file at shutdown and reused at the next start if the database has
+ * not changed since.
+ */
 class CZerocoinDB : public CLevelDBWrapper
 {
 public:
@@ -79,7 +170,27 @@ private:
     CZerocoinDB(const CZerocoinDB&);
     void operator=(const CZerocoinDB&);
 
+    typedef boost::unordered_map<uint256, uint256, CCoinsKeyHasher> CoinHashMap;
+
+    mutable CCriticalSection cs;
+    //! Whether mapSpends and mapMints hold every record, false if loading them failed
+    bool fIndexed;
+    //! Serial hash -> spending txid, pubcoin hash -> minting txid
+    CoinHashMap mapSpends;
+    CoinHashMap mapMints;
+    //! Nonce stored in both the database and the snapshot file while they agree, 0 if none
+    uint64_t nSnapshotNonce;
+
+    bool LoadIndex();
+    bool ReadIndexSnapshot(uint64_t nNonce);
+    /** Drop the snapshot nonce as part of a batch that changes mint or spend records */
+    void InvalidateSnapshot(CLevelDBBatch& batch);
+    bool WriteCoinBatch(CLevelDBBatch& batch, bool fSync);
+
 public:
+    /** Write the in-memory index to disk so the next start can skip scanning the database */
+    bool WriteIndexSnapshot();
+
     /** Write zleno mints to the zerocoinDB in a batch */
     bool WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::PublicCoin, uint256> >& mintInfo);
     bool ReadCoinMint(const CBigNum& bnPubcoin, uint256& txHash);
@@ -91,9 +202,41 @@ public:
     bool EraseCoinMint(const CBigNum& bnPubcoin);
     bool EraseCoinSpend(const CBigNum& bnSerial);
     bool WipeCoins(std::string strType);
+    /** Read all mint ('m') or spend ('s') records as pubcoin/serial hash -> txid */
+    bool ReadCoinHashes(char chType, std::vector<std::pair<uint256, uint256> >& vEntries);
+    /** Write mint ('m') or spend ('s') records in a batch */
+    bool WriteCoinHashes(char chType, const std::vector<std::pair<uint256, uint256> >& vEntries);
+    /** Mints of a block in block order, written when it is connected after the zerocoin start height */
+    bool WriteBlockMints(const uint256& hashBlock, const std::vector<CZerocoinBlockMint>& vMints);
+    /** Write the mints of many blocks in a batch */
+    bool WriteBlockMintsBatch(const std::vector<std::pair<uint256, std::vector<CZerocoinBlockMint> > >& vBlockMints);
+    bool ReadBlockMints(const uint256& hashBlock, std::vector<CZerocoinBlockMint>& vMints);
+    bool ReadAccumulatorValues(std::vector<std::pair<uint32_t, CBigNum> >& vValues);
     bool WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue);
     bool ReadAccumulatorValue(const uint32_t& nChecksum, CBigNum& bnValue);
     bool EraseAccumulatorValue(const uint32_t& nChecksum);
 };
 
+/**
+ * Compact block filters and their filter headers (-blockfilterindex), keyed
+ * by block hash so they survive reorganisations.
+ */
+class CBlockFilterDB : public CLevelDBWrapper
+{
+public:
+    CBlockFilterDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+private:
+    CBlockFilterDB(const CBlockFilterDB&);
+    void operator=(const CBlockFilterDB&);
+
+public:
+    /** Write the filter of a block and its filter header, and mark the block as the last one indexed */
+    bool WriteFilter(const CBlockFilter& filter, const uint256& hashHeader);
+    bool ReadFilter(const uint256& hashBlock, CBlockFilter& filter);
+    bool ReadFilterHeader(const uint256& hashBlock, uint256& hashHeader);
+    bool HaveFilter(const uint256& hashBlock);
+    bool ReadBestBlock(uint256& hashBlock);
+};
+
 #endif // BITCOIN_TXDB_H
@@ -7,6 +7,7 @@
 #include "txmempool.h"
 
 #include "clientversion.h"
+#include "core_memusage.h"
 #include "main.h"
 #include "streams.h"
 #include "util.h"
@@ -17,16 +18,22 @@
 
 using namespace std;
 
-CTxMemPoolEntry::CTxMemPoolEntry() : nFee(0), nTxSize(0), nModSize(0), nTime(0), dPriority(0.0)
+CTxMemPoolEntry::CTxMemPoolEntry() : nFee(0), nTxSize(0), nModSize(0), nUsageSize(0), nTime(0), dPriority(0.0), feeDelta(0)
 {
     nHeight = MEMPOOL_HEIGHT;
+    SetDescendantState(0, 0, 0);
+    SetAncestorState(0, 0, 0);
 }
 
-CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee, int64_t _nTime, double _dPriority, unsigned int _nHeight) : tx(_tx), nFee(_nFee), nTime(_nTime), dPriority(_dPriority), nHeight(_nHeight)
+CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee, int64_t _nTime, double _dPriority, unsigned int _nHeight) : tx(_tx), nFee(_nFee), nTime(_nTime), dPriority(_dPriority), nHeight(_nHeight), feeDelta(0)
 {
     nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
 
     nModSize = tx.CalculateModifiedSize(nTxSize);
+    nUsageSize = RecursiveDynamicUsage(tx);
+
+    SetDescendantState(1, nTxSize, nFee);
+    SetAncestorState(1, nTxSize, nFee);
 }
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
@@ -34,6 +41,20 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
     *this = other;
 }
 
+void CTxMemPoolEntry::SetDescendantState(uint64_t nCount, uint64_t nSize, CAmount nModFees)
+{
+    nCountWithDescendants = nCount;
+    nSizeWithDescendants = nSize;
+    nModFeesWithDescendants = nModFees;
+}
+
+void CTxMemPoolEntry::SetAncestorState(uint64_t nCount, uint64_t nSize, CAmount nModFees)
+{
+    nCountWithAncestors = nCount;
+    nSizeWithAncestors = nSize;
+    nModFeesWithAncestors = nModFees;
+}
+
 double
 CTxMemPoolEntry::GetPriority(unsigned int currentHeight) const
 {
@@ -356,7 +377,13 @@ public:
 
 
 CTxMemPool::CTxMemPool(const CFeeRate& _minRelayFee) : nTransactionsUpdated(0),
-                                                       minRelayFee(_minRelayFee)
+                                                       minRelayFee(_minRelayFee),
+                                                       totalTxSize(0),
+                                                       cachedInnerUsage(0),
+                                                       lastRollingFeeUpdate(0),
+                                                       blockSinceLastRollingFeeBump(false),
+                                                       rollingMinimumFeeRate(0),
+                                                       nLinks(0)
 {
     // Sanity checks off by default for performance, because otherwise
     // accepting transactions becomes O(N^2) where N is the number
@@ -410,17 +437,216 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry& entry)
     LOCK(cs);
     {
         mapTx[hash] = entry;
-        const CTransaction& tx = mapTx[hash].GetTx();
+        CTxMemPoolEntry& newEntry = mapTx[hash];
+        const CTransaction& tx = newEntry.GetTx();
+        TxLinks& links = mapLinks[hash];
         if(!tx.IsZerocoinSpend()) {
-            for (unsigned int i = 0; i < tx.vin.size(); i++)
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 mapNextTx[tx.vin[i].prevout] = CInPoint(&tx, i);
+                const uint256& hashParent = tx.vin[i].prevout.hash;
+                if (mapTx.count(hashParent) && links.setParents.insert(hashParent).second) {
+                    mapLinks[hashParent].setChildren.insert(hash);
+                    nLinks++;
+                }
+            }
+        }
+
+        // Transactions already spending this one, when it comes back from a disconnected block
+        for (std::map<COutPoint, CInPoint>::iterator it = mapNextTx.lower_bound(COutPoint(hash, 0)); it != mapNextTx.end() && it->first.hash == hash; ++it) {
+            const uint256 hashChild = it->second.ptx->GetHash();
+            if (links.setChildren.insert(hashChild).second) {
+                mapLinks[hashChild].setParents.insert(hash);
+                nLinks++;
+            }
         }
+
+        // Carry over fee deltas set with prioritisetransaction before the tx arrived
+        std::map<uint256, std::pair<double, CAmount> >::const_iterator pos = mapDeltas.find(hash);
+        if (pos != mapDeltas.end())
+            newEntry.UpdateFeeDelta(pos->second.second);
+        IndexEntry(hash, newEntry);
+
+        std::set<uint256> setUpdate;
+        CalculateAncestors(hash, setUpdate);
+        CalculateDescendants(hash, setUpdate);
+        setUpdate.insert(hash);
+        UpdatePackageState(setUpdate);
+
         nTransactionsUpdated++;
         totalTxSize += entry.GetTxSize();
+        cachedInnerUsage += entry.DynamicMemoryUsage();
+    }
+    return true;
+}
+
+void CTxMemPool::removeUnchecked(const uint256& hash)
+{
+    AssertLockHeld(cs);
+    std::set<uint256> setUpdate;
+    CalculateAncestors(hash, setUpdate);
+    CalculateDescendants(hash, setUpdate);
+
+    const CTxMemPoolEntry& entry = mapTx[hash];
+    BOOST_FOREACH (const CTxIn& txin, entry.GetTx().vin)
+        mapNextTx.erase(txin.prevout);
+    UnindexEntry(hash, entry);
+
+    std::map<uint256, TxLinks>::iterator itLinks = mapLinks.find(hash);
+    if (itLinks != mapLinks.end()) {
+        BOOST_FOREACH (const uint256& hashParent, itLinks->second.setParents)
+            mapLinks[hashParent].setChildren.erase(hash);
+        BOOST_FOREACH (const uint256& hashChild, itLinks->second.setChildren)
+            mapLinks[hashChild].setParents.erase(hash);
+        nLinks -= itLinks->second.setParents.size() + itLinks->second.setChildren.size();
+        mapLinks.erase(itLinks);
+    }
+
+    totalTxSize -= entry.GetTxSize();
+    cachedInnerUsage -= entry.DynamicMemoryUsage();
+    mapTx.erase(hash);
+    nTransactionsUpdated++;
+
+    UpdatePackageState(setUpdate);
+}
+
+const std::set<uint256>& CTxMemPool::GetMemPoolParents(const uint256& hash) const
+{
+    static const std::set<uint256> setEmpty;
+    LOCK(cs);
+    std::map<uint256, TxLinks>::const_iterator it = mapLinks.find(hash);
+    return it == mapLinks.end() ? setEmpty : it->second.setParents;
+}
+
+const std::set<uint256>& CTxMemPool::GetMemPoolChildren(const uint256& hash) const
+{
+    static const std::set<uint256> setEmpty;
+    LOCK(cs);
+    std::map<uint256, TxLinks>::const_iterator it = mapLinks.find(hash);
+    return it == mapLinks.end() ? setEmpty : it->second.setChildren;
+}
+
+void CTxMemPool::CalculateAncestors(const uint256& hash, std::set<uint256>& setAncestors) const
+{
+    LOCK(cs);
+    std::vector<uint256> vToVisit(1, hash);
+    while (!vToVisit.empty()) {
+        std::map<uint256, TxLinks>::const_iterator it = mapLinks.find(vToVisit.back());
+        vToVisit.pop_back();
+        if (it == mapLinks.end())
+            continue;
+        BOOST_FOREACH (const uint256& hashParent, it->second.setParents) {
+            if (hashParent != hash && setAncestors.insert(hashParent).second)
+                vToVisit.push_back(hashParent);
+        }
+    }
+}
+
+void CTxMemPool::CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const
+{
+    LOCK(cs);
+    std::vector<uint256> vToVisit(1, hash);
+    while (!vToVisit.empty()) {
+        std::map<uint256, TxLinks>::const_iterator it = mapLinks.find(vToVisit.back());
+        vToVisit.pop_back();
+        if (it == mapLinks.end())
+            continue;
+        BOOST_FOREACH (const uint256& hashChild, it->second.setChildren) {
+            if (hashChild != hash && setDescendants.insert(hashChild).second)
+                vToVisit.push_back(hashChild);
+        }
+    }
+}
+
+bool CTxMemPool::CalculateMemPoolAncestors(const CTransaction& tx, uint64_t nTxSize, std::set<uint256>& setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string& errString) const
+{
+    LOCK(cs);
+    if (tx.IsZerocoinSpend())
+        return true;
+
+    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+        const uint256& hashParent = txin.prevout.hash;
+        if (!mapTx.count(hashParent) || !setAncestors.insert(hashParent).second)
+            continue;
+        CalculateAncestors(hashParent, setAncestors);
+    }
+
+    if (setAncestors.size() + 1 > limitAncestorCount) {
+        errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
+        return false;
+    }
+
+    uint64_t nSizeWithAncestors = nTxSize;
+    BOOST_FOREACH (const uint256& hashAncestor, setAncestors) {
+        const CTxMemPoolEntry& entry = mapTx.find(hashAncestor)->second;
+        nSizeWithAncestors += entry.GetTxSize();
+        if (entry.GetCountWithDescendants() + 1 > limitDescendantCount) {
+            errString = strprintf("too many descendants for tx %s [limit: %u]", hashAncestor.ToString(), limitDescendantCount);
+            return false;
+        }
+        if (entry.GetSizeWithDescendants() + nTxSize > limitDescendantSize) {
+            errString = strprintf("exceeds descendant size limit for tx %s [limit: %u]", hashAncestor.ToString(), limitDescendantSize);
+            return false;
+        }
+    }
+
+    if (nSizeWithAncestors > limitAncestorSize) {
+        errString = strprintf("exceeds ancestor size limit [limit: %u]", limitAncestorSize);
+        return false;
     }
     return true;
 }
 
+void CTxMemPool::IndexEntry(const uint256& hash, const CTxMemPoolEntry& entry)
+{
+    setEntriesByDescendantScore.insert(std::make_pair(GetDescendantScore(entry), hash));
+    setEntriesByAncestorScore.insert(std::make_pair(GetAncestorScore(entry), hash));
+    setEntriesByTime.insert(std::make_pair(entry.GetTime(), hash));
+}
+
+void CTxMemPool::UnindexEntry(const uint256& hash, const CTxMemPoolEntry& entry)
+{
+    setEntriesByDescendantScore.erase(std::make_pair(GetDescendantScore(entry), hash));
+    setEntriesByAncestorScore.erase(std::make_pair(GetAncestorScore(entry), hash));
+    setEntriesByTime.erase(std::make_pair(entry.GetTime(), hash));
+}
+
+void CTxMemPool::UpdatePackageState(const std::set<uint256>& setEntries)
+{
+    // Recompute the totals from the links rather than adjusting them, the
+    // packages are bounded by the ancestor and descendant limits
+    BOOST_FOREACH (const uint256& hash, setEntries) {
+        std::map<uint256, CTxMemPoolEntry>::iterator it = mapTx.find(hash);
+        if (it == mapTx.end())
+            continue;
+        CTxMemPoolEntry& entry = it->second;
+
+        std::set<uint256> setAncestors;
+        CalculateAncestors(hash, setAncestors);
+        uint64_t nSizeWithAncestors = entry.GetTxSize();
+        CAmount nModFeesWithAncestors = entry.GetModifiedFee();
+        BOOST_FOREACH (const uint256& hashAncestor, setAncestors) {
+            const CTxMemPoolEntry& ancestor = mapTx[hashAncestor];
+            nSizeWithAncestors += ancestor.GetTxSize();
+            nModFeesWithAncestors += ancestor.GetModifiedFee();
+        }
+
+        std::set<uint256> setDescendants;
+        CalculateDescendants(hash, setDescendants);
+        uint64_t nSizeWithDescendants = entry.GetTxSize();
+        CAmount nModFeesWithDescendants = entry.GetModifiedFee();
+        BOOST_FOREACH (const uint256& hashDescendant, setDescendants) {
+            const CTxMemPoolEntry& descendant = mapTx[hashDescendant];
+            nSizeWithDescendants += descendant.GetTxSize();
+            nModFeesWithDescendants += descendant.GetModifiedFee();
+        }
+
+        UnindexEntry(hash, entry);
+        entry.SetAncestorState(setAncestors.size() + 1, nSizeWithAncestors, nModFeesWithAncestors);
+        entry.SetDescendantState(setDescendants.size() + 1, nSizeWithDescendants, nModFeesWithDescendants);
+        IndexEntry(hash, entry);
+    }
+}
+
 
 void CTxMemPool::remove(const CTransaction& origTx, std::list<CTransaction>& removed, bool fRecursive)
 {
@@ -455,13 +681,9 @@ void CTxMemPool::remove(const CTransaction& origTx, std::list<CTransaction>& rem
                     txToRemove.push_back(it->second.ptx->GetHash());
                 }
             }
-            BOOST_FOREACH (const CTxIn& txin, tx.vin)
-                mapNextTx.erase(txin.prevout);
 
             removed.push_back(tx);
-            totalTxSize -= mapTx[hash].GetTxSize();
-            mapTx.erase(hash);
-            nTransactionsUpdated++;
+            removeUnchecked(hash);
         }
     }
 }
@@ -526,6 +748,8 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
         removeConflicts(tx, conflicts);
         ClearPrioritisation(tx.GetHash());
     }
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = true;
 }
 
 
@@ -534,7 +758,16 @@ void CTxMemPool::clear()
     LOCK(cs);
     mapTx.clear();
     mapNextTx.clear();
+    mapLinks.clear();
+    nLinks = 0;
+    setEntriesByDescendantScore.clear();
+    setEntriesByAncestorScore.clear();
+    setEntriesByTime.clear();
     totalTxSize = 0;
+    cachedInnerUsage = 0;
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = false;
+    rollingMinimumFeeRate = 0;
     ++nTransactionsUpdated;
 }
 
@@ -546,6 +779,7 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
     LogPrint("mempool", "Checking mempool with %u transactions and %u inputs\n", (unsigned int)mapTx.size(), (unsigned int)mapNextTx.size());
 
     uint64_t checkTotal = 0;
+    uint64_t innerUsage = 0;
 
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
 
@@ -554,6 +788,20 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
     for (std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
         unsigned int i = 0;
         checkTotal += it->second.GetTxSize();
+        innerUsage += it->second.DynamicMemoryUsage();
+        assert(setEntriesByDescendantScore.count(std::make_pair(GetDescendantScore(it->second), it->first)));
+        assert(setEntriesByAncestorScore.count(std::make_pair(GetAncestorScore(it->second), it->first)));
+        assert(setEntriesByTime.count(std::make_pair(it->second.GetTime(), it->first)));
+
+        // Check the links and the package totals
+        std::set<uint256> setParentsCheck;
+        std::map<uint256, TxLinks>::const_iterator itLinks = mapLinks.find(it->first);
+        assert(itLinks != mapLinks.end());
+        std::set<uint256> setAncestors, setDescendants;
+        CalculateAncestors(it->first, setAncestors);
+        CalculateDescendants(it->first, setDescendants);
+        assert(it->second.GetCountWithAncestors() == setAncestors.size() + 1);
+        assert(it->second.GetCountWithDescendants() == setDescendants.size() + 1);
         const CTransaction& tx = it->second.GetTx();
         bool fDependsWait = false;
         BOOST_FOREACH (const CTxIn& txin, tx.vin) {
@@ -563,6 +811,7 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
                 const CTransaction& tx2 = it2->second.GetTx();
                 assert(tx2.vout.size() > txin.prevout.n && !tx2.vout[txin.prevout.n].IsNull());
                 fDependsWait = true;
+                setParentsCheck.insert(txin.prevout.hash);
             } else {
                 const CCoins* coins = pcoins->AccessCoins(txin.prevout.hash);
                 assert(coins && coins->IsAvailable(txin.prevout.n));
@@ -574,6 +823,7 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
             assert(it3->second.n == i);
             i++;
         }
+        assert(setParentsCheck == itLinks->second.setParents);
         if (fDependsWait)
             waitingOnDependants.push_back(&it->second);
         else {
@@ -610,6 +860,11 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
     }
 
     assert(totalTxSize == checkTotal);
+    assert(innerUsage == cachedInnerUsage);
+    assert(setEntriesByDescendantScore.size() == mapTx.size());
+    assert(setEntriesByAncestorScore.size() == mapTx.size());
+    assert(mapLinks.size() == mapTx.size());
+    assert(setEntriesByTime.size() == mapTx.size());
 }
 
 void CTxMemPool::queryHashes(vector<uint256>& vtxid)
@@ -689,6 +944,19 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const string strHash,
         std::pair<double, CAmount>& deltas = mapDeltas[hash];
         deltas.first += dPriorityDelta;
         deltas.second += nFeeDelta;
+        std::map<uint256, CTxMemPoolEntry>::iterator it = mapTx.find(hash);
+        if (it != mapTx.end()) {
+            UnindexEntry(hash, it->second);
+            it->second.UpdateFeeDelta(deltas.second);
+            IndexEntry(hash, it->second);
+
+            // The fee counts towards the packages of its ancestors and descendants
+            std::set<uint256> setUpdate;
+            CalculateAncestors(hash, setUpdate);
+            CalculateDescendants(hash, setUpdate);
+            setUpdate.insert(hash);
+            UpdatePackageState(setUpdate);
+        }
     }
     LogPrintf("PrioritiseTransaction: %s priority += %f, fee += %d\n", strHash, dPriorityDelta, FormatMoney(nFeeDelta));
 }
@@ -710,6 +978,116 @@ void CTxMemPool::ClearPrioritisation(const uint256 hash)
     mapDeltas.erase(hash);
 }
 
+size_t CTxMemPool::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return memusage::DynamicUsage(mapTx) + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) +
+           memusage::DynamicUsage(mapLinks) + nLinks * memusage::MallocUsage(sizeof(memusage::stl_tree_node<uint256>)) +
+           memusage::DynamicUsage(setEntriesByDescendantScore) + memusage::DynamicUsage(setEntriesByAncestorScore) +
+           memusage::DynamicUsage(setEntriesByTime) + cachedInnerUsage;
+}
+
+CAmount CTxMemPool::GetDescendantScore(const CTxMemPoolEntry& entry) const
+{
+    // Zerocoin spends pay no fee but are meant to get into the next blocks, evict them last
+    if (entry.GetTx().IsZerocoinSpend())
+        return Params().MaxMoneyOut();
+
+    // A transaction is worth keeping if either it or its package pays well
+    CAmount nFeeRate = CFeeRate(entry.GetModifiedFee(), entry.GetTxSize()).GetFeePerK();
+    CAmount nPackageFeeRate = CFeeRate(entry.GetModFeesWithDescendants(), entry.GetSizeWithDescendants()).GetFeePerK();
+    return std::max(nFeeRate, nPackageFeeRate);
+}
+
+CAmount CTxMemPool::GetAncestorScore(const CTxMemPoolEntry& entry) const
+{
+    // Mine zerocoin spends first, as their priority did before
+    if (entry.GetTx().IsZerocoinSpend())
+        return Params().MaxMoneyOut();
+
+    // Mining the transaction means mining its ancestors too, count the worse of the two
+    CAmount nFeeRate = CFeeRate(entry.GetModifiedFee(), entry.GetTxSize()).GetFeePerK();
+    CAmount nPackageFeeRate = CFeeRate(entry.GetModFeesWithAncestors(), entry.GetSizeWithAncestors()).GetFeePerK();
+    return std::min(nFeeRate, nPackageFeeRate);
+}
+
+CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const
+{
+    LOCK(cs);
+    if (!blockSinceLastRollingFeeBump || rollingMinimumFeeRate == 0)
+        return CFeeRate(rollingMinimumFeeRate);
+
+    int64_t time = GetTime();
+    if (time > lastRollingFeeUpdate + 10) {
+        double halflife = ROLLING_FEE_HALFLIFE;
+        if (DynamicMemoryUsage() < sizelimit / 4)
+            halflife /= 4;
+        else if (DynamicMemoryUsage() < sizelimit / 2)
+            halflife /= 2;
+
+        rollingMinimumFeeRate = rollingMinimumFeeRate / pow(2.0, (time - lastRollingFeeUpdate) / halflife);
+        lastRollingFeeUpdate = time;
+
+        if (rollingMinimumFeeRate < minRelayFee.GetFeePerK() / 2) {
+            rollingMinimumFeeRate = 0;
+            return CFeeRate(0);
+        }
+    }
+    return std::max(CFeeRate(rollingMinimumFeeRate), minRelayFee);
+}
+
+void CTxMemPool::trackPackageRemoved(const CFeeRate& rate)
+{
+    AssertLockHeld(cs);
+    if (rate.GetFeePerK() > rollingMinimumFeeRate) {
+        rollingMinimumFeeRate = rate.GetFeePerK();
+        blockSinceLastRollingFeeBump = false;
+    }
+}
+
+void CTxMemPool::TrimToSize(size_t sizelimit)
+{
+    LOCK(cs);
+
+    unsigned int nTxnRemoved = 0;
+    CFeeRate maxFeeRateRemoved(0);
+    while (!setEntriesByDescendantScore.empty() && DynamicMemoryUsage() > sizelimit) {
+        const std::pair<CAmount, uint256> lowest = *setEntriesByDescendantScore.begin();
+        CTransaction tx = mapTx[lowest.second].GetTx();
+
+        // Whatever replaces the evicted transactions has to pay more than they
+        // did, by at least the relay fee, or the pool would churn on equal fees
+        if (!tx.IsZerocoinSpend()) {
+            CFeeRate removed(lowest.first + minRelayFee.GetFeePerK());
+            trackPackageRemoved(removed);
+            maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+        }
+
+        std::list<CTransaction> removedTxs;
+        remove(tx, removedTxs, true);
+        nTxnRemoved += removedTxs.size();
+    }
+
+    if (maxFeeRateRemoved > CFeeRate(0))
+        LogPrint("mempool", "Removed %u txn, rolling minimum fee bumped to %s\n", nTxnRemoved, maxFeeRateRemoved.ToString());
+}
+
+int CTxMemPool::Expire(int64_t time)
+{
+    LOCK(cs);
+    std::vector<CTransaction> vExpired;
+    for (std::set<std::pair<int64_t, uint256> >::const_iterator it = setEntriesByTime.begin(); it != setEntriesByTime.end() && it->first < time; ++it)
+        vExpired.push_back(mapTx[it->second].GetTx());
+
+    int nRemoved = 0;
+    BOOST_FOREACH (const CTransaction& tx, vExpired) {
+        std::list<CTransaction> removed;
+        remove(tx, removed, true);
+        nRemoved += removed.size();
+    }
+    return nRemoved;
+}
+
 
 CCoinsViewMemPool::CCoinsViewMemPool(CCoinsView* baseIn, CTxMemPool& mempoolIn) : CCoinsViewBacked(baseIn), mempool(mempoolIn) {}
 
@@ -8,6 +8,7 @@
 #define BITCOIN_TXMEMPOOL_H
 
 #include <list>
+#include <set>
 
 #include "amount.h"
 #include "coins.h"
@@ -42,9 +43,20 @@ private:
     CAmount nFee;         //! Cached to avoid expensive parent-transaction lookups
     size_t nTxSize;       //! ... and avoid recomputing tx size
     size_t nModSize;      //! ... and modified size for priority
+    size_t nUsageSize;    //! ... and total memory usage
     int64_t nTime;        //! Local time when entering the mempool
     double dPriority;     //! Priority when entering the mempool
     unsigned int nHeight; //! Chain height when entering the mempool
+    CAmount feeDelta;     //! Fee delta set with prioritisetransaction
+
+    // Totals of the transaction and its in-mempool descendants, and of the
+    // transaction and its in-mempool ancestors. Maintained by CTxMemPool.
+    uint64_t nCountWithDescendants;
+    uint64_t nSizeWithDescendants;
+    CAmount nModFeesWithDescendants;
+    uint64_t nCountWithAncestors;
+    uint64_t nSizeWithAncestors;
+    CAmount nModFeesWithAncestors;
 
 public:
     CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee, int64_t _nTime, double _dPriority, unsigned int _nHeight);
@@ -54,9 +66,22 @@ public:
     const CTransaction& GetTx() const { return this->tx; }
     double GetPriority(unsigned int currentHeight) const;
     CAmount GetFee() const { return nFee; }
+    CAmount GetModifiedFee() const { return nFee + feeDelta; }
     size_t GetTxSize() const { return nTxSize; }
     int64_t GetTime() const { return nTime; }
     unsigned int GetHeight() const { return nHeight; }
+    size_t DynamicMemoryUsage() const { return nUsageSize; }
+
+    uint64_t GetCountWithDescendants() const { return nCountWithDescendants; }
+    uint64_t GetSizeWithDescendants() const { return nSizeWithDescendants; }
+    CAmount GetModFeesWithDescendants() const { return nModFeesWithDescendants; }
+    uint64_t GetCountWithAncestors() const { return nCountWithAncestors; }
+    uint64_t GetSizeWithAncestors() const { return nSizeWithAncestors; }
+    CAmount GetModFeesWithAncestors() const { return nModFeesWithAncestors; }
+
+    void UpdateFeeDelta(CAmount newFeeDelta) { feeDelta = newFeeDelta; }
+    void SetDescendantState(uint64_t nCount, uint64_t nSize, CAmount nModFees);
+    void SetAncestorState(uint64_t nCount, uint64_t nSize, CAmount nModFees);
 };
 
 class CMinerPolicyEstimator;
@@ -101,12 +126,41 @@ private:
 
     CFeeRate minRelayFee; //! Passed to constructor to avoid dependency on main
     uint64_t totalTxSize; //! sum of all mempool tx' byte sizes
+    uint64_t cachedInnerUsage; //! sum of dynamic memory usage of all the map elements (NOT the maps themselves)
+
+    mutable int64_t lastRollingFeeUpdate;
+    mutable bool blockSinceLastRollingFeeBump;
+    mutable double rollingMinimumFeeRate; //! minimum fee to get into the pool, decreases exponentially
+
+    //! In-mempool parents and children of each entry
+    struct TxLinks {
+        std::set<uint256> setParents;
+        std::set<uint256> setChildren;
+    };
+    std::map<uint256, TxLinks> mapLinks;
+    uint64_t nLinks; //! number of parent-child links, each stored on both sides
+
+    //! Entries ordered by descendant score, the eviction order, and by the time they entered the pool
+    std::set<std::pair<CAmount, uint256> > setEntriesByDescendantScore;
+    std::set<std::pair<int64_t, uint256> > setEntriesByTime;
+
+    CAmount GetDescendantScore(const CTxMemPoolEntry& entry) const;
+    CAmount GetAncestorScore(const CTxMemPoolEntry& entry) const;
+    void IndexEntry(const uint256& hash, const CTxMemPoolEntry& entry);
+    void UnindexEntry(const uint256& hash, const CTxMemPoolEntry& entry);
+    void UpdatePackageState(const std::set<uint256>& setEntries);
+    void removeUnchecked(const uint256& hash);
+    void trackPackageRemoved(const CFeeRate& rate);
 
 public:
+    static const int ROLLING_FEE_HALFLIFE = 60 * 60 * 12; // public only for testing
+
     mutable CCriticalSection cs;
     std::map<uint256, CTxMemPoolEntry> mapTx;
     std::map<COutPoint, CInPoint> mapNextTx;
     std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    //! Entries ordered by ancestor score, the fee rate of the package a miner has to include to get them
+    std::set<std::pair<CAmount, uint256> > setEntriesByAncestorScore;
 
     CTxMemPool(const CFeeRate& _minRelayFee);
     ~CTxMemPool();
@@ -137,6 +191,41 @@ public:
     void ApplyDeltas(const uint256 hash, double& dPriorityDelta, CAmount& nFeeDelta);
     void ClearPrioritisation(const uint256 hash);
 
+    /**
+     * The minimum fee to get into the mempool, which may itself not be enough
+     * for larger-sized transactions. It rises when transactions are evicted
+     * to stay within sizelimit and decays back to zero over
+     * ROLLING_FEE_HALFLIFE once blocks are found.
+     */
+    CFeeRate GetMinFee(size_t sizelimit) const;
+
+    /**
+     * Remove transactions from the mempool until its dynamic size is <=
+     * sizelimit, lowest descendant score first. A transaction is evicted
+     * together with the mempool transactions spending it.
+     */
+    void TrimToSize(size_t sizelimit);
+
+    /** Expire all transactions (and their dependencies) in the mempool older than time. Return the number of removed transactions. */
+    int Expire(int64_t time);
+
+    /** In-mempool parents and children of the mempool transaction hash */
+    const std::set<uint256>& GetMemPoolParents(const uint256& hash) const;
+    const std::set<uint256>& GetMemPoolChildren(const uint256& hash) const;
+
+    /** Add the in-mempool ancestors of the mempool transaction hash to setAncestors */
+    void CalculateAncestors(const uint256& hash, std::set<uint256>& setAncestors) const;
+
+    /** Add the in-mempool descendants of the mempool transaction hash to setDescendants */
+    void CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const;
+
+    /**
+     * Find the in-mempool ancestors of tx, which is not in the mempool yet,
+     * and check that adding tx keeps every package within the limits. The
+     * counts and sizes include tx itself.
+     */
+    bool CalculateMemPoolAncestors(const CTransaction& tx, uint64_t nTxSize, std::set<uint256>& setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string& errString) const;
+
     unsigned long size()
     {
         LOCK(cs);
@@ -156,6 +245,8 @@ public:
 
     bool lookup(uint256 hash, CTransaction& result) const;
 
+    size_t DynamicMemoryUsage() const;
+
     /** Estimate fee rate needed to get into the next nBlocks */
     CFeeRate estimateFee(int nBlocks) const;
 
@@ -7,8 +7,21 @@
 
 #include "validationinterface.h"
 
+#include "primitives/block.h"
+#include "scheduler.h"
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
 static CMainSignals g_signals;
 
+/**
+ * Serial queue for the notifications that are delivered in the background.
+ * NULL until a scheduler is registered, in which case they are delivered
+ * synchronously. Only changed during startup and shutdown.
+ */
+static SingleThreadedSchedulerClient* pBackgroundCallbacks = NULL;
+
 CMainSignals& GetMainSignals()
 {
     return g_signals;
@@ -56,6 +69,113 @@ void UnregisterAllValidationInterfaces() {
 // XX42    g_signals.EraseTransaction.disconnect_all_slots();
 }
 
-void SyncWithWallets(const CTransaction &tx, const CBlock *pblock = NULL) {
-    g_signals.SyncTransaction(tx, pblock);
+void RegisterBackgroundSignalScheduler(CScheduler& scheduler) {
+    assert(!pBackgroundCallbacks);
+    pBackgroundCallbacks = new SingleThreadedSchedulerClient(&scheduler);
+}
+
+void UnregisterBackgroundSignalScheduler() {
+    if (!pBackgroundCallbacks)
+        return;
+    pBackgroundCallbacks->EmptyQueue();
+    delete pBackgroundCallbacks;
+    pBackgroundCallbacks = NULL;
+}
+
+size_t ValidationCallbacksPending() {
+    if (!pBackgroundCallbacks)
+        return 0;
+    return pBackgroundCallbacks->CallbacksPending();
+}
+
+struct CSyncPoint {
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fReached;
+
+    CSyncPoint() : fReached(false) {}
+};
+
+static void ReachSyncPoint(CSyncPoint* psync) {
+    {
+        boost::unique_lock<boost::mutex> lock(psync->mutex);
+        psync->fReached = true;
+    }
+    psync->cond.notify_all();
+}
+
+void SyncWithValidationInterfaceQueue() {
+    if (!pBackgroundCallbacks)
+        return;
+    CSyncPoint sync;
+    pBackgroundCallbacks->AddToProcessQueue(boost::bind(&ReachSyncPoint, &sync));
+    boost::unique_lock<boost::mutex> lock(sync.mutex);
+    while (!sync.fReached)
+        sync.cond.wait(lock);
+}
+
+void LimitValidationInterfaceQueue() {
+    if (ValidationCallbacksPending() > MAX_VALIDATION_CALLBACKS_PENDING)
+        SyncWithValidationInterfaceQueue();
+}
+
+static void SyncTransaction(const CTransaction tx) {
+    g_signals.SyncTransaction(tx, NULL);
+}
+
+static void SyncBlockTransactions(boost::shared_ptr<const CBlock> pblock) {
+    for (const CTransaction& tx : pblock->vtx)
+        g_signals.SyncTransaction(tx, pblock.get());
+}
+
+static void UpdatedBlockTip(const CBlockIndex* pindex) {
+    g_signals.UpdatedBlockTip(pindex);
+}
+
+static void NotifyTransactionLock(const CTransaction tx) {
+    g_signals.NotifyTransactionLock(tx);
+}
+
+static void SetBestChain(const CBlockLocator locator) {
+    g_signals.SetBestChain(locator);
+}
+
+void SyncWithWallets(const CTransaction& tx) {
+    if (pBackgroundCallbacks)
+        pBackgroundCallbacks->AddToProcessQueue(boost::bind(&SyncTransaction, tx));
+    else
+        g_signals.SyncTransaction(tx, NULL);
+}
+
+void SyncWithWallets(const CBlock& block) {
+    if (pBackgroundCallbacks) {
+        // One queue entry per block; the listeners see the transactions in block order.
+        boost::shared_ptr<const CBlock> pblock(new CBlock(block));
+        pBackgroundCallbacks->AddToProcessQueue(boost::bind(&SyncBlockTransactions, pblock));
+    } else {
+        for (const CTransaction& tx : block.vtx)
+            g_signals.SyncTransaction(tx, &block);
+    }
+}
+
+void SignalUpdatedBlockTip(const CBlockIndex* pindex) {
+    // Block index entries are never freed while running, so the pointer stays valid.
+    if (pBackgroundCallbacks)
+        pBackgroundCallbacks->AddToProcessQueue(boost::bind(&UpdatedBlockTip, pindex));
+    else
+        g_signals.UpdatedBlockTip(pindex);
+}
+
+void SignalTransactionLock(const CTransaction& tx) {
+    if (pBackgroundCallbacks)
+        pBackgroundCallbacks->AddToProcessQueue(boost::bind(&NotifyTransactionLock, tx));
+    else
+        g_signals.NotifyTransactionLock(tx);
+}
+
+void SignalSetBestChain(const CBlockLocator& locator) {
+    if (pBackgroundCallbacks)
+        pBackgroundCallbacks->AddToProcessQueue(boost::bind(&SetBestChain, locator));
+    else
+        g_signals.SetBestChain(locator);
 }
@@ -15,11 +15,18 @@ class CBlock;
 struct CBlockLocator;
 class CBlockIndex;
 class CReserveScript;
+class CScheduler;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
 class uint256;
 
+/**
+ * Maximum number of notifications that may be queued for the background
+ * listeners before block connection waits for them to catch up.
+ */
+static const size_t MAX_VALIDATION_CALLBACKS_PENDING = 1000;
+
 // These functions dispatch to one or all registered wallets
 
 /** Register a wallet to receive updates from core */
@@ -28,8 +35,34 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn);
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
-/** Push an updated transaction to all registered wallets */
-void SyncWithWallets(const CTransaction& tx, const CBlock* pblock);
+/** Push an updated transaction (not in any block) to all registered wallets */
+void SyncWithWallets(const CTransaction& tx);
+/** Push all transactions of a newly connected block to all registered wallets */
+void SyncWithWallets(const CBlock& block);
+/** Notify all registered wallets of a new chain tip */
+void SignalUpdatedBlockTip(const CBlockIndex* pindex);
+/** Notify all registered wallets of an updated transaction lock */
+void SignalTransactionLock(const CTransaction& tx);
+/** Notify all registered wallets of a new best chain locator */
+void SignalSetBestChain(const CBlockLocator& locator);
+
+/**
+ * Deliver the queued notifications above (SyncTransaction, UpdatedBlockTip,
+ * NotifyTransactionLock and SetBestChain) in order on the given scheduler
+ * instead of on the validating thread. All other signals stay synchronous.
+ */
+void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+/** Deliver anything still queued on the calling thread and go back to synchronous delivery */
+void UnregisterBackgroundSignalScheduler();
+/** Number of notifications queued but not yet delivered */
+size_t ValidationCallbacksPending();
+/**
+ * Wait until every notification queued so far has been delivered.
+ * Must not be called with cs_main held, as listeners take it.
+ */
+void SyncWithValidationInterfaceQueue();
+/** Wait for the listeners if more than MAX_VALIDATION_CALLBACKS_PENDING notifications are queued */
+void LimitValidationInterfaceQueue();
 
 class CValidationInterface {
 protected:
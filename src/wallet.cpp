@@ -11,6 +11,7 @@
 
 #include "accumulators.h"
 #include "base58.h"
+#include "blockfilter.h"
 #include "checkpoints.h"
 #include "coincontrol.h"
 #include "kernel.h"
@@ -33,6 +34,7 @@
 #include "zlenowallet.h"
 #include "primitives/deterministicmint.h"
 #include <assert.h>
+#include <atomic>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -747,6 +749,22 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 }
 
+void CWallet::UpdatedBlockTip(const CBlockIndex* pindex)
+{
+    if (pindex->nHeight % 10 != 0 || pindex->nHeight < Params().Zerocoin_Block_V2_Start() || !zlenoTracker)
+        return;
+
+    std::set<uint256> setHashPubcoin;
+    {
+        LOCK(cs_wallet);
+        for (const CMintMeta& meta : zlenoTracker->GetMints(false))
+            setHashPubcoin.insert(meta.hashPubcoin);
+    }
+
+    // Stay behind the checkpoint a stake can use, spends and stakes continue from here
+    AdvanceAccumulatorWitnesses(setHashPubcoin, pindex->nHeight - Params().Zerocoin_RequiredStakeDepth() - 10);
+}
+
 void CWallet::EraseFromWallet(const uint256& hash)
 {
     if (!fFileBacked)
@@ -1430,10 +1448,170 @@ bool CWalletTx::WriteToDisk()
     return CWalletDB(pwallet->strWalletFile).WriteTx(GetHash(), *this);
 }
 
+/**
+ * Conservative copy of the wallet keys and scripts, used to prefilter
+ * blocks during a rescan without holding any lock. It matches every output
+ * IsMine() accepts, and possibly more: those are dropped again by
+ * AddToWalletIfInvolvingMe when the match is committed.
+ */
+class CWalletScanFilter
+{
+public:
+    std::set<CKeyID> setKeys;
+    std::set<CScriptID> setScripts;
+    //! Watch-only and multisig scripts, which are matched exactly
+    std::set<CScript> setExactScripts;
+    //! Scripts the wallet can be paid to, for matching compact block filters
+    GCSFilter::ElementSet setFilterElements;
+    //! Whether blocks whose compact filter matches none of setFilterElements can be skipped
+    bool fUseBlockFilters;
+
+    CWalletScanFilter() : fUseBlockFilters(false) {}
+
+    bool IsRelevant(const CScript& scriptPubKey) const
+    {
+        if (setExactScripts.count(scriptPubKey))
+            return true;
+
+        std::vector<std::vector<unsigned char> > vSolutions;
+        txnouttype whichType;
+        if (!Solver(scriptPubKey, whichType, vSolutions))
+            return false;
+
+        switch (whichType) {
+        case TX_ZEROCOINMINT:
+        case TX_PUBKEY:
+            return setKeys.count(CPubKey(vSolutions[0]).GetID()) != 0;
+        case TX_PUBKEYHASH:
+            return setKeys.count(CKeyID(uint160(vSolutions[0]))) != 0;
+        case TX_SCRIPTHASH:
+            return setScripts.count(CScriptID(uint160(vSolutions[0]))) != 0;
+        case TX_MULTISIG:
+            // IsMine needs all of the keys, any one of them is enough here
+            for (unsigned int i = 1; i + 1 < vSolutions.size(); i++) {
+                if (setKeys.count(CPubKey(vSolutions[i]).GetID()))
+                    return true;
+            }
+            return false;
+        default:
+            return false;
+        }
+    }
+};
+
+void CWallet::GetScanFilter(CWalletScanFilter& filter) const
+{
+    GetKeys(filter.setKeys);
+    for (const CKeyID& keyID : filter.setKeys) {
+        CScript script = GetScriptForDestination(keyID);
+        filter.setFilterElements.insert(GCSFilter::Element(script.begin(), script.end()));
+        CPubKey pubkey;
+        if (GetPubKey(keyID, pubkey)) {
+            script = CScript() << ToByteVector(pubkey) << OP_CHECKSIG;
+            filter.setFilterElements.insert(GCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+
+    LOCK(cs_KeyStore);
+    for (const auto& script : mapScripts) {
+        filter.setScripts.insert(script.first);
+        CScript scriptP2SH = GetScriptForDestination(script.first);
+        filter.setFilterElements.insert(GCSFilter::Element(scriptP2SH.begin(), scriptP2SH.end()));
+        filter.setFilterElements.insert(GCSFilter::Element(script.second.begin(), script.second.end()));
+    }
+    filter.setExactScripts.insert(setWatchOnly.begin(), setWatchOnly.end());
+    filter.setExactScripts.insert(setMultiSig.begin(), setMultiSig.end());
+    for (const CScript& script : filter.setExactScripts)
+        filter.setFilterElements.insert(GCSFilter::Element(script.begin(), script.end()));
+}
+
+namespace {
+
+/** A block of a rescan chunk, read and prefiltered by a reader thread */
+struct CRescanBlock {
+    CBlockIndex* pindex;
+    CDiskBlockPos pos;
+    uint256 hashBlock;
+    CBlock block;
+    bool fRead;
+    //! Whether each transaction of the block pays to the scan filter
+    std::vector<bool> vMatch;
+
+    explicit CRescanBlock(CBlockIndex* pindexIn) : pindex(pindexIn), pos(pindexIn->GetBlockPos()), hashBlock(pindexIn->GetBlockHash()), fRead(false) {}
+};
+
+void ThreadReadRescanBlocks(std::vector<CRescanBlock>* pvBlocks, std::atomic<size_t>* pnNext, const CWalletScanFilter* pfilter)
+{
+    size_t i;
+    while ((i = (*pnNext)++) < pvBlocks->size()) {
+        CRescanBlock& rb = (*pvBlocks)[i];
+
+        // A block paying to none of our scripts and spending none of them
+        // cannot involve the wallet: skip reading it
+        CBlockFilter blockfilter;
+        if (pfilter->fUseBlockFilters && pblockfilterdb && pblockfilterdb->ReadFilter(rb.hashBlock, blockfilter) &&
+            !blockfilter.GetFilter().MatchAny(pfilter->setFilterElements)) {
+            rb.fRead = true;
+            continue;
+        }
+
+        if (!ReadBlockFromDisk(rb.block, rb.pos) || rb.block.GetHash() != rb.hashBlock)
+            continue;
+
+        rb.vMatch.assign(rb.block.vtx.size(), false);
+        for (unsigned int j = 0; j < rb.block.vtx.size(); j++) {
+            for (const CTxOut& txout : rb.block.vtx[j].vout) {
+                if (pfilter->IsRelevant(txout.scriptPubKey)) {
+                    rb.vMatch[j] = true;
+                    break;
+                }
+            }
+        }
+        rb.fRead = true;
+    }
+}
+
+/**
+ * Collect up to WALLET_RESCAN_CHUNK_BLOCKS active chain blocks starting at
+ * pindexFrom and start reading them on the reader threads.
+ */
+void StartRescanChunk(CBlockIndex* pindexFrom, std::vector<CRescanBlock>& vBlocks, std::atomic<size_t>& nNext, std::vector<boost::thread>& vReaders, const CWalletScanFilter& filter)
+{
+    vBlocks.clear();
+    {
+        LOCK(cs_main);
+        for (CBlockIndex* pindex = pindexFrom; pindex && vBlocks.size() < WALLET_RESCAN_CHUNK_BLOCKS; pindex = chainActive.Next(pindex))
+            vBlocks.push_back(CRescanBlock(pindex));
+    }
+    nNext = 0;
+    if (vBlocks.empty())
+        return;
+
+    int nThreads = std::max(1, std::min((int)boost::thread::hardware_concurrency(), MAX_WALLET_RESCAN_THREADS));
+    for (int i = 0; i < nThreads; i++)
+        vReaders.emplace_back(boost::bind(&ThreadReadRescanBlocks, &vBlocks, &nNext, &filter));
+}
+
+/** Wait for the reader threads of a chunk and release them */
+void JoinRescanChunk(std::vector<boost::thread>& vReaders)
+{
+    for (boost::thread& reader : vReaders)
+        reader.join();
+    vReaders.clear();
+}
+
+} // anonymous namespace
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ *
+ * Blocks are read and matched against a copy of the wallet keys on reader
+ * threads, one chunk ahead of the chunk being committed. cs_main and
+ * cs_wallet are only taken to commit the candidate transactions of a chunk.
+ * With -blockfilterindex, blocks whose compact filter matches none of the
+ * wallet scripts are not read at all.
  */
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
@@ -1444,83 +1622,137 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
         zlenoTracker->Init();
 
     CBlockIndex* pindex = pindexStart;
+    double dProgressStart, dProgressTip;
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_main);
 
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)) && pindex->nHeight <= Params().Zerocoin_StartHeight())
             pindex = chainActive.Next(pindex);
 
-        ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
-        set<uint256> setAddedToWallet;
-        while (pindex) {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
-
-            CBlock block;
-            ReadBlockFromDisk(block, pindex);
-            BOOST_FOREACH (CTransaction& tx, block.vtx) {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
-            }
+        dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
+        dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
+    }
+    ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
 
-            //If this is a zapwallettx, need to readd zleno
-            if (fCheckZLENO && pindex->nHeight >= Params().Zerocoin_StartHeight()) {
-                list<CZerocoinMint> listMints;
-                BlockToZerocoinMintList(block, listMints, true);
-
-                for (auto& m : listMints) {
-                    if (IsMyMint(m.GetValue())) {
-                        LogPrint("zero", "%s: found mint\n", __func__);
-                        pwalletMain->UpdateMint(m.GetValue(), pindex->nHeight, m.GetTxHash(), m.GetDenomination());
-
-                        // Add the transaction to the wallet
-                        for (auto& tx : block.vtx) {
-                            uint256 txid = tx.GetHash();
-                            if (setAddedToWallet.count(txid) || mapWallet.count(txid))
-                                continue;
-                            if (txid == m.GetTxHash()) {
-                                CWalletTx wtx(pwalletMain, tx);
-                                wtx.nTimeReceived = block.GetBlockTime();
-                                wtx.SetMerkleBranch(block);
-                                pwalletMain->AddToWallet(wtx);
-                                setAddedToWallet.insert(txid);
+    CWalletScanFilter filter;
+    GetScanFilter(filter);
+    // Mints found by -zapwallettxes are matched by serial, not by script
+    filter.fUseBlockFilters = fBlockFilterIndex && !fCheckZLENO;
+
+    std::vector<CRescanBlock> vBlocks, vPrefetch;
+    std::atomic<size_t> nNext(0), nNextPrefetch(0);
+    std::vector<boost::thread> vReaders;
+    StartRescanChunk(pindex, vBlocks, nNext, vReaders, filter);
+    JoinRescanChunk(vReaders);
+
+    set<uint256> setAddedToWallet;
+    while (!vBlocks.empty()) {
+        // Read the next chunk while this one is committed
+        CBlockIndex* pindexFrom;
+        {
+            LOCK(cs_main);
+            pindexFrom = chainActive.Next(chainActive.FindFork(vBlocks.back().pindex));
+        }
+        StartRescanChunk(pindexFrom, vPrefetch, nNextPrefetch, vReaders, filter);
+
+        CBlockIndex* pindexReorged = NULL;
+        {
+            LOCK2(cs_main, cs_wallet);
+            for (CRescanBlock& rb : vBlocks) {
+                pindex = rb.pindex;
+                if (!chainActive.Contains(pindex)) {
+                    pindexReorged = pindex;
+                    break;
+                }
+
+                if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                    ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+
+                if (!rb.fRead) {
+                    LogPrintf("%s : failed to read block %s at height %d\n", __func__, rb.hashBlock.ToString(), pindex->nHeight);
+                    continue;
+                }
+
+                CBlock& block = rb.block;
+                for (unsigned int i = 0; i < block.vtx.size(); i++) {
+                    const CTransaction& tx = block.vtx[i];
+                    bool fCandidate = rb.vMatch[i] || mapWallet.count(tx.GetHash());
+                    for (unsigned int j = 0; !fCandidate && j < tx.vin.size(); j++)
+                        fCandidate = mapWallet.count(tx.vin[j].prevout.hash) != 0;
+                    if (fCandidate && AddToWalletIfInvolvingMe(tx, &block, fUpdate))
+                        ret++;
+                }
+
+                //If this is a zapwallettx, need to readd zleno
+                if (fCheckZLENO && pindex->nHeight >= Params().Zerocoin_StartHeight()) {
+                    list<CZerocoinMint> listMints;
+                    BlockToZerocoinMintList(block, listMints, true);
+
+                    for (auto& m : listMints) {
+                        if (IsMyMint(m.GetValue())) {
+                            LogPrint("zero", "%s: found mint\n", __func__);
+                            pwalletMain->UpdateMint(m.GetValue(), pindex->nHeight, m.GetTxHash(), m.GetDenomination());
+
+                            // Add the transaction to the wallet
+                            for (auto& tx : block.vtx) {
+                                uint256 txid = tx.GetHash();
+                                if (setAddedToWallet.count(txid) || mapWallet.count(txid))
+                                    continue;
+                                if (txid == m.GetTxHash()) {
+                                    CWalletTx wtx(pwalletMain, tx);
+                                    wtx.nTimeReceived = block.GetBlockTime();
+                                    wtx.SetMerkleBranch(block);
+                                    pwalletMain->AddToWallet(wtx);
+                                    setAddedToWallet.insert(txid);
+                                }
                             }
-                        }
 
-                        //Check if the mint was ever spent
-                        int nHeightSpend = 0;
-                        uint256 txidSpend;
-                        CTransaction txSpend;
-                        if (IsSerialInBlockchain(GetSerialHash(m.GetSerialNumber()), nHeightSpend, txidSpend, txSpend)) {
-                            if (setAddedToWallet.count(txidSpend) || mapWallet.count(txidSpend))
-                                continue;
-
-                            CWalletTx wtx(pwalletMain, txSpend);
-                            CBlockIndex* pindexSpend = chainActive[nHeightSpend];
-                            CBlock blockSpend;
-                            if (ReadBlockFromDisk(blockSpend, pindexSpend))
-                                wtx.SetMerkleBranch(blockSpend);
-
-                            wtx.nTimeReceived = pindexSpend->nTime;
-                            pwalletMain->AddToWallet(wtx);
-                            setAddedToWallet.emplace(txidSpend);
+                            //Check if the mint was ever spent
+                            int nHeightSpend = 0;
+                            uint256 txidSpend;
+                            CTransaction txSpend;
+                            if (IsSerialInBlockchain(GetSerialHash(m.GetSerialNumber()), nHeightSpend, txidSpend, txSpend)) {
+                                if (setAddedToWallet.count(txidSpend) || mapWallet.count(txidSpend))
+                                    continue;
+
+                                CWalletTx wtx(pwalletMain, txSpend);
+                                CBlockIndex* pindexSpend = chainActive[nHeightSpend];
+                                CBlock blockSpend;
+                                if (ReadBlockFromDisk(blockSpend, pindexSpend))
+                                    wtx.SetMerkleBranch(blockSpend);
+
+                                wtx.nTimeReceived = pindexSpend->nTime;
+                                pwalletMain->AddToWallet(wtx);
+                                setAddedToWallet.emplace(txidSpend);
+                            }
                         }
                     }
                 }
+
+                if (GetTime() >= nNow + 60) {
+                    nNow = GetTime();
+                    LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(pindex));
+                }
             }
+        }
+        JoinRescanChunk(vReaders);
 
-            pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(pindex));
+        if (pindexReorged) {
+            // The rest of this chunk and the prefetched one left the active
+            // chain: continue from where it forks off
+            {
+                LOCK(cs_main);
+                pindexFrom = chainActive.Next(chainActive.FindFork(pindexReorged));
             }
+            StartRescanChunk(pindexFrom, vBlocks, nNext, vReaders, filter);
+            JoinRescanChunk(vReaders);
+            continue;
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+        vBlocks.swap(vPrefetch);
     }
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     return ret;
 }
 
@@ -1560,7 +1792,7 @@ void CWalletTx::RelayWalletTransaction(std::string strCommand)
             LogPrintf("Relaying wtx %s\n", hash.ToString());
 
             if (strCommand == "ix") {
-                mapTxLockReq.insert(make_pair(hash, (CTransaction) * this));
+                txLockManager.AddLockRequest((CTransaction) * this);
                 CreateNewLock(((CTransaction) * this));
                 RelayTransactionLockReq((CTransaction) * this, true);
             } else {
@@ -1641,24 +1873,10 @@ CAmount CWallet::GetBalance() const
     return nTotal;
 }
 
-std::map<libzerocoin::CoinDenomination, int> mapMintMaturity;
-int nLastMaturityCheck = 0;
 CAmount CWallet::GetZerocoinBalance(bool fMatureOnly) const
 {
-    if (fMatureOnly) {
-        if (chainActive.Height() > nLastMaturityCheck)
-            mapMintMaturity = GetMintMaturityHeight();
-        nLastMaturityCheck = chainActive.Height();
-
-        CAmount nBalance = 0;
-        vector<CMintMeta> vMints = zlenoTracker->GetMints(true);
-        for (auto meta : vMints) {
-            if (meta.nHeight >= mapMintMaturity.at(meta.denom) || meta.nHeight >= chainActive.Height() || meta.nHeight == 0)
-                continue;
-            nBalance += libzerocoin::ZerocoinDenominationToAmount(meta.denom);
-        }
-        return nBalance;
-    }
+    if (fMatureOnly)
+        return zlenoTracker->GetMatureBalance();
 
     return zlenoTracker->GetBalance(false, false);
 }
@@ -2944,9 +3162,6 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
     if (listInputs.empty())
         return false;
 
-    if (GetAdjustedTime() - chainActive.Tip()->GetBlockTime() < 60)
-        MilliSleep(10000);
-
     CAmount nCredit = 0;
     CScript scriptPubKeyKernel;
     bool fKernelFound = false;
@@ -4386,12 +4601,7 @@ int CMerkleTx::GetTransactionLockSignatures() const
     if (!fEnableSwiftTX) return -1;
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
-    if (i != mapTxLocks.end()) {
-        return (*i).second.CountSignatures();
-    }
-
-    return -1;
+    return txLockManager.GetLockSignatures(GetHash());
 }
 
 bool CMerkleTx::IsTransactionLockTimedOut() const
@@ -4399,12 +4609,7 @@ bool CMerkleTx::IsTransactionLockTimedOut() const
     if (!fEnableSwiftTX) return 0;
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
-    if (i != mapTxLocks.end()) {
-        return GetTime() > (*i).second.nTimeout;
-    }
-
-    return false;
+    return txLockManager.IsLockTimedOut(GetHash());
 }
 
 // Given a set of inputs, find the public key that contributes the most coins to the input set
@@ -5272,10 +5477,11 @@ bool CWallet::GetMint(const uint256& hashSerial, CZerocoinMint& mint)
 
 bool CWallet::IsMyMint(const CBigNum& bnValue) const
 {
-    if (zlenoTracker->HasPubcoin(bnValue))
+    uint256 hashPubcoin = GetPubCoinHash(bnValue);
+    if (zlenoTracker->HasPubcoinHash(hashPubcoin))
         return true;
 
-    return zwalletMain->IsInMintPool(bnValue);
+    return zwalletMain->IsInMintPool(hashPubcoin);
 }
 
 bool CWallet::UpdateMint(const CBigNum& bnValue, const int& nHeight, const uint256& txid, const libzerocoin::CoinDenomination& denom)
@@ -5289,7 +5495,7 @@ bool CWallet::UpdateMint(const CBigNum& bnValue, const int& nHeight, const uint2
         return zlenoTracker->UpdateState(meta);
     } else {
         //Check if this mint is one that is in our mintpool (a potential future mint from our deterministic generation)
-        if (zwalletMain->IsInMintPool(bnValue)) {
+        if (zwalletMain->IsInMintPool(hashValue)) {
             if (zwalletMain->SetMintSeen(bnValue, nHeight, txid, denom))
                 return true;
         }
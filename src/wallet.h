@@ -60,6 +60,10 @@ static const CAmount nHighTransactionMaxFeeWarning = 100 * nHighTransactionFeeWa
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
 //! -custombackupthreshold default
 static const int DEFAULT_CUSTOMBACKUPTHRESHOLD = 1;
+//! Blocks read ahead per chunk by ScanForWalletTransactions
+static const unsigned int WALLET_RESCAN_CHUNK_BLOCKS = 200;
+//! Maximum number of block reader threads used by ScanForWalletTransactions
+static const int MAX_WALLET_RESCAN_THREADS = 8;
 
 // Zerocoin denomination which creates exactly one of each denominations:
 // 6666 = 1*5000 + 1*1000 + 1*500 + 1*100 + 1*50 + 1*10 + 1*5 + 1
@@ -70,6 +74,7 @@ class CCoinControl;
 class COutput;
 class CReserveKey;
 class CScript;
+class CWalletScanFilter;
 class CWalletTx;
 
 /** (client) version numbers for particular wallet features */
@@ -458,9 +463,12 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet = false);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+    /** Every 10 blocks, advance the cached accumulator witnesses of unspent mints */
+    void UpdatedBlockTip(const CBlockIndex* pindex);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     void EraseFromWallet(const uint256& hash);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    void GetScanFilter(CWalletScanFilter& filter) const;
     void ReacceptWalletTransactions();
     void ResendWalletTransactions();
     CAmount GetBalance() const;
@@ -10,6 +10,10 @@
 #include "txdb.h"
 #include "ui_interface.h"
 
+#include <atomic>
+
+#include <boost/thread.hpp>
+
 // 6 comes from OPCODE (1) + vch.size() (1) + BIGNUM size (4)
 #define SCRIPT_OFFSET 6
 // For Script size (BIGNUM/Uint256 size)
@@ -81,6 +85,65 @@ bool BlockToPubcoinList(const CBlock& block, std::list<libzerocoin::PublicCoin>&
     return true;
 }
 
+//return the zerocoin mints of a block as recorded in the zerocoin database, with the outpoint filter result
+bool BlockToZerocoinBlockMints(const CBlock& block, std::vector<CZerocoinBlockMint>& vMints)
+{
+    for (const CTransaction& tx : block.vtx) {
+        if(!tx.IsZerocoinMint())
+            continue;
+
+        // Same filter as BlockToPubcoinList, recorded instead of applied
+        bool fValid = true;
+        for (const CTxIn& in : tx.vin) {
+            if (!ValidOutPoint(in.prevout, INT_MAX)) {
+                fValid = false;
+                break;
+            }
+        }
+
+        uint256 txHash = tx.GetHash();
+        for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            if (!ValidOutPoint(COutPoint(txHash, i), INT_MAX))
+                fValid = false;
+
+            const CTxOut& txOut = tx.vout[i];
+            if(!txOut.scriptPubKey.IsZerocoinMint())
+                continue;
+
+            CValidationState state;
+            libzerocoin::PublicCoin pubCoin(Params().Zerocoin_Params(false));
+            if(!TxOutToPublicCoin(txOut, pubCoin, state))
+                return false;
+
+            vMints.emplace_back(pubCoin.getValue(), pubCoin.getDenomination(), fValid);
+        }
+    }
+
+    return true;
+}
+
+bool GetBlockPubcoinList(const CBlockIndex* pindex, std::list<libzerocoin::PublicCoin>& listPubcoins, bool fFilterInvalid)
+{
+    std::vector<CZerocoinBlockMint> vMints;
+    if (!zerocoinDB->ReadBlockMints(pindex->GetBlockHash(), vMints)) {
+        // Connected before mints were recorded per block, record them now
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex))
+            return error("%s: failed to read block %d from disk", __func__, pindex->nHeight);
+        if (!BlockToZerocoinBlockMints(block, vMints))
+            return false;
+        zerocoinDB->WriteBlockMints(pindex->GetBlockHash(), vMints);
+    }
+
+    for (const CZerocoinBlockMint& mint : vMints) {
+        if (fFilterInvalid && !mint.fValidOutpoint)
+            continue;
+        listPubcoins.emplace_back(Params().Zerocoin_Params(false), mint.bnValue, mint.denom);
+    }
+
+    return true;
+}
+
 //return a list of zerocoin mints contained in a specific block
 bool BlockToZerocoinMintList(const CBlock& block, std::list<CZerocoinMint>& vMints, bool fFilterInvalid)
 {
@@ -255,77 +318,129 @@ bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& tx
     return IsTransactionInChain(txidSpend, nHeightTx, tx);
 }
 
-std::string ReindexZerocoinDB()
-{
-    if (!zerocoinDB->WipeCoins("spends") || !zerocoinDB->WipeCoins("mints")) {
-        return _("Failed to wipe zerocoinDB");
-    }
+namespace {
 
-    uiInterface.ShowProgress(_("Reindexing zerocoin database..."), 0);
+/** Zerocoin records of a block, extracted by a ReindexZerocoinDB reader thread */
+struct CZerocoinReindexBlock {
+    CBlockIndex* pindex;
+    CDiskBlockPos pos;
+    bool fRead;
+    std::vector<std::pair<uint256, uint256> > vSpends; //!< serial hash, spending txid
+    std::vector<std::pair<uint256, uint256> > vMints;  //!< pubcoin hash, minting txid
+    std::vector<CZerocoinBlockMint> vBlockMints;
 
-    CBlockIndex* pindex = chainActive[Params().Zerocoin_StartHeight()];
-    std::vector<std::pair<libzerocoin::CoinSpend, uint256> > vSpendInfo;
-    std::vector<std::pair<libzerocoin::PublicCoin, uint256> > vMintInfo;
-    while (pindex) {
-        uiInterface.ShowProgress(_("Reindexing zerocoin database..."), std::max(1, std::min(99, (int)((double)(pindex->nHeight - Params().Zerocoin_StartHeight()) / (double)(chainActive.Height() - Params().Zerocoin_StartHeight()) * 100))));
+    explicit CZerocoinReindexBlock(CBlockIndex* pindexIn) : pindex(pindexIn), pos(pindexIn->GetBlockPos()), fRead(false) {}
+};
 
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("Reindexing zerocoin : block %d...\n", pindex->nHeight);
+void ThreadReindexZerocoin(std::vector<CZerocoinReindexBlock>* pvBlocks, std::atomic<size_t>* pnNext)
+{
+    size_t i;
+    while ((i = (*pnNext)++) < pvBlocks->size()) {
+        CZerocoinReindexBlock& rb = (*pvBlocks)[i];
 
         CBlock block;
-        if (!ReadBlockFromDisk(block, pindex)) {
-            return _("Reindexing zerocoin failed");
-        }
+        if (!ReadBlockFromDisk(block, rb.pos) || block.GetHash() != rb.pindex->GetBlockHash())
+            continue;
 
-        for (const CTransaction& tx : block.vtx) {
-            for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                if (tx.IsCoinBase())
-                    break;
+        try {
+            for (const CTransaction& tx : block.vtx) {
+                if (tx.IsCoinBase() || !tx.ContainsZerocoins())
+                    continue;
+
+                uint256 txid = tx.GetHash();
+                //Record Serials
+                if (tx.IsZerocoinSpend()) {
+                    for (auto& in : tx.vin) {
+                        if (!in.scriptSig.IsZerocoinSpend())
+                            continue;
 
-                if (tx.ContainsZerocoins()) {
-                    uint256 txid = tx.GetHash();
-                    //Record Serials
-                    if (tx.IsZerocoinSpend()) {
-                        for (auto& in : tx.vin) {
-                            if (!in.scriptSig.IsZerocoinSpend())
-                                continue;
-
-                            libzerocoin::CoinSpend spend = TxInToZerocoinSpend(in);
-                            vSpendInfo.push_back(make_pair(spend, txid));
-                        }
+                        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(in);
+                        rb.vSpends.push_back(make_pair(GetSerialHash(spend.getCoinSerialNumber()), txid));
                     }
+                }
+
+                //Record mints
+                if (tx.IsZerocoinMint()) {
+                    for (auto& out : tx.vout) {
+                        if (!out.IsZerocoinMint())
+                            continue;
 
-                    //Record mints
-                    if (tx.IsZerocoinMint()) {
-                        for (auto& out : tx.vout) {
-                            if (!out.IsZerocoinMint())
-                                continue;
-
-                            CValidationState state;
-                            libzerocoin::PublicCoin coin(Params().Zerocoin_Params(pindex->nHeight < Params().Zerocoin_Block_V2_Start()));
-                            TxOutToPublicCoin(out, coin, state);
-                            vMintInfo.push_back(make_pair(coin, txid));
-                        }
+                        CValidationState state;
+                        libzerocoin::PublicCoin coin(Params().Zerocoin_Params(rb.pindex->nHeight < Params().Zerocoin_Block_V2_Start()));
+                        TxOutToPublicCoin(out, coin, state);
+                        rb.vMints.push_back(make_pair(GetPubCoinHash(coin.getValue()), txid));
                     }
                 }
             }
-        }
 
-        // Flush the zerocoinDB to disk every 100 blocks
-        if (pindex->nHeight % 100 == 0) {
-            if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
-                return _("Error writing zerocoinDB to disk");
-            vSpendInfo.clear();
-            vMintInfo.clear();
+            if (!BlockToZerocoinBlockMints(block, rb.vBlockMints))
+                continue;
+        } catch (const std::exception& e) {
+            LogPrintf("%s : failed to read zerocoin records of block %d: %s\n", __func__, rb.pindex->nHeight, e.what());
+            continue;
         }
+        rb.fRead = true;
+    }
+}
+
+} // anonymous namespace
 
-        pindex = chainActive.Next(pindex);
+std::string ReindexZerocoinDB()
+{
+    if (!zerocoinDB->WipeCoins("spends") || !zerocoinDB->WipeCoins("mints")) {
+        return _("Failed to wipe zerocoinDB");
     }
-    uiInterface.ShowProgress("", 100);
 
-    // Final flush to disk in case any remaining information exists
-    if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
-        return _("Error writing zerocoinDB to disk");
+    uiInterface.ShowProgress(_("Reindexing zerocoin database..."), 0);
+
+    int nThreads = std::max(1, std::min((int)boost::thread::hardware_concurrency(), MAX_ZEROCOIN_REINDEX_THREADS));
+    int nHeightStart = Params().Zerocoin_StartHeight();
+    int nHeightEnd;
+    CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        nHeightEnd = chainActive.Height();
+        pindex = chainActive[nHeightStart];
+    }
+
+    // Blocks are read and decoded in parallel a batch at a time, and the
+    // records of each batch are written sorted, in one database batch per type
+    while (pindex) {
+        std::vector<CZerocoinReindexBlock> vBlocks;
+        {
+            LOCK(cs_main);
+            for (; pindex && vBlocks.size() < (size_t)ZEROCOIN_REINDEX_BATCH_BLOCKS; pindex = chainActive.Next(pindex))
+                vBlocks.push_back(CZerocoinReindexBlock(pindex));
+        }
+
+        std::atomic<size_t> nNext(0);
+        boost::thread_group readers;
+        for (int i = 0; i < nThreads; i++)
+            readers.create_thread(boost::bind(&ThreadReindexZerocoin, &vBlocks, &nNext));
+        readers.join_all();
+
+        std::vector<std::pair<uint256, uint256> > vSpends;
+        std::vector<std::pair<uint256, uint256> > vMints;
+        std::vector<std::pair<uint256, std::vector<CZerocoinBlockMint> > > vBlockMints;
+        for (CZerocoinReindexBlock& rb : vBlocks) {
+            if (!rb.fRead)
+                return _("Reindexing zerocoin failed");
+            vSpends.insert(vSpends.end(), rb.vSpends.begin(), rb.vSpends.end());
+            vMints.insert(vMints.end(), rb.vMints.begin(), rb.vMints.end());
+            vBlockMints.push_back(make_pair(rb.pindex->GetBlockHash(), rb.vBlockMints));
+        }
+        std::sort(vSpends.begin(), vSpends.end());
+        std::sort(vMints.begin(), vMints.end());
+
+        if ((!vSpends.empty() && !zerocoinDB->WriteCoinHashes('s', vSpends)) ||
+            (!vMints.empty() && !zerocoinDB->WriteCoinHashes('m', vMints)) ||
+            !zerocoinDB->WriteBlockMintsBatch(vBlockMints))
+            return _("Error writing zerocoinDB to disk");
+
+        int nHeight = vBlocks.back().pindex->nHeight;
+        LogPrintf("Reindexing zerocoin : block %d...\n", nHeight);
+        uiInterface.ShowProgress(_("Reindexing zerocoin database..."), std::max(1, std::min(99, (int)((double)(nHeight - nHeightStart) / (double)std::max(1, nHeightEnd - nHeightStart) * 100))));
+    }
 
     uiInterface.ShowProgress("", 100);
 
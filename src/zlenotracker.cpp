@@ -21,6 +21,14 @@ CzlenoTracker::CzlenoTracker(std::string strWalletFile)
     mapSerialHashes.clear();
     mapPendingSpends.clear();
     fInitialized = false;
+    fBalanceDirty = true;
+    hashBalanceTip = 0;
+    nBalanceTotal = 0;
+    nBalanceConfirmed = 0;
+    nBalanceMature = 0;
+    fStatusDirty = true;
+    hashStatusTip = 0;
+    nStatusMempoolUpdated = 0;
 }
 
 CzlenoTracker::~CzlenoTracker()
@@ -42,6 +50,7 @@ bool CzlenoTracker::Archive(CMintMeta& meta)
 {
     if (mapSerialHashes.count(meta.hashSerial))
         mapSerialHashes.at(meta.hashSerial).isArchived = true;
+    SetDirty();
 
     CWalletDB walletdb(strWalletFile);
     CZerocoinMint mint;
@@ -125,36 +134,68 @@ std::vector<uint256> CzlenoTracker::GetSerialHashes()
     return vHashes;
 }
 
-CAmount CzlenoTracker::GetBalance(bool fConfirmedOnly, bool fUnconfirmedOnly) const
+void CzlenoTracker::UpdateBalances() const
 {
-    CAmount nTotal = 0;
-    //! zerocoin specific fields
-    std::map<libzerocoin::CoinDenomination, unsigned int> myZerocoinSupply;
-    for (auto& denom : libzerocoin::zerocoinDenomList) {
-        myZerocoinSupply.insert(make_pair(denom, 0));
+    // cs_main is never taken while holding cs_balance
+    uint256 hashTip = 0;
+    int nHeight;
+    std::map<libzerocoin::CoinDenomination, int> mapMaturity;
+    {
+        LOCK(cs_main);
+        if (chainActive.Tip())
+            hashTip = chainActive.Tip()->GetBlockHash();
+        nHeight = chainActive.Height();
+        mapMaturity = GetMintMaturityHeight();
     }
+    int nConfirmedHeight = nHeight - Params().Zerocoin_MintRequiredConfirmations();
 
-    {
-        //LOCK(cs_icatracker);
-        // Get Unused coins
-        for (auto& it : mapSerialHashes) {
-            CMintMeta meta = it.second;
-            if (meta.isUsed || meta.isArchived)
-                continue;
-            bool fConfirmed = ((meta.nHeight < chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations()) && !(meta.nHeight == 0));
-            if (fConfirmedOnly && !fConfirmed)
-                continue;
-            if (fUnconfirmedOnly && fConfirmed)
-                continue;
+    LOCK(cs_balance);
+    if (!fBalanceDirty && hashTip == hashBalanceTip)
+        return;
 
-            nTotal += libzerocoin::ZerocoinDenominationToAmount(meta.denom);
-            myZerocoinSupply.at(meta.denom)++;
-        }
+    CAmount nTotal = 0;
+    CAmount nConfirmed = 0;
+    CAmount nMature = 0;
+    for (auto& it : mapSerialHashes) {
+        const CMintMeta& meta = it.second;
+        if (meta.isUsed || meta.isArchived)
+            continue;
+
+        CAmount nValue = libzerocoin::ZerocoinDenominationToAmount(meta.denom);
+        nTotal += nValue;
+        if (meta.nHeight == 0 || meta.nHeight >= nConfirmedHeight)
+            continue;
+        nConfirmed += nValue;
+        if (meta.nHeight < mapMaturity.at(meta.denom) && meta.nHeight < nHeight)
+            nMature += nValue;
     }
 
-    if (nTotal < 0 ) nTotal = 0; // Sanity never hurts
+    nBalanceTotal = nTotal;
+    nBalanceConfirmed = nConfirmed;
+    nBalanceMature = nMature;
+    fBalanceDirty = false;
+    hashBalanceTip = hashTip;
+}
 
-    return nTotal;
+CAmount CzlenoTracker::GetBalance(bool fConfirmedOnly, bool fUnconfirmedOnly) const
+{
+    if (fConfirmedOnly && fUnconfirmedOnly)
+        return 0;
+
+    UpdateBalances();
+    LOCK(cs_balance);
+    if (fConfirmedOnly)
+        return nBalanceConfirmed;
+    if (fUnconfirmedOnly)
+        return nBalanceTotal - nBalanceConfirmed;
+    return nBalanceTotal;
+}
+
+CAmount CzlenoTracker::GetMatureBalance() const
+{
+    UpdateBalances();
+    LOCK(cs_balance);
+    return nBalanceMature;
 }
 
 CAmount CzlenoTracker::GetUnconfirmedBalance() const
@@ -230,6 +271,7 @@ bool CzlenoTracker::UpdateZerocoinMint(const CZerocoinMint& mint)
     meta.denom = mint.GetDenomination();
     meta.nHeight = mint.GetHeight();
     mapSerialHashes.at(hashSerial) = meta;
+    SetDirty();
 
     //Write to db
     return CWalletDB(strWalletFile).WriteZerocoinMint(mint);
@@ -274,6 +316,7 @@ bool CzlenoTracker::UpdateState(const CMintMeta& meta)
     }
 
     mapSerialHashes[meta.hashSerial] = meta;
+    SetDirty();
 
     return true;
 }
@@ -292,6 +335,7 @@ void CzlenoTracker::Add(const CDeterministicMint& dMint, bool isNew, bool isArch
     meta.isArchived = isArchived;
     meta.isDeterministic = true;
     mapSerialHashes[meta.hashSerial] = meta;
+    SetDirty();
 
     if (isNew)
         CWalletDB(strWalletFile).WriteDeterministicMint(dMint);
@@ -312,6 +356,7 @@ void CzlenoTracker::Add(const CZerocoinMint& mint, bool isNew, bool isArchived)
     meta.isArchived = isArchived;
     meta.isDeterministic = false;
     mapSerialHashes[meta.hashSerial] = meta;
+    SetDirty();
 
     if (isNew)
         CWalletDB(strWalletFile).WriteZerocoinMint(mint);
@@ -350,8 +395,10 @@ void CzlenoTracker::RemovePending(const uint256& txid)
         }
     }
 
-    if (hashSerial > 0)
+    if (hashSerial > 0) {
         mapPendingSpends.erase(hashSerial);
+        fStatusDirty = true;
+    }
 }
 
 bool CzlenoTracker::UpdateStatusInternal(const std::set<uint256>& setMempool, CMintMeta& mint)
@@ -432,6 +479,13 @@ bool CzlenoTracker::UpdateStatusInternal(const std::set<uint256>& setMempool, CM
 
 std::set<CMintMeta> CzlenoTracker::ListMints(bool fUnusedOnly, bool fMatureOnly, bool fUpdateStatus)
 {
+    // Statuses only change with the chain tip, the mempool or the mints themselves,
+    // skip the database lookups when none of them changed since the last update
+    uint256 hashTip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256(0);
+    unsigned int nMempoolUpdated = mempool.GetTransactionsUpdated();
+    if (fUpdateStatus && !fStatusDirty && hashTip == hashStatusTip && nMempoolUpdated == nStatusMempoolUpdated)
+        fUpdateStatus = false;
+
     CWalletDB walletdb(strWalletFile);
     if (fUpdateStatus) {
         std::list<CZerocoinMint> listMintsDB = walletdb.ListMintedCoins();
@@ -448,7 +502,7 @@ std::set<CMintMeta> CzlenoTracker::ListMints(bool fUnusedOnly, bool fMatureOnly,
     std::vector<CMintMeta> vOverWrite;
     std::set<CMintMeta> setMints;
     std::set<uint256> setMempool;
-    {
+    if (fUpdateStatus) {
         LOCK(mempool.cs);
         mempool.getTransactions(setMempool);
     }
@@ -487,10 +541,17 @@ std::set<CMintMeta> CzlenoTracker::ListMints(bool fUnusedOnly, bool fMatureOnly,
     for (CMintMeta& meta : vOverWrite)
         UpdateState(meta);
 
+    if (fUpdateStatus) {
+        fStatusDirty = false;
+        hashStatusTip = hashTip;
+        nStatusMempoolUpdated = nMempoolUpdated;
+    }
+
     return setMints;
 }
 
 void CzlenoTracker::Clear()
 {
     mapSerialHashes.clear();
+    SetDirty();
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #define LenoCore_ZLENOTRACKER_H
 
 #include "primitives/zerocoin.h"
+#include "sync.h"
 #include <list>
 
 class CDeterministicMint;
@@ -19,6 +20,29 @@ private:
     std::string strWalletFile;
     std::map<uint256, CMintMeta> mapSerialHashes;
     std::map<uint256, uint256> mapPendingSpends; //serialhash, txid of spend
+
+    //! Balances of the unused mints, recomputed when a mint or the chain tip changes
+    mutable CCriticalSection cs_balance;
+    mutable bool fBalanceDirty;
+    mutable uint256 hashBalanceTip;
+    mutable CAmount nBalanceTotal;
+    mutable CAmount nBalanceConfirmed;
+    mutable CAmount nBalanceMature;
+
+    //! Chain tip and mempool the mint statuses were last updated against
+    bool fStatusDirty;
+    uint256 hashStatusTip;
+    unsigned int nStatusMempoolUpdated;
+
+    void SetDirty()
+    {
+        {
+            LOCK(cs_balance);
+            fBalanceDirty = true;
+        }
+        fStatusDirty = true;
+    }
+    void UpdateBalances() const;
     bool UpdateStatusInternal(const std::set<uint256>& setMempool, CMintMeta& mint);
 public:
     CzlenoTracker(std::string strWalletFile);
@@ -37,6 +61,7 @@ public:
     CMintMeta GetMetaFromPubcoin(const uint256& hashPubcoin);
     bool GetMetaFromStakeHash(const uint256& hashStake, CMintMeta& meta) const;
     CAmount GetBalance(bool fConfirmedOnly, bool fUnconfirmedOnly) const;
+    CAmount GetMatureBalance() const;
     std::vector<uint256> GetSerialHashes();
     std::vector<CMintMeta> GetMints(bool fConfirmedOnly) const;
     CAmount GetUnconfirmedBalance() const;
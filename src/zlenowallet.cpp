@@ -12,6 +12,11 @@
 #include "primitives/deterministicmint.h"
 #include "zlenochain.h"
 
+#include <atomic>
+#include <unordered_set>
+
+#include <boost/thread.hpp>
+
 using namespace libzerocoin;
 
 CzlenoWallet::CzlenoWallet(std::string strWalletFile)
@@ -104,6 +109,33 @@ void CzlenoWallet::AddToMintPool(const std::pair<uint256, uint32_t>& pMint, bool
     mintPool.Add(pMint, fVerbose);
 }
 
+namespace {
+
+/** Mint pool counts being derived by GenerateMintPool, and the pubcoin values derived so far */
+struct CMintPoolJob {
+    std::vector<std::pair<uint32_t, uint512> > vSeeds; //!< count, zerocoin seed
+    std::vector<CBigNum> vValues;
+    std::atomic<size_t> nNext;
+
+    CMintPoolJob() : nNext(0) {}
+};
+
+void ThreadGenerateMintPool(CzlenoWallet* pwallet, CMintPoolJob* pjob)
+{
+    size_t i;
+    while ((i = pjob->nNext++) < pjob->vSeeds.size()) {
+        if (ShutdownRequested())
+            return;
+
+        CBigNum bnSerial;
+        CBigNum bnRandomness;
+        CKey key;
+        pwallet->SeedToZLENO(pjob->vSeeds[i].second, pjob->vValues[i], bnSerial, bnRandomness, key);
+    }
+}
+
+} // anonymous namespace
+
 //Add the next 20 mints to the mint pool
 void CzlenoWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
 {
@@ -121,38 +153,46 @@ void CzlenoWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
     if (nCountEnd > 0)
         nStop = std::max(n, n + nCountEnd);
 
-    bool fFound;
+    // Prevent unnecessary repeated minted
+    std::unordered_set<uint32_t> setCountsInPool;
+    for (auto& pair : mintPool)
+        setCountsInPool.insert(pair.second);
 
-    uint256 hashSeed = Hash(seedMaster.begin(), seedMaster.end());
-    LogPrintf("%s : n=%d nStop=%d\n", __func__, n, nStop - 1);
+    CMintPoolJob job;
     for (uint32_t i = n; i < nStop; ++i) {
-        if (ShutdownRequested())
-            return;
+        if (!setCountsInPool.count(i))
+            job.vSeeds.push_back(std::make_pair(i, GetZerocoinSeed(i)));
+    }
+    job.vValues.resize(job.vSeeds.size());
 
-        fFound = false;
+    uint256 hashSeed = Hash(seedMaster.begin(), seedMaster.end());
+    LogPrintf("%s : n=%d nStop=%d, %d mints to generate\n", __func__, n, nStop - 1, job.vSeeds.size());
+    if (job.vSeeds.empty())
+        return;
 
-        // Prevent unnecessary repeated minted
-        for (auto& pair : mintPool) {
-            if(pair.second == i) {
-                fFound = true;
-                break;
-            }
-        }
+    // Each mint takes a key search, a commitment and a run of primality tests: derive them in parallel
+    int nThreads = std::max(1, std::min((int)boost::thread::hardware_concurrency(), MAX_MINTPOOL_THREADS));
+    nThreads = std::min(nThreads, (int)job.vSeeds.size());
+    boost::thread_group workers;
+    for (int i = 0; i < nThreads; i++)
+        workers.create_thread(boost::bind(&ThreadGenerateMintPool, this, &job));
+    workers.join_all();
 
-        if(fFound)
+    // Values left at zero were not derived because of a shutdown
+    CWalletDB walletdb(strWalletFile);
+    bool fTxn = walletdb.TxnBegin();
+    for (size_t i = 0; i < job.vSeeds.size(); i++) {
+        if (job.vValues[i] == 0)
             continue;
 
-        uint512 seedZerocoin = GetZerocoinSeed(i);
-        CBigNum bnValue;
-        CBigNum bnSerial;
-        CBigNum bnRandomness;
-        CKey key;
-        SeedToZLENO(seedZerocoin, bnValue, bnSerial, bnRandomness, key);
-
-        mintPool.Add(bnValue, i);
-        CWalletDB(strWalletFile).WriteMintPoolPair(hashSeed, GetPubCoinHash(bnValue), i);
-        LogPrintf("%s : %s count=%d\n", __func__, bnValue.GetHex().substr(0, 6), i);
+        uint32_t nCount = job.vSeeds[i].first;
+        uint256 hashPubcoin = GetPubCoinHash(job.vValues[i]);
+        mintPool.Add(std::make_pair(hashPubcoin, nCount));
+        walletdb.WriteMintPoolPair(hashSeed, hashPubcoin, nCount);
+        LogPrint("zero", "%s : %s count=%d\n", __func__, job.vValues[i].GetHex().substr(0, 6), nCount);
     }
+    if (fTxn && !walletdb.TxnCommit())
+        LogPrintf("%s : failed to write the mint pool to %s\n", __func__, strWalletFile);
 }
 
 // pubcoin hashes are stored to db so that a full accounting of mints belonging to the seed can be tracked without regenerating
@@ -179,27 +219,27 @@ void CzlenoWallet::GetState(int& nCount, int& nLastGenerated)
     nLastGenerated = mintPool.CountOfLastGenerated();
 }
 
-//Catch the counter up with the chain
+//Catch the counter up with the chain. Mints of connected blocks are found by
+//CWallet::UpdateMint, so this is only needed when the wallet missed blocks.
 void CzlenoWallet::SyncWithChain(bool fGenerateMintPool)
 {
     uint32_t nLastCountUsed = 0;
     bool found = true;
-    CWalletDB walletdb(strWalletFile);
 
     set<uint256> setAddedTx;
+    // Each pass only looks up the pool entries added since the previous one
+    std::set<uint256> setChecked;
     while (found) {
         found = false;
         if (fGenerateMintPool)
             GenerateMintPool();
         LogPrintf("%s: Mintpool size=%d\n", __func__, mintPool.size());
 
-        std::set<uint256> setChecked;
+        LOCK(cs_main);
         list<pair<uint256,uint32_t> > listMints = mintPool.List();
         for (pair<uint256, uint32_t> pMint : listMints) {
-            LOCK(cs_main);
-            if (setChecked.count(pMint.first))
-                return;
-            setChecked.insert(pMint.first);
+            if (!setChecked.insert(pMint.first).second)
+                continue;
 
             if (ShutdownRequested())
                 return;
@@ -330,16 +370,17 @@ bool CzlenoWallet::SetMintSeen(const CBigNum& bnValue, const int& nHeight, const
     // Add to zlenoTracker which also adds to database
     pwalletMain->zlenoTracker->Add(dMint, true);
     
-    //Update the count if it is less than the mint's count
+    //remove from the pool
+    mintPool.Remove(dMint.GetPubcoinHash());
+
+    //Update the count if it is less than the mint's count, and keep the pool ahead of it
     if (nCountLastUsed < pMint.second) {
         CWalletDB walletdb(strWalletFile);
         nCountLastUsed = pMint.second;
         walletdb.WriteZLENOCount(nCountLastUsed);
+        GenerateMintPool();
     }
 
-    //remove from the pool
-    mintPool.Remove(dMint.GetPubcoinHash());
-
     return true;
 }
 
@@ -14,6 +14,9 @@
 
 class CDeterministicMint;
 
+//! Maximum number of threads deriving mints in CzlenoWallet::GenerateMintPool
+static const int MAX_MINTPOOL_THREADS = 8;
+
 class CzlenoWallet
 {
 private:
@@ -38,6 +41,7 @@ public:
     void RemoveMintsFromPool(const std::vector<uint256>& vPubcoinHashes);
     bool SetMintSeen(const CBigNum& bnValue, const int& nHeight, const uint256& txid, const libzerocoin::CoinDenomination& denom);
     bool IsInMintPool(const CBigNum& bnValue) { return mintPool.Has(bnValue); }
+    bool IsInMintPool(const uint256& hashPubcoin) { return mintPool.count(hashPubcoin) != 0; }
     void UpdateCount();
     void Lock();
     void SeedToZLENO(const uint512& seed, CBigNum& bnValue, CBigNum& bnSerial, CBigNum& bnRandomness, CKey& key);